@@ -0,0 +1,28 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC32C (polynôme de Castagnoli). crc vaut 0 au départ ; le résultat d'un
+// appel se passe au suivant pour poursuivre le calcul sur la suite des
+// données. L'instruction crc32 de SSE4.2 est utilisée quand le processeur
+// l'offre (sur trois flux entrelacés), des tables sinon.
+uint32_t crc32c(uint32_t crc, const void *data, size_t len);
+
+// Implémentation retenue : "sse4.2" ou "logicielle"
+const char *crc32c_impl(void);
+
+#define SHA256_SIZE 32
+
+typedef struct {
+    uint32_t state[8];
+    uint64_t length;       // Octets reçus
+    uint8_t buffer[64];    // Bloc en cours (length % 64 octets)
+} Sha256;
+
+void sha256_init(Sha256 *ctx);
+void sha256_update(Sha256 *ctx, const void *data, size_t len);
+void sha256_final(Sha256 *ctx, uint8_t digest[SHA256_SIZE]);
+
+#endif // CHECKSUM_H
@@ -0,0 +1,43 @@
+#ifndef DEDUP_H
+#define DEDUP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DEDUP_BLOCK 4096 // Blocs comparés : ceux du conteneur (BLOCK_SIZE)
+
+// Empreinte d'un bloc de données et bloc du conteneur qui porte ce contenu
+typedef struct {
+    uint64_t fingerprint;
+    uint64_t offset;
+} DedupEntry;
+
+// Index des empreintes, rangé deux fois (adressage ouvert, sondage linéaire) :
+// par empreinte pour trouver un bloc identique, par offset pour oublier les
+// blocs libérés. Un offset à 0 marque une case libre (le SuperBlock n'est
+// jamais un bloc de données).
+typedef struct {
+    DedupEntry *by_fingerprint;
+    DedupEntry *by_offset;
+    uint32_t capacity;     // Puissance de 2 (0 tant que l'index est vide)
+    uint32_t count;
+} DedupIndex;
+
+void dedup_init(DedupIndex *ix);
+void dedup_destroy(DedupIndex *ix);
+
+// Empreinte 64 bits d'un bloc. Deux blocs de même empreinte ne sont
+// partagés qu'après comparaison de leur contenu.
+uint64_t dedup_fingerprint(const void *data, size_t len);
+
+// Bloc connu pour cette empreinte : 0 et son offset, -1 s'il n'y en a pas
+int dedup_find(const DedupIndex *ix, uint64_t fingerprint, uint64_t *offset);
+
+// Associe l'empreinte au bloc (remplace le bloc déjà associé à l'une ou à
+// l'autre). -1 si la mémoire manque.
+int dedup_insert(DedupIndex *ix, uint64_t fingerprint, uint64_t offset);
+
+// Oublie les blocs de la plage [offset, offset + length)
+void dedup_forget(DedupIndex *ix, uint64_t offset, uint64_t length);
+
+#endif // DEDUP_H
@@ -0,0 +1,57 @@
+#ifndef FREEMAP_H
+#define FREEMAP_H
+
+#include <stdint.h>
+
+// Plage libre du conteneur (offset absolu, longueur en octets)
+typedef struct {
+    uint64_t offset;
+    uint64_t length;
+} FreeRun;
+
+// Index en mémoire de l'espace libre. Les mêmes plages sont rangées deux fois :
+// par offset (fusion avec les voisines) et par (longueur, offset) pour le best-fit.
+// La recherche est dichotomique (O(log n)) ; une insertion ou un retrait décale
+// la fin des deux tableaux (O(n) en nombre de plages, par memmove).
+typedef struct {
+    FreeRun *by_offset;
+    FreeRun *by_length;
+    uint32_t count;
+    uint32_t capacity;
+    uint64_t total;        // Somme des longueurs libres
+} FreeMap;
+
+void freemap_init(FreeMap *fm);
+void freemap_destroy(FreeMap *fm);
+
+// Ajoute une plage libre en la fusionnant avec ses voisines.
+// Retourne -1 si elle chevauche une plage déjà libre.
+int freemap_insert(FreeMap *fm, uint64_t offset, uint64_t length);
+
+// Retire une plage qui doit être entièrement contenue dans une plage libre
+int freemap_take(FreeMap *fm, uint64_t offset, uint64_t length);
+
+// Best-fit : plus petite plage d'au moins length octets, découpée par le début.
+// Retourne 0 et l'offset alloué, -1 si aucune plage n'est assez grande.
+int freemap_alloc_best_fit(FreeMap *fm, uint64_t length, uint64_t *offset);
+
+// First-fit par offset : plage libre la plus basse d'au moins length octets
+// qui se termine avant limit, découpée par le début. Retourne 0 et l'offset
+// alloué, -1 si aucune ne convient.
+int freemap_alloc_first_fit(FreeMap *fm, uint64_t length, uint64_t limit, uint64_t *offset);
+
+// Plus grande plage libre (0 si la carte est vide)
+const FreeRun *freemap_largest(const FreeMap *fm);
+
+// Première plage qui se termine après offset (celle qui le contient s'il est
+// libre), NULL s'il n'y en a pas. Les suivantes sont rangées derrière elle
+// dans by_offset.
+const FreeRun *freemap_next(const FreeMap *fm, uint64_t offset);
+
+// Plage libre d'offset le plus élevé (0 si la carte est vide)
+const FreeRun *freemap_last(const FreeMap *fm);
+
+// Oublie tout l'espace libre situé à partir de end (au-delà de la fin des données)
+void freemap_truncate(FreeMap *fm, uint64_t end);
+
+#endif // FREEMAP_H
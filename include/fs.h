@@ -5,13 +5,26 @@
 #include <stdio.h>
 #include <time.h>
 
+#include "checksum.h"
+#include "dedup.h"
+#include "freemap.h"
+#include "io.h"
+#include "refmap.h"
+
 #define FS_MAGIC 0x46534D47 // 'FSMG'
+#define FS_VERSION 3
 #define MAX_FILENAME 256
 #define MAX_FILES 1024
 #define BLOCK_SIZE 4096
 #define MAX_PATH 2048
-#define HASH_TABLE_SIZE 1024
-#define LRU_CACHE_SIZE 128
+#define HASH_TABLE_SIZE 1024 // Taille initiale de l'index, doublée à 7/8 de remplissage
+#define LRU_CACHE_SIZE 128   // Taille par défaut du cache d'inodes
+#define DENTRY_CACHE_SIZE 64
+#define INODE_SEGMENTS 32    // Segments au plus dans la table d'inodes
+#define INODE_SCAN_CHUNK (1024 * 1024) // Octets de table d'inodes lus d'un coup par un parcours
+#define COMPRESS_CHUNK (64 * 1024) // Octets d'un fichier compressés ensemble, décodables seuls
+#define PUNCH_MIN (64 * 1024) // Plage libérée à partir de laquelle ses blocs sont rendus à l'hôte
+#define DEFRAG_SLICE (8 * 1024 * 1024) // Octets déplacés par la défragmentation entre deux transactions
 
 typedef struct {
     uint32_t magic;
@@ -20,74 +33,604 @@ typedef struct {
     uint32_t max_files;
     uint64_t data_offset;
     uint64_t inode_table_offset;
-    uint64_t first_free_block; // Offset du premier bloc libre (0 si aucun)
-    char padding[4056];        // Aligner sur 4096 octets
+    uint64_t first_free_block; // Ancienne free list chaînée (0 si aucune)
+    uint64_t free_map_offset;  // Zone de la carte d'espace libre (0 si aucune)
+    uint64_t free_map_capacity;// Taille réservée pour cette zone, en octets
+    uint64_t data_end;         // Fin de la zone occupée, alignée sur BLOCK_SIZE
+    uint64_t name_heap_offset; // Zone du tas de noms (0 si aucune)
+    uint64_t name_heap_capacity;
+    uint64_t name_heap_size;   // Octets utilisés dans le tas de noms
+    uint64_t journal_offset;   // Zone du journal des métadonnées (0 si aucune)
+    uint64_t journal_capacity;
+    uint64_t journal_sequence; // Numéro de la prochaine transaction
+    // Table d'inodes en segments : le segment 0 (inode_table_offset) compte
+    // inode_segment_base entrées, le segment k suivant base << (k - 1). Chaque
+    // segment ajouté double la table sans recopier les inodes existants.
+    uint32_t inode_segment_base;
+    uint32_t inode_segment_count;
+    uint64_t inode_segments[INODE_SEGMENTS - 1]; // Segments 1 et suivants
+    uint64_t path_index_offset;   // Zone de l'index des entrées (0 si aucune)
+    uint64_t path_index_capacity;
+    uint64_t path_index_generation; // Avance avec chaque transaction qui modifie l'index
+    uint64_t ref_map_offset;   // Zone des compteurs de références (0 si aucune)
+    uint64_t ref_map_capacity;
+    uint64_t dedup_index_offset; // Zone de l'index des empreintes (0 si aucune)
+    uint64_t dedup_index_capacity;
+    uint32_t flags;            // SB_FLAG_*
+    uint32_t snapshot_dir;     // Répertoire caché des instantanés (0 si aucun)
+    char padding[3664];        // Aligner sur 4096 octets
 } SuperBlock;
 
+_Static_assert(sizeof(SuperBlock) == 4096, "SuperBlock : 4096 octets");
+
+#define SB_FLAG_DEDUP 0x0001 // Les données écrites sont dédupliquées par bloc
+#define SB_FLAG_SHA256 0x0002 // Les fichiers écrits reçoivent aussi un SHA-256
+
+// Ancien format de l'espace libre : un bloc par maillon, lu une seule fois à
+// l'ouverture puis remplacé par la carte d'espace libre
 typedef struct {
     uint64_t next_free_block; // Offset du bloc libre suivant
 } FreeBlock;
 
+#define FREE_MAP_MAGIC 0x464D4150 // 'FMAP'
+
+// En-tête de la carte d'espace libre sur disque, suivi de count FreeRun
+// triés par offset
+typedef struct {
+    uint32_t magic;
+    uint32_t reserved;
+    uint64_t count;
+} FreeMapHeader;
+
+#define REF_MAP_MAGIC 0x524D4150 // 'RMAP'
+
+// En-tête des compteurs de références sur disque, suivi de count RefRun
+// triés par offset
+typedef struct {
+    uint32_t magic;
+    uint32_t reserved;
+    uint64_t count;
+} RefMapHeader;
+
+#define DEDUP_INDEX_MAGIC 0x44494458 // 'DIDX'
+
+// Index des empreintes sauvegardé à la fermeture, suivi de count DedupEntry.
+// Il n'est repris que si sequence est le journal_sequence du SuperBlock :
+// après une transaction qu'il n'a pas vue, il pourrait désigner des blocs
+// réutilisés depuis.
+typedef struct {
+    uint32_t magic;
+    uint32_t reserved;
+    uint64_t sequence;
+    uint64_t count;
+    uint64_t checksum;         // FNV-1a de l'en-tête (checksum à 0) et des entrées
+} DedupIndexHeader;
+
+#define JOURNAL_MAGIC 0x4A524E4C   // 'JRNL'
+#define JOURNAL_SIZE (1024 * 1024)  // Taille initiale de la zone du journal
+#define JOURNAL_GROUP_OPS 256       // Opérations regroupées au plus par transaction
+#define JOURNAL_INTERVAL 1          // Secondes au plus entre deux transactions
+
+// Transaction du journal : en-tête suivi de record_count enregistrements
+// (JournalRecord puis length octets à écrire à offset). Les transactions se
+// suivent dans la zone ; le journal repart du début quand elle est pleine.
+typedef struct {
+    uint32_t magic;
+    uint32_t record_count;
+    uint64_t sequence;
+    uint64_t length;           // Octets d'enregistrements après l'en-tête
+    uint64_t checksum;         // FNV-1a de l'en-tête (checksum à 0) et des enregistrements
+} JournalHeader;
+
+typedef struct {
+    uint64_t offset;
+    uint64_t length;
+} JournalRecord;
+
+#define PATH_INDEX_MAGIC 0x50494458 // 'PIDX'
+
+// Index des entrées sauvegardé à la fermeture : en-tête suivi de la table de
+// hachage (hash_capacity HashEntry) puis du bitmap des inodes libres. Il
+// n'est repris à l'ouverture que si generation est le path_index_generation
+// du SuperBlock : une transaction qui crée, supprime ou renomme une entrée
+// le rend caduc, une qui ne touche qu'au contenu ou aux dates non.
+typedef struct {
+    uint32_t magic;
+    uint32_t max_files;
+    uint64_t generation;
+    uint32_t hash_capacity;
+    uint32_t hash_count;
+    uint64_t checksum;         // FNV-1a de l'en-tête (checksum à 0) et des données
+} PathIndexHeader;
+
+// Plage contiguë de données (offset absolu, longueur en octets multiple de BLOCK_SIZE)
+typedef struct {
+    uint64_t offset;
+    uint64_t length;
+} Extent;
+
+#define INODE_INLINE_EXTENTS 3
+#define EXTENT_BLOCK_MAGIC 0x45585442 // 'EXTB'
+#define EXTENTS_PER_BLOCK ((BLOCK_SIZE - 16) / sizeof(Extent))
+
+// Bloc de débordement pour les fichiers ayant plus de INODE_INLINE_EXTENTS extents
+typedef struct {
+    uint32_t magic;
+    uint32_t count;
+    uint64_t next;                         // Bloc de débordement suivant (0 si aucun)
+    Extent extents[EXTENTS_PER_BLOCK];
+} ExtentBlock;
+
+// Types d'inode
+#define INODE_FREE 0
+#define INODE_FILE 1
+#define INODE_DIR  2
+#define INODE_LINK 3 // Nom d'un fichier lié (lien physique) : voir target
+
+#define ROOT_INODE 0  // La racine est l'inode 0, son propre parent
+#define SNAPSHOT_DIR "@snap" // Nom sous la racine du répertoire des instantanés
+
+// Drapeaux d'inode
+#define INODE_FLAG_DIR_INDEX 0x0001 // Les données du répertoire listent ses enfants
+#define INODE_FLAG_COMPRESSED 0x0002 // Fichier stocké en morceaux compressés (CompressHeader)
+#define INODE_FLAG_COMPRESS   0x0004 // Répertoire : les fichiers ajoutés dessous sont compressés
+#define INODE_FLAG_CHECKSUM   0x0008 // Table des sommes après les données (ChecksumHeader)
+// Fichier lié : inode sans nom, ni dans l'index des entrées ni dans un
+// répertoire. Tous ses noms sont des INODE_LINK qui le désignent ; son parent
+// est la racine, ou le répertoire de l'instantané qui le contient.
+#define INODE_FLAG_SHARED     0x0010
+
+// Données d'un fichier compressé : l'en-tête, puis chunk_count + 1 positions
+// (relatives au début des données) où commencent les morceaux, la dernière
+// marquant la fin. Chaque morceau redonne chunk_size octets (moins pour le
+// dernier) et se décode seul ; COMPRESS_RAW marque un morceau gardé tel quel.
+#define COMPRESS_MAGIC 0x5A4C4348 // 'HCLZ'
+#define COMPRESS_RAW (1ULL << 63)
+
+typedef struct {
+    uint32_t magic;
+    uint32_t chunk_size;
+    uint64_t chunk_count;
+} CompressHeader;
+
+// Sommes de contrôle d'un fichier, rangées dans ses extents à partir du bloc
+// checksum_block, après les données stockées : l'en-tête puis un CRC32C par
+// bloc de BLOCK_SIZE octets du contenu (décodé pour un fichier compressé).
+// table_crc couvre l'en-tête (table_crc à 0) et les CRC.
+#define CHECKSUM_MAGIC 0x4D555343 // 'CSUM'
+#define CHECKSUM_SHA256 0x0001    // sha256 est rempli
+
+typedef struct {
+    uint32_t magic;
+    uint32_t block_size;
+    uint64_t block_count;
+    uint32_t flags;
+    uint32_t table_crc;
+    uint8_t sha256[SHA256_SIZE]; // Du contenu entier
+} ChecksumHeader;
+
+// Inode v3 : 128 octets. Le nom est rangé dans le tas de noms, le chemin se
+// déduit de la chaîne des parents.
+typedef struct {
+    uint16_t type;                // INODE_FREE, INODE_FILE, INODE_DIR ou INODE_LINK
+    uint16_t flags;
+    uint32_t mode;                // Permissions Unix
+    uint32_t uid;
+    uint32_t gid;
+    uint32_t link_count;          // Fichier lié : liens qui le désignent
+    uint32_t parent;              // Inode du répertoire parent
+    uint32_t extent_count;        // Nombre d'extents
+    union {
+        uint32_t checksum_block;  // Début de la table des sommes dans les extents (en blocs)
+        uint32_t target;          // INODE_LINK : inode du fichier désigné
+    };
+    uint64_t name_offset;         // Position du nom dans le tas de noms
+    uint64_t size;
+    time_t created;
+    time_t modified;
+    time_t accessed;
+    uint64_t extent_block;        // Premier bloc de débordement des extents (0 si aucun)
+    Extent extents[INODE_INLINE_EXTENTS];
+} Inode;
+
+_Static_assert(sizeof(Inode) == 128, "Inode v3 : 128 octets");
+
+// Ancien inode (v2), lu uniquement par fs_upgrade
 typedef struct {
     char filename[MAX_FILENAME];
     char parent_path[MAX_PATH];
     uint32_t is_directory;
     uint64_t size;
-    uint64_t offset;
+    uint64_t offset;              // Début des données (si extent_count vaut 0)
     time_t created;
     time_t modified;
-    time_t accessed;              // NOUVEAU : dernier acces
-    uint32_t uid;                 // NOUVEAU : proprietaire
-    uint32_t gid;                 // NOUVEAU : groupe
-    uint32_t mode;                // NOUVEAU : permissions Unix
-    uint32_t link_count;          // NOUVEAU : nombre de hard links
-    uint64_t inode_number;        // NOUVEAU : numero unique
-    char checksum[32];            // NOUVEAU : SHA256 du contenu
-    uint32_t compression;         // NOUVEAU : type de compression
-    uint32_t encryption;          // NOUVEAU : type de chiffrement
-    uint32_t flags;               // NOUVEAU : flags divers
-    char reserved[64];            // Reserve pour extensions futures
-} Inode;
+    time_t accessed;
+    uint32_t uid;
+    uint32_t gid;
+    uint32_t mode;
+    uint32_t link_count;
+    uint64_t inode_number;
+    char checksum[32];
+    uint32_t compression;
+    uint32_t encryption;
+    uint32_t flags;
+    uint32_t extent_count;
+    uint64_t extent_block;
+    Extent extents[INODE_INLINE_EXTENTS];
+    char reserved[8];
+} InodeV2;
 
+// Tas de noms : noms des inodes terminés par '\0', chargé entièrement en
+// mémoire. Les nouveaux noms sont ajoutés en fin ; les noms supprimés ne sont
+// récupérés qu'au compactage.
 typedef struct {
+    char *data;
+    uint64_t size;        // Octets utilisés
+    uint64_t capacity;    // Taille allouée en mémoire
+    uint64_t flushed;     // Octets déjà écrits dans la zone sur disque
+    uint64_t garbage;     // Octets occupés par des noms supprimés ou remplacés
+} NameHeap;
+
+// Entree de répertoire : (inode parent, nom) -> inode
+typedef struct {
+    uint64_t hash;        // Hash complet de (parent, nom)
     int inode_index;      // Index dans la table d'Inodes (-1 si non utilise)
-    char full_path[MAX_PATH];
+    uint32_t parent;      // Inode du répertoire parent
+    uint64_t name_offset; // Nom dans le tas de noms
 } HashEntry;
 
+// Chemin complet d'un répertoire, valable tant que generation est celle du
+// cache (elle change à chaque déplacement ou suppression de répertoire)
+typedef struct {
+    int inode_index;
+    uint32_t generation;
+    char path[MAX_PATH];
+} DentryCacheEntry;
+
+// Enfants d'un répertoire (numéros d'inode), chargés à la demande depuis les
+// données du répertoire et réécrits à la fermeture s'ils ont changé
+typedef struct {
+    uint32_t *children;
+    uint32_t count;
+    uint32_t capacity;
+    int dirty;
+} DirIndex;
+
+// Segments du cache d'inodes : un inode lu une seule fois reste en période
+// d'essai, il ne passe dans le segment protégé qu'à sa relecture. Un parcours
+// complet ne renouvelle donc que le segment d'essai.
+#define CACHE_PROBATION 0
+#define CACHE_PROTECTED 1
+
 typedef struct CacheNode {
     int inode_index;
     Inode inode;
     int dirty;
+    int segment;                  // CACHE_PROBATION ou CACHE_PROTECTED
     struct CacheNode *prev;
     struct CacheNode *next;
+    struct CacheNode *hash_next;  // Chaînage dans l'index par numéro d'inode
 } CacheNode;
 
 typedef struct {
-    FILE *container;
+    CacheNode *head;              // Plus récemment utilisé
+    CacheNode *tail;              // Prochain évincé
+    uint32_t count;
+} CacheList;
+
+// Compteurs du cache d'inodes, depuis l'ouverture
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t writebacks;          // Inodes sales écrits lors d'une éviction
+    uint32_t size;                // Inodes actuellement en cache
+    uint32_t protected_count;     // Dont inodes du segment protégé
+    uint32_t capacity;
+} FsCacheStats;
+
+// Index des enregistrements de la transaction en construction, par offset
+typedef struct {
+    uint64_t offset;
+    size_t pos;                // Position de l'enregistrement dans buf, plus 1 (0 : case libre)
+} JournalSlot;
+
+// Transaction en cours. Les réécritures en place des métadonnées (SuperBlock,
+// inodes, carte d'espace libre, index de répertoires) n'atteignent leur place
+// qu'après l'écriture de la transaction dans le journal ; l'espace libéré
+// n'est réutilisable qu'une fois la transaction validée. Mode ordonné : les
+// données et zones neuves écrites directement sont rendues durables avant
+// la transaction qui les désigne.
+typedef struct {
+    uint8_t *buf;              // Enregistrements de la transaction en construction
+    size_t len;
+    size_t capacity;
+    uint32_t records;
+    JournalSlot *slots;        // Une réécriture de la même zone remplace la précédente
+    uint32_t slot_mask;
+    uint32_t slot_count;
+    uint64_t head;             // Position de la prochaine transaction dans la zone
+    uint32_t ops;              // Opérations depuis la dernière transaction
+    uint32_t depth;            // Transactions explicites ouvertes (fs_txn_begin)
+    time_t last_commit;
+    FreeMap pending_free;      // Espace libéré depuis la dernière transaction
+    SuperBlock committed;      // SuperBlock de la dernière transaction validée
+    uint64_t checkpoint_writes; // io_write_count après sa mise en place
+} Journal;
+
+// Vérification des sommes de contrôle à la lecture
+#define FS_VERIFY_OFF    1 // Aucune
+#define FS_VERIFY_WARN   2 // Un bloc corrompu est signalé, la lecture continue
+#define FS_VERIFY_STRICT 3 // La lecture s'arrête au premier bloc corrompu
+
+// Options d'ouverture (champs à zéro : valeurs par défaut)
+typedef struct {
+    uint32_t cache_size;  // Inodes gardés en cache (LRU_CACHE_SIZE par défaut)
+    int io_backend;       // IO_BACKEND_* (par défaut : variable CSFS_IO, sinon pread)
+    int verify;           // FS_VERIFY_* (par défaut : variable CSFS_VERIFY, sinon strict)
+} FsOpenOptions;
+
+typedef struct {
+    IoFile *container;
     SuperBlock sb;
-    HashEntry hash_table[HASH_TABLE_SIZE];  // Index pour recherche rapide O(1)
+    // Index des entrées de répertoire (Robin Hood, capacité puissance de 2)
+    HashEntry *hash_table;
+    uint32_t hash_capacity;
+    uint32_t hash_count;
+    int path_index_changed;  // Entrées modifiées depuis la dernière transaction
+    int path_index_current;  // L'index sauvegardé décrit le dernier état validé
+    DentryCacheEntry dentry_cache[DENTRY_CACHE_SIZE]; // Chemins des répertoires récents
+    uint32_t dentry_generation;
+    FreeMap free_map;                       // Espace libre, chargé à l'ouverture
+    RefMap ref_map;                         // Données partagées, chargées à l'ouverture
+    int ref_map_changed;                    // À réécrire à la prochaine transaction
+    DedupIndex dedup;                       // Empreintes des blocs écrits en mode dédupliqué
+    int dedup_current;                      // L'index sauvegardé est celui en mémoire
+    NameHeap names;                         // Noms des inodes
+    Journal journal;
+    int verify;                             // FS_VERIFY_*, pour les lectures
+
+    // Bitmap des inodes libres (bit à 1 : inode libre). Les mots avant
+    // inode_hint ne contiennent aucun inode libre.
+    uint64_t *inode_bitmap;
+    uint32_t inode_bitmap_words;
+    uint32_t inode_hint;
+
+    // Index des enfants par répertoire (NULL tant qu'il n'est pas chargé)
+    DirIndex **dirs;
+    uint32_t dirs_capacity;
     
-    // Cache LRU
-    CacheNode *cache_head;
-    CacheNode *cache_tail;
+    // Cache d'inodes (LRU segmenté), indexé par numéro d'inode
+    CacheList cache_probation;
+    CacheList cache_protected;
+    uint32_t cache_protected_max;
+    int cache_scan;             // Parcours en cours : pas de promotion
+    FsCacheStats cache_stats;
+    CacheNode *cache_pool;      // cache_capacity noeuds alloués à l'ouverture
+    CacheNode **cache_buckets;  // Index par numéro d'inode (chaînage)
+    uint32_t cache_bucket_mask;
     int cache_count;
-    CacheNode *cache_nodes[LRU_CACHE_SIZE]; // Pour un accès rapide par index de cache
+    int cache_capacity;
+    uint32_t cache_dirty;       // Inodes modifiés en attente de la prochaine transaction
 } FileSystem;
 
 int fs_create(const char *path);
+int fs_upgrade(const char *path);
 FileSystem *fs_open(const char *path);
+FileSystem *fs_open_with(const char *path, const FsOpenOptions *options);
 void fs_close(FileSystem *fs);
 
+// Valide les modifications en attente dans le journal (elles le sont aussi
+// par groupes, au fil des opérations, et à la fermeture)
+int fs_sync(FileSystem *fs);
+
+// Transaction explicite pour les opérations en masse : les opérations
+// jusqu'au fs_txn_commit correspondant (les appels s'imbriquent) sont
+// validées ensemble, en une écriture triée et fusionnée. Une transaction qui
+// dépasse la moitié du journal est validée en plusieurs fois, toujours entre
+// deux opérations.
+void fs_txn_begin(FileSystem *fs);
+int fs_txn_commit(FileSystem *fs);
+
+// État de fragmentation des données
+typedef struct {
+    uint32_t files;         // Inodes ayant des données (fichiers et répertoires)
+    uint32_t fragmented;    // Dont en plusieurs extents
+    uint64_t extents;       // Nombre total d'extents
+    uint64_t data_bytes;    // Taille cumulée des contenus
+    uint64_t free_bytes;    // Espace libre avant la fin des données
+    uint32_t free_runs;     // En combien de plages
+    uint64_t largest_free;  // Plus grande plage libre
+    uint64_t data_end;      // Fin des données
+} FsFragStats;
+
+// Budget d'une passe de défragmentation (0 : pas de limite)
+typedef struct {
+    uint32_t time_ms;       // Durée maximale
+    uint64_t bytes;         // Octets déplacés au maximum
+} FsDefragOptions;
+
+typedef struct {
+    FsFragStats before;
+    FsFragStats after;
+    uint32_t files_moved;
+    uint64_t bytes_moved;
+    int complete;           // 0 si la passe s'est arrêtée sur le budget
+} FsDefragResult;
+
+int fs_frag_stats(FileSystem *fs, FsFragStats *stats);
+
+// Défragmentation incrémentale : les contenus sont recopiés d'un seul tenant
+// dans la plage libre la plus basse, en commençant par ceux qui finissent le
+// plus loin, puis la fin des données est ramenée sur le dernier octet
+// occupé. Chaque tranche est validée par sa propre transaction : l'image
+// reste cohérente si la passe est interrompue, et une nouvelle passe reprend
+// là où en était la précédente.
+int fs_defrag(FileSystem *fs, const FsDefragOptions *options, FsDefragResult *result);
+
+typedef struct {
+    uint64_t size_before;   // Taille du conteneur
+    uint64_t size_after;
+    uint64_t punched;       // Espace libre rendu à l'hôte en perçant des trous
+} FsTrimResult;
+
+// Rend l'espace libre à l'hôte : le conteneur est tronqué à la fin des
+// données et les plages libres qui restent avant sont percées. Les plages
+// libérées d'au moins PUNCH_MIN octets le sont déjà à chaque transaction.
+int fs_trim(FileSystem *fs, FsTrimResult *result);
+
+typedef struct {
+    int enabled;            // Mode dédupliqué actif
+    uint64_t indexed_blocks;// Blocs dont l'empreinte est connue
+    uint64_t file_bytes;    // Taille cumulée des fichiers
+    uint64_t shared_bytes;  // Données référencées plusieurs fois
+    uint64_t saved_bytes;   // Octets qu'occuperaient les copies séparées
+} FsDedupStats;
+
+// Mode dédupliqué, gardé dans l'image : chaque bloc des fichiers ajoutés ou
+// copiés est comparé (empreinte, puis contenu) aux blocs déjà écrits dans ce
+// mode, et un bloc identique est partagé au lieu d'être recopié. Un bloc
+// partagé n'est libéré qu'avec sa dernière référence.
+int fs_set_dedup(FileSystem *fs, int enable);
+int fs_dedup_stats(FileSystem *fs, FsDedupStats *stats);
+
+// Sommes de contrôle : chaque fichier écrit reçoit un CRC32C par bloc de son
+// contenu, et son SHA-256 entier si le réglage est actif (gardé dans
+// l'image). Les lectures les vérifient selon fs->verify.
+int fs_set_sha256(FileSystem *fs, int enable);
+void fs_set_verify(FileSystem *fs, int policy);
+// "off", "warn" ou "strict" -> FS_VERIFY_*, 0 si le nom est inconnu
+int fs_verify_from_name(const char *name);
+
+typedef struct {
+    uint64_t blocks;                // Blocs couverts par un CRC32C
+    int has_sha256;
+    uint8_t sha256[SHA256_SIZE];
+} FsChecksumInfo;
+
+// Sommes d'un fichier : 0 et info, 1 s'il n'en a pas, -1 si la table est
+// illisible
+int fs_checksum_info(FileSystem *fs, const Inode *inode, FsChecksumInfo *info);
+
+// Résolution de chemins : index de l'inode d'un chemin absolu (-1 si absent),
+// nom d'un inode (chaîne vide pour la racine) et chemin absolu d'un inode
+int fs_lookup(FileSystem *fs, const char *path);
+const char *fs_inode_name(FileSystem *fs, const Inode *inode);
+int fs_inode_path(FileSystem *fs, int inode_index, char *out, size_t size);
+
 int fs_mkdir(FileSystem *fs, const char *path);
 int fs_add_file(FileSystem *fs, const char *fs_path, const char *source_path);
+// Remplace le contenu du fichier fs_path (lien suivi) par celui de
+// source_path. L'inode reste le même : tous les noms d'un fichier lié voient
+// le nouveau contenu.
+int fs_write_file(FileSystem *fs, const char *fs_path, const char *source_path);
 int fs_extract_file(FileSystem *fs, const char *fs_path, const char *dest_path);
+// Clone : la copie partage les extents de la source (une référence de plus
+// sur chacun), sans lire ni écrire de données
 int fs_copy_file(FileSystem *fs, const char *src_path, const char *dest_path);
 int fs_move_file(FileSystem *fs, const char *src_path, const char *dest_path);
+// Lien physique : link_path devient un nom de plus pour le fichier
+// target_path. Au premier lien, le contenu passe dans un inode sans nom
+// (INODE_FLAG_SHARED) et le nom d'origine devient lui aussi un INODE_LINK :
+// retirer un nom décrémente le compteur, les données partent avec le dernier.
+int fs_link(FileSystem *fs, const char *target_path, const char *link_path);
+// Inode qui porte le contenu d'une entrée : le fichier désigné par un lien,
+// l'entrée elle-même sinon. fs_lookup suit déjà les liens.
+int fs_link_target(FileSystem *fs, int inode_index);
 void fs_list(FileSystem *fs, const char *path);
 void fs_list_recursive(FileSystem *fs, const char *path, int depth);
+int fs_remove(FileSystem *fs, const char *path);
 
-// Fonctions pour le cache d'inodes
+// Compression : sur un répertoire, active (ou désactive) la compression des
+// fichiers ajoutés dessous, sous-répertoires créés ensuite compris ; sur un
+// fichier, le réécrit compressé (ou en clair). Un fichier qui ne gagne pas
+// au moins un bloc reste en clair.
+int fs_set_compression(FileSystem *fs, const char *path, int enable);
+
+// Instantanés : un instantané fige l'arborescence entière sous
+// /@snap/<nom>, répertoire absent des listes de la racine mais accessible
+// par son chemin. Chaque entrée y est recopiée (inode et nom), les fichiers
+// en clones qui partagent leurs extents avec l'arborescence vivante : le
+// coût est celui des métadonnées, pas des données. Ce qui est rangé sous
+// /@snap est en lecture seule. La restauration remplace l'arborescence
+// vivante par des clones de l'instantané, qui est gardé.
+int fs_snapshot_create(FileSystem *fs, const char *name);
+int fs_snapshot_restore(FileSystem *fs, const char *name);
+int fs_snapshot_delete(FileSystem *fs, const char *name);
+void fs_snapshot_list(FileSystem *fs);
+// 1 si l'entrée est rangée sous /@snap (lui compris)
+int fs_in_snapshot(FileSystem *fs, int inode_index);
+
+// Parcours des enfants d'un répertoire. L'itérateur travaille sur une copie :
+// le répertoire peut être modifié pendant le parcours. Tant qu'il est ouvert,
+// le cache d'inodes est en mode parcours (voir fs_cache_scan_begin).
+typedef struct {
+    FileSystem *fs;
+    uint32_t *children;
+    uint32_t count;
+    uint32_t pos;
+} FsDirIter;
+
+int fs_dir_open(FileSystem *fs, int dir_index, FsDirIter *iter);
+int fs_dir_next(FsDirIter *iter);   // Inode suivant, -1 à la fin
+void fs_dir_close(FsDirIter *iter);
+
+// Lecture du contenu d'un fichier à travers ses extents. Un fichier compressé
+// est décodé morceau par morceau : seuls ceux qui contiennent les octets lus
+// le sont. Chaque bloc touché est vérifié avec sa somme de contrôle selon
+// fs->verify ; en mode strict, la lecture s'arrête avant un bloc corrompu
+// (corrupt n'est plus nul). Un morceau compressé qui ne se décode pas arrête
+// la lecture dans tous les modes (failed). Une lecture interrompue laisse
+// remaining non nul : ce qui a été lu n'est pas le contenu entier.
+typedef struct {
+    FileSystem *fs;
+    Extent *extents;
+    uint32_t count;
+    uint32_t current;     // Extent en cours de lecture
+    uint64_t ext_pos;     // Position dans l'extent courant
+    uint64_t remaining;   // Octets restant à lire
+    uint64_t pos;         // Position dans le contenu
+    uint64_t *chunks;     // Fichier compressé : positions des morceaux (NULL sinon)
+    uint64_t chunk_count;
+    uint32_t chunk_size;
+    uint8_t *chunk;       // Morceau décodé
+    uint8_t *packed;      // Morceau tel que stocké
+    uint64_t chunk_index; // Morceau présent dans chunk (chunk_count si aucun)
+    size_t chunk_len;
+    uint32_t *sums;       // CRC32C des blocs du contenu (NULL sans vérification)
+    uint64_t sum_count;
+    uint64_t verified_from; // Blocs [verified_from, verified_to) déjà vérifiés
+    uint64_t verified_to;
+    uint8_t *block;       // Bloc relu quand la lecture n'en couvre qu'une partie
+    int check_sha;        // SHA-256 attendu, calculé tant que la lecture est suivie
+    Sha256 sha;
+    uint64_t sha_pos;
+    uint8_t sha256[SHA256_SIZE];
+    uint64_t corrupt;     // Blocs dont la somme ne correspond pas, morceaux illisibles
+    int failed;           // Morceau illisible : la lecture est arrêtée
+} FsReader;
+
+int fs_reader_open(FileSystem *fs, const Inode *inode, FsReader *reader);
+size_t fs_reader_read(FsReader *reader, void *buf, size_t len);
+// Place la lecture à pos octets du début du contenu (au plus sa taille)
+int fs_reader_seek(FsReader *reader, uint64_t pos);
+// Sans copie : pointeur vers les octets suivants dans la projection du
+// conteneur (backend mmap) ou dans le morceau décodé, valable jusqu'à la
+// prochaine écriture ou lecture. NULL à la fin ou si le conteneur n'est pas
+// projeté : fs_reader_read lit alors la suite.
+const void *fs_reader_map(FsReader *reader, size_t *len);
+void fs_reader_close(FsReader *reader);
+
+// Fonctions pour le cache d'inodes. mark_inode_dirty prend le pointeur rendu
+// par get_inode, sans nouvelle recherche : il doit être utilisé avant que
+// d'autres accès au cache ne puissent l'évincer.
 Inode* get_inode(FileSystem *fs, int inode_index);
-void mark_inode_dirty(FileSystem *fs, int inode_index);
+void mark_inode_dirty(FileSystem *fs, Inode *inode);
+
+// Parcours séquentiel : entre ces deux appels (imbricables), les inodes lus
+// restent en période d'essai et n'évincent pas ceux du segment protégé.
+void fs_cache_scan_begin(FileSystem *fs);
+void fs_cache_scan_end(FileSystem *fs);
+void fs_cache_stats(FileSystem *fs, FsCacheStats *stats);
 
 #endif // FS_H
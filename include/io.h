@@ -0,0 +1,80 @@
+#ifndef IO_H
+#define IO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+// Backends d'accès au conteneur
+#define IO_BACKEND_PREAD 1  // pread/pwrite sur un descripteur, sans curseur partagé
+#define IO_BACKEND_MMAP  2  // Projection du fichier entier, remappée quand il grandit
+
+// Indications de lecture (io_advise)
+#define IO_ADVISE_SEQUENTIAL 1  // La plage sera lue dans l'ordre : lecture anticipée plus large
+#define IO_ADVISE_WILLNEED   2  // La plage sera lue bientôt : la charger dès maintenant
+
+// Conteneur ouvert. Tous les accès se font à un offset absolu 64 bits : aucun
+// curseur n'est partagé entre deux opérations.
+typedef struct {
+    int backend;
+    int fd;
+    uint8_t *map;         // Projection (backend mmap)
+    uint64_t map_size;    // Taille réservée pour la projection, au moins size
+    uint64_t size;        // Taille du fichier (backend mmap)
+    uint64_t writes;      // Écritures faites depuis l'ouverture
+    uint64_t synced;      // Valeur de writes au dernier io_sync réussi
+} IoFile;
+
+// Ouvre un conteneur existant en lecture/écriture, ou en crée un vide
+// (io_create). NULL en cas d'échec (errno est positionné).
+IoFile *io_open(const char *path, int backend);
+IoFile *io_create(const char *path);
+void io_close(IoFile *io);
+
+// Lit ou écrit len octets à offset : retourne le nombre d'octets transférés,
+// inférieur à len seulement en fin de fichier ou sur erreur. Une écriture
+// au-delà de la fin agrandit le fichier.
+size_t io_read(IoFile *io, uint64_t offset, void *buf, size_t len);
+size_t io_write(IoFile *io, uint64_t offset, const void *buf, size_t len);
+
+// Variantes vectorisées (preadv/pwritev) : count segments mémoire transférés
+// d'un seul tenant à partir de offset dans le conteneur
+size_t io_readv(IoFile *io, uint64_t offset, const struct iovec *iov, int count);
+size_t io_writev(IoFile *io, uint64_t offset, const struct iovec *iov, int count);
+
+// Accès direct à len octets du conteneur, sans copie. NULL si le backend ne
+// projette pas le fichier ou si la plage dépasse sa fin. Le pointeur n'est
+// valable que jusqu'à la prochaine écriture.
+const void *io_map(IoFile *io, uint64_t offset, size_t len);
+
+uint64_t io_size(IoFile *io);
+
+// Indique au noyau comment len octets à offset vont être lus (IO_ADVISE_*).
+// Simple indication : sans effet là où posix_fadvise n'existe pas.
+void io_advise(IoFile *io, uint64_t offset, uint64_t len, int advice);
+
+// Agrandit le fichier jusqu'à size octets (sans effet s'il est déjà plus grand)
+int io_extend(IoFile *io, uint64_t size);
+
+// Rend à l'hôte les blocs de len octets à offset (FALLOC_FL_PUNCH_HOLE) : la
+// plage se lit ensuite comme des zéros et la taille du fichier ne change pas.
+// -1 si le système de fichiers hôte ne sait pas faire de trous.
+int io_punch(IoFile *io, uint64_t offset, uint64_t len);
+
+// Ramène le fichier à size octets
+int io_truncate(IoFile *io, uint64_t size);
+
+// Force l'écriture sur disque de ce qui a déjà été écrit
+int io_sync(IoFile *io);
+
+// Nombre d'écritures faites depuis l'ouverture : deux relevés égaux encadrent
+// une période sans écriture
+uint64_t io_write_count(IoFile *io);
+// Vrai si des écritures attendent io_sync
+int io_unsynced(IoFile *io);
+
+// "pread" ou "mmap" -> IO_BACKEND_*, 0 si le nom est inconnu
+int io_backend_from_name(const char *name);
+const char *io_backend_name(int backend);
+
+#endif // IO_H
@@ -0,0 +1,20 @@
+#ifndef LZ_H
+#define LZ_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Compression LZ77 rapide, au format des blocs LZ4 : des séquences (littéraux
+// puis copie d'au plus 64 Kio en arrière), sans en-tête ni somme de contrôle.
+// Chaque bloc se décode seul.
+
+// Compresse len octets dans dst (cap octets au plus). Retourne la taille
+// compressée, ou 0 si elle ne tient pas dans cap : le bloc ne se compresse
+// pas assez et doit être gardé tel quel.
+size_t lz_compress(const uint8_t *src, size_t len, uint8_t *dst, size_t cap);
+
+// Décode un bloc qui doit redonner exactement out_len octets. -1 si le bloc
+// est corrompu (aucune lecture ni écriture hors des tampons).
+int lz_decompress(const uint8_t *src, size_t len, uint8_t *dst, size_t out_len);
+
+#endif // LZ_H
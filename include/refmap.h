@@ -0,0 +1,48 @@
+#ifndef REFMAP_H
+#define REFMAP_H
+
+#include <stdint.h>
+
+// Plage de données partagée (offset absolu, longueur en octets) : refs
+// références en plus de la première
+typedef struct {
+    uint64_t offset;
+    uint64_t length;
+    uint64_t refs;
+} RefRun;
+
+// Compteurs de références des données partagées entre plusieurs contenus.
+// Seules les plages référencées plus d'une fois y figurent, triées par offset,
+// disjointes, deux voisines contiguës n'ayant jamais le même compteur.
+typedef struct {
+    RefRun *runs;
+    uint32_t count;
+    uint32_t capacity;
+} RefMap;
+
+// Reçoit une plage qui n'est plus référencée du tout
+typedef void (*RefRelease)(void *ctx, uint64_t offset, uint64_t length);
+
+void refmap_init(RefMap *rm);
+void refmap_destroy(RefMap *rm);
+
+// Ajoute une référence à chaque octet de la plage. -1 si la mémoire manque.
+int refmap_add(RefMap *rm, uint64_t offset, uint64_t length);
+
+// Retire une référence à chaque octet de la plage : les parties qui n'en
+// avaient pas d'autre sont passées à release. -1 si la mémoire manque (rien
+// n'est alors modifié).
+int refmap_drop(RefMap *rm, uint64_t offset, uint64_t length, RefRelease release, void *ctx);
+
+// Octets de la plage référencés plus d'une fois
+uint64_t refmap_shared(const RefMap *rm, uint64_t offset, uint64_t length);
+
+// Octets économisés par le partage : somme des longueurs par le nombre de
+// références en plus
+uint64_t refmap_saved(const RefMap *rm);
+
+// Ajoute une plage à la fin, pour le chargement. -1 si elle n'est pas après
+// la dernière, si refs vaut 0 ou si la mémoire manque.
+int refmap_append(RefMap *rm, uint64_t offset, uint64_t length, uint64_t refs);
+
+#endif // REFMAP_H
@@ -0,0 +1,266 @@
+#include "../../include/checksum.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <nmmintrin.h>
+#define CRC32C_HW 1
+#endif
+
+#define CRC32C_POLY 0x82F63B78 // Castagnoli, bits inversés
+
+// Longueurs des trois flux entrelacés : LONG pour les gros tampons, SHORT
+// pour les blocs du conteneur
+#define CRC32C_LONG 8192
+#define CRC32C_SHORT 256
+
+static uint32_t crc_table[8][256];  // Tables logicielles (slicing-by-8)
+static int crc_tables_ready;
+
+static void crc_tables_init(void) {
+    for (uint32_t n = 0; n < 256; n++) {
+        uint32_t crc = n;
+        for (int k = 0; k < 8; k++) crc = crc & 1 ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+        crc_table[0][n] = crc;
+    }
+    for (uint32_t n = 0; n < 256; n++) {
+        for (int k = 1; k < 8; k++) {
+            crc_table[k][n] = (crc_table[k - 1][n] >> 8) ^ crc_table[0][crc_table[k - 1][n] & 0xff];
+        }
+    }
+    crc_tables_ready = 1;
+}
+
+static uint32_t load32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// Registre brut (sans les inversions d'entrée et de sortie), huit octets à
+// la fois
+static uint32_t crc32c_sw(uint32_t crc, const uint8_t *p, size_t len) {
+    while (len > 0 && ((uintptr_t)p & 7) != 0) {
+        crc = (crc >> 8) ^ crc_table[0][(crc ^ *p++) & 0xff];
+        len--;
+    }
+    while (len >= 8) {
+        uint32_t lo = crc ^ load32(p);
+        uint32_t hi = load32(p + 4);
+        crc = crc_table[7][lo & 0xff] ^ crc_table[6][(lo >> 8) & 0xff] ^ crc_table[5][(lo >> 16) & 0xff] ^
+              crc_table[4][lo >> 24] ^ crc_table[3][hi & 0xff] ^ crc_table[2][(hi >> 8) & 0xff] ^
+              crc_table[1][(hi >> 16) & 0xff] ^ crc_table[0][hi >> 24];
+        p += 8;
+        len -= 8;
+    }
+    while (len > 0) {
+        crc = (crc >> 8) ^ crc_table[0][(crc ^ *p++) & 0xff];
+        len--;
+    }
+    return crc;
+}
+
+#ifdef CRC32C_HW
+
+// Décalage du registre de len octets nuls, pour recoller les flux : le CRC
+// est linéaire, l'image de chaque bit suffit à construire les tables
+static uint32_t shift_long[4][256];
+static uint32_t shift_short[4][256];
+
+static void shift_table_init(uint32_t table[4][256], size_t len) {
+    static const uint8_t zeros[CRC32C_LONG];
+    uint32_t basis[32];
+    for (int bit = 0; bit < 32; bit++) basis[bit] = crc32c_sw(1U << bit, zeros, len);
+    for (int k = 0; k < 4; k++) {
+        table[k][0] = 0;
+        for (uint32_t v = 1; v < 256; v++) {
+            table[k][v] = table[k][v & (v - 1)] ^ basis[8 * k + __builtin_ctz(v)];
+        }
+    }
+}
+
+static uint32_t crc_shift(uint32_t table[4][256], uint32_t crc) {
+    return table[0][crc & 0xff] ^ table[1][(crc >> 8) & 0xff] ^ table[2][(crc >> 16) & 0xff] ^
+           table[3][crc >> 24];
+}
+
+static uint64_t load64(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// Trois flux indépendants font tourner l'unité crc32 à plein débit (une
+// instruction par cycle malgré sa latence de trois) ; les résultats
+// intermédiaires sont recollés par décalage
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw(uint32_t crc, const uint8_t *p, size_t len) {
+    uint64_t c0 = crc;
+    while (len > 0 && ((uintptr_t)p & 7) != 0) {
+        c0 = _mm_crc32_u8((uint32_t)c0, *p++);
+        len--;
+    }
+
+    static const size_t strides[2] = { CRC32C_LONG, CRC32C_SHORT };
+    for (int s = 0; s < 2; s++) {
+        size_t stride = strides[s];
+        while (len >= 3 * stride) {
+            uint64_t c1 = 0, c2 = 0;
+            const uint8_t *end = p + stride;
+            do {
+                c0 = _mm_crc32_u64(c0, load64(p));
+                c1 = _mm_crc32_u64(c1, load64(p + stride));
+                c2 = _mm_crc32_u64(c2, load64(p + 2 * stride));
+                p += 8;
+            } while (p < end);
+            uint32_t (*table)[256] = s == 0 ? shift_long : shift_short;
+            c0 = crc_shift(table, (uint32_t)c0) ^ c1;
+            c0 = crc_shift(table, (uint32_t)c0) ^ c2;
+            p += 2 * stride;
+            len -= 3 * stride;
+        }
+    }
+
+    while (len >= 8) {
+        c0 = _mm_crc32_u64(c0, load64(p));
+        p += 8;
+        len -= 8;
+    }
+    while (len > 0) {
+        c0 = _mm_crc32_u8((uint32_t)c0, *p++);
+        len--;
+    }
+    return (uint32_t)c0;
+}
+
+#endif // CRC32C_HW
+
+static int crc_hw = -1; // -1 : pas encore déterminé
+
+static void crc_init(void) {
+    if (!crc_tables_ready) crc_tables_init();
+    crc_hw = 0;
+#ifdef CRC32C_HW
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2")) {
+        shift_table_init(shift_long, CRC32C_LONG);
+        shift_table_init(shift_short, CRC32C_SHORT);
+        crc_hw = 1;
+    }
+#endif
+}
+
+uint32_t crc32c(uint32_t crc, const void *data, size_t len) {
+    if (crc_hw < 0) crc_init();
+    crc = ~crc;
+#ifdef CRC32C_HW
+    if (crc_hw) return ~crc32c_hw(crc, data, len);
+#endif
+    return ~crc32c_sw(crc, data, len);
+}
+
+const char *crc32c_impl(void) {
+    if (crc_hw < 0) crc_init();
+    return crc_hw ? "sse4.2" : "logicielle";
+}
+
+// --- SHA-256 (FIPS 180-4) ---
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static uint32_t rotr32(uint32_t v, int r) {
+    return (v >> r) | (v << (32 - r));
+}
+
+static void sha256_block(Sha256 *ctx, const uint8_t *p) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (uint32_t)p[4 * i] << 24 | (uint32_t)p[4 * i + 1] << 16 | (uint32_t)p[4 * i + 2] << 8 |
+               p[4 * i + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = rotr32(w[i - 15], 7) ^ rotr32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = rotr32(w[i - 2], 17) ^ rotr32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = ctx->state[0], b = ctx->state[1], c = ctx->state[2], d = ctx->state[3];
+    uint32_t e = ctx->state[4], f = ctx->state[5], g = ctx->state[6], h = ctx->state[7];
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = h + (rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25)) + ((e & f) ^ (~e & g)) +
+                      sha256_k[i] + w[i];
+        uint32_t t2 = (rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    ctx->state[0] += a;
+    ctx->state[1] += b;
+    ctx->state[2] += c;
+    ctx->state[3] += d;
+    ctx->state[4] += e;
+    ctx->state[5] += f;
+    ctx->state[6] += g;
+    ctx->state[7] += h;
+}
+
+void sha256_init(Sha256 *ctx) {
+    static const uint32_t initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+    memcpy(ctx->state, initial, sizeof(initial));
+    ctx->length = 0;
+}
+
+void sha256_update(Sha256 *ctx, const void *data, size_t len) {
+    const uint8_t *p = data;
+    size_t used = (size_t)(ctx->length % 64);
+    ctx->length += len;
+
+    if (used > 0) {
+        size_t n = 64 - used < len ? 64 - used : len;
+        memcpy(ctx->buffer + used, p, n);
+        p += n;
+        len -= n;
+        if (used + n < 64) return;
+        sha256_block(ctx, ctx->buffer);
+    }
+    for (; len >= 64; p += 64, len -= 64) sha256_block(ctx, p);
+    memcpy(ctx->buffer, p, len);
+}
+
+void sha256_final(Sha256 *ctx, uint8_t digest[SHA256_SIZE]) {
+    uint64_t bits = ctx->length * 8;
+    size_t used = (size_t)(ctx->length % 64);
+
+    ctx->buffer[used++] = 0x80;
+    if (used > 56) {
+        memset(ctx->buffer + used, 0, 64 - used);
+        sha256_block(ctx, ctx->buffer);
+        used = 0;
+    }
+    memset(ctx->buffer + used, 0, 56 - used);
+    for (int i = 0; i < 8; i++) ctx->buffer[56 + i] = (uint8_t)(bits >> (56 - 8 * i));
+    sha256_block(ctx, ctx->buffer);
+
+    for (int i = 0; i < 8; i++) {
+        digest[4 * i] = (uint8_t)(ctx->state[i] >> 24);
+        digest[4 * i + 1] = (uint8_t)(ctx->state[i] >> 16);
+        digest[4 * i + 2] = (uint8_t)(ctx->state[i] >> 8);
+        digest[4 * i + 3] = (uint8_t)ctx->state[i];
+    }
+}
@@ -9,8 +9,8 @@
 // Liste des commandes disponibles
 static const char *commands[] = {
     "help", "man", "pwd", "ls", "tree", "find", "cd", "mkdir",
-    "add", "cat", "stat", "extract", "cp", "mv", "rm", "clear",
-    "fetch", "edit", "exit", "quit"
+    "add", "cat", "stat", "extract", "cp", "ln", "mv", "rm", "clear",
+    "compress", "defrag", "trim", "dedup", "dedup-stats", "checksum", "snapshot", "fetch", "edit", "exit", "quit"
 };
 static const int num_commands = sizeof(commands) / sizeof(commands[0]);
 
@@ -98,27 +98,30 @@ static int complete_paths(Shell *shell, const char *partial, char **suggestions,
         strcpy(parent, shell->current_path);
     }
 
-    // Parcourir les inodes pour trouver les fichiers/répertoires correspondants
-    for (int i = 0; i < shell->fs->sb.max_files && count < max_count; i++) {
-        Inode *inode = get_inode(shell->fs, i);
-        if (inode->filename[0] == '\0') continue;
+    int parent_idx = fs_lookup(shell->fs, parent);
+    if (parent_idx == -1) return 0;
 
-        // Vérifier si le parent correspond
-        if (strcmp(inode->parent_path, parent) != 0) {
-            continue;
-        }
+    // Parcourir les enfants du répertoire parent
+    FsDirIter iter;
+    if (fs_dir_open(shell->fs, parent_idx, &iter) != 0) return 0;
+
+    int i;
+    while (count < max_count && (i = fs_dir_next(&iter)) != -1) {
+        Inode *inode = get_inode(shell->fs, i);
 
         // Vérifier si le nom commence par le partial
-        if (strncmp(inode->filename, filename_partial, strlen(filename_partial)) == 0) {
-            char full_name[MAX_FILENAME];
-            strcpy(full_name, inode->filename);
-            if (inode->is_directory) {
+        const char *name = fs_inode_name(shell->fs, inode);
+        if (strncmp(name, filename_partial, strlen(filename_partial)) == 0) {
+            char full_name[MAX_FILENAME + 1];
+            snprintf(full_name, sizeof(full_name), "%s", name);
+            if (inode->type == INODE_DIR) {
                 strcat(full_name, "/");
             }
             suggestions[count] = strdup(full_name);
             count++;
         }
     }
+    fs_dir_close(&iter);
 
     return count;
 }
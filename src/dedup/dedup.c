@@ -0,0 +1,177 @@
+#include "../../include/dedup.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define PRIME1 0x9E3779B185EBCA87ULL
+#define PRIME2 0xC2B2AE3D27D4EB4FULL
+#define PRIME3 0x165667B19E3779F9ULL
+
+static uint64_t rotl64(uint64_t v, int r) {
+    return (v << r) | (v >> (64 - r));
+}
+
+static uint64_t mix64(uint64_t v) {
+    v ^= v >> 33;
+    v *= PRIME2;
+    v ^= v >> 29;
+    v *= PRIME3;
+    v ^= v >> 32;
+    return v;
+}
+
+void dedup_init(DedupIndex *ix) {
+    ix->by_fingerprint = NULL;
+    ix->by_offset = NULL;
+    ix->capacity = 0;
+    ix->count = 0;
+}
+
+void dedup_destroy(DedupIndex *ix) {
+    free(ix->by_fingerprint);
+    free(ix->by_offset);
+    dedup_init(ix);
+}
+
+// Quatre accumulateurs indépendants sur des mots de 64 bits : le bloc est
+// parcouru à la vitesse de la mémoire
+uint64_t dedup_fingerprint(const void *data, size_t len) {
+    const uint8_t *p = data;
+    uint64_t acc[4] = { PRIME1 + PRIME2, PRIME2, 0, -PRIME1 };
+    size_t i = 0;
+
+    for (; i + 32 <= len; i += 32) {
+        for (int lane = 0; lane < 4; lane++) {
+            uint64_t w;
+            memcpy(&w, p + i + lane * 8, sizeof(w));
+            acc[lane] = rotl64(acc[lane] + w * PRIME2, 31) * PRIME1;
+        }
+    }
+    uint64_t h = rotl64(acc[0], 1) + rotl64(acc[1], 7) + rotl64(acc[2], 12) + rotl64(acc[3], 18);
+    for (; i < len; i++) h = (h ^ p[i]) * PRIME1;
+    return mix64(h ^ len);
+}
+
+static uint64_t entry_key(const DedupEntry *e, int by_offset) {
+    return by_offset ? mix64(e->offset) : e->fingerprint;
+}
+
+static void table_put(DedupEntry *table, uint32_t mask, DedupEntry entry, int by_offset) {
+    uint32_t slot = (uint32_t)entry_key(&entry, by_offset) & mask;
+    while (table[slot].offset != 0) slot = (slot + 1) & mask;
+    table[slot] = entry;
+}
+
+// Retire la case slot en ramenant les entrées suivantes du même groupe vers
+// leur place : aucune case vide ne coupe leur chemin de recherche
+static void table_remove(DedupEntry *table, uint32_t mask, uint32_t slot, int by_offset) {
+    uint32_t hole = slot;
+    uint32_t next = slot;
+    for (;;) {
+        next = (next + 1) & mask;
+        if (table[next].offset == 0) break;
+        uint32_t home = (uint32_t)entry_key(&table[next], by_offset) & mask;
+        int stays = hole <= next ? (home > hole && home <= next) : (home > hole || home <= next);
+        if (stays) continue;
+        table[hole] = table[next];
+        hole = next;
+    }
+    table[hole].offset = 0;
+    table[hole].fingerprint = 0;
+}
+
+static int find_slot(const DedupIndex *ix, int by_offset, uint64_t key, uint32_t *slot) {
+    if (ix->capacity == 0) return -1;
+    const DedupEntry *table = by_offset ? ix->by_offset : ix->by_fingerprint;
+    uint32_t mask = ix->capacity - 1;
+    uint32_t s = (uint32_t)(by_offset ? mix64(key) : key) & mask;
+    while (table[s].offset != 0) {
+        if ((by_offset ? table[s].offset : table[s].fingerprint) == key) {
+            *slot = s;
+            return 0;
+        }
+        s = (s + 1) & mask;
+    }
+    return -1;
+}
+
+static int dedup_grow(DedupIndex *ix) {
+    uint32_t capacity = ix->capacity ? ix->capacity * 2 : 1024;
+    DedupEntry *by_fingerprint = calloc(capacity, sizeof(DedupEntry));
+    DedupEntry *by_offset = calloc(capacity, sizeof(DedupEntry));
+    if (!by_fingerprint || !by_offset || capacity < ix->capacity) {
+        free(by_fingerprint);
+        free(by_offset);
+        return -1;
+    }
+    for (uint32_t i = 0; i < ix->capacity; i++) {
+        if (ix->by_fingerprint[i].offset != 0) {
+            table_put(by_fingerprint, capacity - 1, ix->by_fingerprint[i], 0);
+            table_put(by_offset, capacity - 1, ix->by_fingerprint[i], 1);
+        }
+    }
+    free(ix->by_fingerprint);
+    free(ix->by_offset);
+    ix->by_fingerprint = by_fingerprint;
+    ix->by_offset = by_offset;
+    ix->capacity = capacity;
+    return 0;
+}
+
+int dedup_find(const DedupIndex *ix, uint64_t fingerprint, uint64_t *offset) {
+    uint32_t slot;
+    if (find_slot(ix, 0, fingerprint, &slot) != 0) return -1;
+    *offset = ix->by_fingerprint[slot].offset;
+    return 0;
+}
+
+static void dedup_remove_offset(DedupIndex *ix, uint64_t offset) {
+    uint32_t slot;
+    if (find_slot(ix, 1, offset, &slot) != 0) return;
+    uint64_t fingerprint = ix->by_offset[slot].fingerprint;
+    table_remove(ix->by_offset, ix->capacity - 1, slot, 1);
+    if (find_slot(ix, 0, fingerprint, &slot) == 0) {
+        table_remove(ix->by_fingerprint, ix->capacity - 1, slot, 0);
+    }
+    ix->count--;
+}
+
+int dedup_insert(DedupIndex *ix, uint64_t fingerprint, uint64_t offset) {
+    if (offset == 0) return -1;
+
+    uint32_t slot;
+    if (find_slot(ix, 0, fingerprint, &slot) == 0) dedup_remove_offset(ix, ix->by_fingerprint[slot].offset);
+    dedup_remove_offset(ix, offset);
+
+    // Remplissage limité aux trois quarts
+    if ((uint64_t)(ix->count + 1) * 4 > (uint64_t)ix->capacity * 3 && dedup_grow(ix) != 0) return -1;
+
+    DedupEntry entry = { fingerprint, offset };
+    table_put(ix->by_fingerprint, ix->capacity - 1, entry, 0);
+    table_put(ix->by_offset, ix->capacity - 1, entry, 1);
+    ix->count++;
+    return 0;
+}
+
+void dedup_forget(DedupIndex *ix, uint64_t offset, uint64_t length) {
+    if (ix->count == 0) return;
+
+    uint64_t end = offset + length;
+    uint64_t first = (offset + DEDUP_BLOCK - 1) / DEDUP_BLOCK * DEDUP_BLOCK;
+    if (length / DEDUP_BLOCK <= ix->count) {
+        for (uint64_t block = first; block < end; block += DEDUP_BLOCK) dedup_remove_offset(ix, block);
+        return;
+    }
+
+    // Plage plus grande que l'index : parcourir l'index plutôt que la plage.
+    // Un retrait peut ramener une entrée dans la case courante : elle est
+    // alors réexaminée.
+    for (uint32_t i = 0; i < ix->capacity && ix->count > 0;) {
+        uint64_t at = ix->by_offset[i].offset;
+        if (at != 0 && at >= offset && at < end) {
+            dedup_remove_offset(ix, at);
+        } else {
+            i++;
+        }
+    }
+}
@@ -344,48 +344,41 @@ static void load_from_fs(void) {
     resolved[sizeof(resolved) - 1] = '\0';
 
     // Chercher l'inode
-    int idx = -1;
-    for (int i = 0; i < E.shell->fs->sb.max_files; i++) {
-        Inode *inode = get_inode(E.shell->fs, i);
-        if (inode->filename[0] != '\0') {
-            char full_path[MAX_PATH];
-            if (strcmp(inode->parent_path, "/") == 0) {
-                snprintf(full_path, MAX_PATH, "/%s", inode->filename);
-            } else {
-                snprintf(full_path, MAX_PATH, "%s/%s", 
-                         inode->parent_path,
-                         inode->filename);
-            }
-            if (strcmp(full_path, resolved) == 0) {
-                idx = i;
-                break;
-            }
-        }
-    }
+    int idx = fs_lookup(E.shell->fs, resolved);
 
-    if (idx == -1 || get_inode(E.shell->fs, idx)->is_directory) {
+    if (idx == -1 || get_inode(E.shell->fs, idx)->type == INODE_DIR) {
         // Nouveau fichier ou répertoire
         snprintf(E.statusmsg, sizeof(E.statusmsg), "Nouveau fichier");
         return;
     }
 
-    Inode *inode = get_inode(E.shell->fs, idx);
-    fseek(E.shell->fs->container, (long)inode->offset, SEEK_SET);
+    // Copie : la lecture peut évincer l'inode du cache
+    Inode inode = *get_inode(E.shell->fs, idx);
+    FsReader reader;
+    if (fs_reader_open(E.shell->fs, &inode, &reader) != 0) {
+        snprintf(E.statusmsg, sizeof(E.statusmsg), "Erreur de lecture");
+        return;
+    }
 
-    // char *line = NULL;
-    // size_t linecap = 0;
-    // ssize_t linelen;
-    
-    // Lire le contenu en mémoire
-    char *content = malloc(inode->size + 1);
-    fread(content, 1, inode->size, E.shell->fs->container);
-    content[inode->size] = '\0';
+    // Lire le contenu en mémoire à travers les extents du fichier
+    char *content = malloc(inode.size + 1);
+    size_t content_len = fs_reader_read(&reader, content, inode.size);
+    // Lecture interrompue : l'enregistrer remplacerait le fichier par un
+    // contenu tronqué
+    int incomplete = reader.remaining > 0;
+    fs_reader_close(&reader);
+    if (incomplete) {
+        free(content);
+        snprintf(E.statusmsg, sizeof(E.statusmsg), "Fichier illisible ou corrompu : ouverture refusée");
+        return;
+    }
+    content[content_len] = '\0';
 
     // Parser ligne par ligne
     char *p = content;
     char *start = content;
-    while (p - content < (long)inode->size) {
-        if (*p == '\n' || p - content == (long)inode->size) {
+    while (p - content < (long)content_len) {
+        if (*p == '\n' || p - content == (long)content_len) {
             insert_row(E.numrows, start, p - start);
             start = p + 1;
         }
@@ -399,7 +392,8 @@ static void load_from_fs(void) {
     free(content);
     E.dirty = 0;
     snprintf(E.statusmsg, sizeof(E.statusmsg), 
-             "%d lignes chargées", E.numrows);
+             fs_in_snapshot(E.shell->fs, idx) ? "%d lignes chargées (instantané, lecture seule)"
+                                               : "%d lignes chargées", E.numrows);
 }
 
 static int save_to_fs(void) {
@@ -419,6 +413,16 @@ static int save_to_fs(void) {
     }
     resolved[sizeof(resolved) - 1] = '\0';
 
+    // Rien ne s'écrit dans un instantané
+    char parent[MAX_PATH];
+    snprintf(parent, sizeof(parent), "%s", resolved);
+    char *slash = strrchr(parent, '/');
+    if (slash) *(slash == parent ? slash + 1 : slash) = '\0';
+    if (fs_in_snapshot(E.shell->fs, fs_lookup(E.shell->fs, parent))) {
+        free(buf);
+        return -1;
+    }
+
     // Créer un fichier temporaire
     char tmpfile[] = "/tmp/csfs_edit_XXXXXX";
     int fd = mkstemp(tmpfile);
@@ -435,42 +439,14 @@ static int save_to_fs(void) {
     }
     close(fd);
 
-    // Supprimer l'ancien si existe
-    for (int i = 0; i < MAX_FILES; i++) {
-        Inode *inode = get_inode(E.shell->fs, i);
-        if (inode->filename[0] != '\0') {
-            char full_path[MAX_PATH];
-            if (strcmp(inode->parent_path, "/") == 0) {
-                snprintf(full_path, MAX_PATH, "/%s", inode->filename);
-            } else {
-                snprintf(full_path, MAX_PATH, "%s/%s",
-                         inode->parent_path,
-                         inode->filename);
-            }
-            if (strcmp(full_path, resolved) == 0) {
-                // Libérer les blocs
-                if (inode->size > 0) {
-                    uint64_t offset = inode->offset;
-                    uint64_t num_blocks = (inode->size + BLOCK_SIZE - 1) / BLOCK_SIZE;
-                    for (uint64_t j = 0; j < num_blocks; j++) {
-                        uint64_t block_offset = offset + (j * BLOCK_SIZE);
-                        FreeBlock fb;
-                        fb.next_free_block = E.shell->fs->sb.first_free_block;
-                        fseek(E.shell->fs->container, (long)block_offset, SEEK_SET);
-                        fwrite(&fb, sizeof(FreeBlock), 1, E.shell->fs->container);
-                        E.shell->fs->sb.first_free_block = block_offset;
-                    }
-                }
-                inode->filename[0] = '\0';
-                mark_inode_dirty(E.shell->fs, i);
-                E.shell->fs->sb.num_files--;
-                break;
-            }
-        }
+    // Un fichier existant est réécrit sur place : il garde son inode, ses
+    // métadonnées et tous ses noms s'il est lié
+    int ret;
+    if (fs_lookup(E.shell->fs, resolved) != -1) {
+        ret = fs_write_file(E.shell->fs, resolved, tmpfile);
+    } else {
+        ret = fs_add_file(E.shell->fs, resolved, tmpfile);
     }
-
-    // Ajouter le nouveau fichier
-    int ret = fs_add_file(E.shell->fs, resolved, tmpfile);
     unlink(tmpfile);
     free(buf);
 
@@ -107,21 +107,32 @@ static void collect_system_info(Shell *shell, int color) {
     add_separator(color);
 }
 
+// Compte les entrées du sous-arbre d'un répertoire
+static void count_entries(FileSystem *fs, int dir, unsigned long *files, unsigned long *dirs,
+                          unsigned long long *total) {
+    FsDirIter iter;
+    if (fs_dir_open(fs, dir, &iter) != 0) return;
+
+    int i;
+    while ((i = fs_dir_next(&iter)) != -1) {
+        Inode *inode = get_inode(fs, i);
+        if (inode->type == INODE_DIR) {
+            (*dirs)++;
+            count_entries(fs, i, files, dirs, total);
+        } else {
+            (*files)++;
+            *total += inode->size;
+        }
+    }
+    fs_dir_close(&iter);
+}
+
 static void collect_fs_info(Shell *shell, int color) {
     FileSystem *fs = shell->fs;
     unsigned long files = 0, dirs = 0;
     unsigned long long total = 0ULL;
     
-    for (int i = 0; i < fs->sb.max_files; i++) {
-        Inode *inode = get_inode(fs, i);
-        if (inode->filename[0] != '\0') {
-            if (inode->is_directory) dirs++;
-            else {
-                files++;
-                total += inode->size;
-            }
-        }
-    }
+    count_entries(fs, ROOT_INODE, &files, &dirs, &total);
     
     char buf[256];
     snprintf(buf, sizeof(buf), "%u", fs->sb.version);
@@ -145,6 +156,15 @@ static void collect_fs_info(Shell *shell, int color) {
     else 
         snprintf(buf, sizeof(buf), "%.2f GiB", (double)total/(1024.0*1024.0*1024.0));
     add_info_kv("Data Size", buf, color);
+
+    FsCacheStats cache;
+    fs_cache_stats(fs, &cache);
+    uint64_t lookups = cache.hits + cache.misses;
+    snprintf(buf, sizeof(buf), "%u/%u, %.1f%% hits, %llu evictions",
+             cache.size, cache.capacity,
+             lookups ? 100.0 * (double)cache.hits / (double)lookups : 0.0,
+             (unsigned long long)cache.evictions);
+    add_info_kv("Inode Cache", buf, color);
     
     add_separator(color);
     add_info_kv("CWD", shell->current_path, color);
@@ -0,0 +1,225 @@
+#include "../../include/freemap.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+void freemap_init(FreeMap *fm) {
+    fm->by_offset = NULL;
+    fm->by_length = NULL;
+    fm->count = 0;
+    fm->capacity = 0;
+    fm->total = 0;
+}
+
+void freemap_destroy(FreeMap *fm) {
+    free(fm->by_offset);
+    free(fm->by_length);
+    freemap_init(fm);
+}
+
+static int freemap_reserve(FreeMap *fm, uint32_t needed) {
+    if (needed <= fm->capacity) return 0;
+
+    uint32_t capacity = fm->capacity ? fm->capacity * 2 : 64;
+    while (capacity < needed) capacity *= 2;
+
+    FreeRun *by_offset = realloc(fm->by_offset, capacity * sizeof(FreeRun));
+    if (!by_offset) return -1;
+    fm->by_offset = by_offset;
+
+    FreeRun *by_length = realloc(fm->by_length, capacity * sizeof(FreeRun));
+    if (!by_length) return -1;
+    fm->by_length = by_length;
+
+    fm->capacity = capacity;
+    return 0;
+}
+
+// Premier index dont l'offset est >= offset
+static uint32_t lower_bound_offset(const FreeMap *fm, uint64_t offset) {
+    uint32_t lo = 0, hi = fm->count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (fm->by_offset[mid].offset < offset) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// Premier index dont (longueur, offset) est >= (length, offset)
+static uint32_t lower_bound_length(const FreeMap *fm, uint64_t length, uint64_t offset) {
+    uint32_t lo = 0, hi = fm->count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        const FreeRun *r = &fm->by_length[mid];
+        if (r->length < length || (r->length == length && r->offset < offset)) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// Les deux fonctions suivantes maintiennent by_length ; count n'est mis à jour
+// qu'avec by_offset, d'où le paramètre n (nombre d'éléments de by_length)
+static void by_length_insert(FreeMap *fm, uint32_t n, uint64_t offset, uint64_t length) {
+    uint32_t lo = 0, hi = n;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        const FreeRun *r = &fm->by_length[mid];
+        if (r->length < length || (r->length == length && r->offset < offset)) lo = mid + 1;
+        else hi = mid;
+    }
+    memmove(&fm->by_length[lo + 1], &fm->by_length[lo], (n - lo) * sizeof(FreeRun));
+    fm->by_length[lo].offset = offset;
+    fm->by_length[lo].length = length;
+}
+
+static void by_length_remove(FreeMap *fm, uint32_t n, uint64_t offset, uint64_t length) {
+    uint32_t lo = 0, hi = n;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        const FreeRun *r = &fm->by_length[mid];
+        if (r->length < length || (r->length == length && r->offset < offset)) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo < n) {
+        memmove(&fm->by_length[lo], &fm->by_length[lo + 1], (n - lo - 1) * sizeof(FreeRun));
+    }
+}
+
+int freemap_insert(FreeMap *fm, uint64_t offset, uint64_t length) {
+    if (length == 0) return 0;
+
+    uint32_t i = lower_bound_offset(fm, offset);
+
+    // Refuser les doubles libérations
+    if (i > 0) {
+        const FreeRun *prev = &fm->by_offset[i - 1];
+        if (prev->offset + prev->length > offset) return -1;
+    }
+    if (i < fm->count && offset + length > fm->by_offset[i].offset) return -1;
+
+    int merge_prev = (i > 0 && fm->by_offset[i - 1].offset + fm->by_offset[i - 1].length == offset);
+    int merge_next = (i < fm->count && offset + length == fm->by_offset[i].offset);
+
+    if (merge_prev && merge_next) {
+        FreeRun *prev = &fm->by_offset[i - 1];
+        FreeRun *next = &fm->by_offset[i];
+        by_length_remove(fm, fm->count, prev->offset, prev->length);
+        by_length_remove(fm, fm->count - 1, next->offset, next->length);
+        prev->length += length + next->length;
+        memmove(&fm->by_offset[i], &fm->by_offset[i + 1], (fm->count - i - 1) * sizeof(FreeRun));
+        fm->count--;
+        by_length_insert(fm, fm->count - 1, prev->offset, prev->length);
+    } else if (merge_prev) {
+        FreeRun *prev = &fm->by_offset[i - 1];
+        by_length_remove(fm, fm->count, prev->offset, prev->length);
+        prev->length += length;
+        by_length_insert(fm, fm->count - 1, prev->offset, prev->length);
+    } else if (merge_next) {
+        FreeRun *next = &fm->by_offset[i];
+        by_length_remove(fm, fm->count, next->offset, next->length);
+        next->offset = offset;
+        next->length += length;
+        by_length_insert(fm, fm->count - 1, next->offset, next->length);
+    } else {
+        if (freemap_reserve(fm, fm->count + 1) != 0) return -1;
+        memmove(&fm->by_offset[i + 1], &fm->by_offset[i], (fm->count - i) * sizeof(FreeRun));
+        fm->by_offset[i].offset = offset;
+        fm->by_offset[i].length = length;
+        by_length_insert(fm, fm->count, offset, length);
+        fm->count++;
+    }
+
+    fm->total += length;
+    return 0;
+}
+
+int freemap_take(FreeMap *fm, uint64_t offset, uint64_t length) {
+    if (length == 0) return 0;
+
+    uint32_t i = lower_bound_offset(fm, offset + 1);
+    if (i == 0) return -1;
+    i--;
+
+    FreeRun run = fm->by_offset[i];
+    if (offset < run.offset || offset + length > run.offset + run.length) return -1;
+
+    uint64_t head = offset - run.offset;
+    uint64_t tail = (run.offset + run.length) - (offset + length);
+
+    by_length_remove(fm, fm->count, run.offset, run.length);
+
+    if (head > 0 && tail > 0) {
+        if (freemap_reserve(fm, fm->count + 1) != 0) {
+            by_length_insert(fm, fm->count - 1, run.offset, run.length);
+            return -1;
+        }
+        fm->by_offset[i].length = head;
+        memmove(&fm->by_offset[i + 2], &fm->by_offset[i + 1], (fm->count - i - 1) * sizeof(FreeRun));
+        fm->by_offset[i + 1].offset = offset + length;
+        fm->by_offset[i + 1].length = tail;
+        by_length_insert(fm, fm->count - 1, run.offset, head);
+        by_length_insert(fm, fm->count, offset + length, tail);
+        fm->count++;
+    } else if (head > 0) {
+        fm->by_offset[i].length = head;
+        by_length_insert(fm, fm->count - 1, run.offset, head);
+    } else if (tail > 0) {
+        fm->by_offset[i].offset = offset + length;
+        fm->by_offset[i].length = tail;
+        by_length_insert(fm, fm->count - 1, offset + length, tail);
+    } else {
+        memmove(&fm->by_offset[i], &fm->by_offset[i + 1], (fm->count - i - 1) * sizeof(FreeRun));
+        fm->count--;
+    }
+
+    fm->total -= length;
+    return 0;
+}
+
+int freemap_alloc_best_fit(FreeMap *fm, uint64_t length, uint64_t *offset) {
+    uint32_t j = lower_bound_length(fm, length, 0);
+    if (j >= fm->count) return -1;
+
+    *offset = fm->by_length[j].offset;
+    return freemap_take(fm, *offset, length);
+}
+
+int freemap_alloc_first_fit(FreeMap *fm, uint64_t length, uint64_t limit, uint64_t *offset) {
+    for (uint32_t i = 0; i < fm->count; i++) {
+        const FreeRun *r = &fm->by_offset[i];
+        if (r->offset + length > limit) break;
+        if (r->length >= length) {
+            *offset = r->offset;
+            return freemap_take(fm, *offset, length);
+        }
+    }
+    return -1;
+}
+
+const FreeRun *freemap_largest(const FreeMap *fm) {
+    return fm->count > 0 ? &fm->by_length[fm->count - 1] : NULL;
+}
+
+const FreeRun *freemap_next(const FreeMap *fm, uint64_t offset) {
+    uint32_t i = lower_bound_offset(fm, offset);
+    if (i > 0 && fm->by_offset[i - 1].offset + fm->by_offset[i - 1].length > offset) i--;
+    return i < fm->count ? &fm->by_offset[i] : NULL;
+}
+
+const FreeRun *freemap_last(const FreeMap *fm) {
+    return fm->count > 0 ? &fm->by_offset[fm->count - 1] : NULL;
+}
+
+void freemap_truncate(FreeMap *fm, uint64_t end) {
+    while (fm->count > 0) {
+        FreeRun last = fm->by_offset[fm->count - 1];
+        if (last.offset + last.length <= end) break;
+
+        if (last.offset >= end) {
+            freemap_take(fm, last.offset, last.length);
+        } else {
+            freemap_take(fm, end, last.offset + last.length - end);
+        }
+    }
+}
@@ -1,180 +1,968 @@
 #include "../include/fs.h"
+#include "../include/lz.h"
 
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
 
-// Fonction de hash simple pour les chemins
-static uint32_t hash_path(const char *path) {
-    uint32_t hash = 5381;
+// --- Index des entrees (parent, nom) ---
+//
+// Table a adressage ouvert, Robin Hood : une entree qui a deja parcouru plus
+// de cases que l'occupant prend sa place. Les distances restent courtes, une
+// recherche peut s'arreter des qu'elle croise une entree plus proche de sa
+// case d'origine, et la suppression decale les suivantes vers l'arriere sans
+// laisser de marqueur. Le hash complet est garde dans l'entree : strcmp n'est
+// appele que sur un hash identique.
+
+// FNV-1a sur le nom, melange avec le parent puis finalise (splitmix64)
+static uint64_t hash_dentry(uint32_t parent, const char *name) {
+    uint64_t hash = 14695981039346656037ULL ^ ((uint64_t)parent * 0x9E3779B97F4A7C15ULL);
     int c;
-    while ((c = *path++)) {
-        hash = ((hash << 5) + hash) + c;
+    while ((c = (unsigned char)*name++)) {
+        hash ^= (uint64_t)c;
+        hash *= 1099511628211ULL;
     }
-    return hash % HASH_TABLE_SIZE;
+    hash ^= hash >> 30;
+    hash *= 0xBF58476D1CE4E5B9ULL;
+    hash ^= hash >> 27;
+    hash *= 0x94D049BB133111EBULL;
+    hash ^= hash >> 31;
+    return hash;
+}
+
+// Distance entre la case d'une entree et sa case d'origine
+static uint32_t hash_probe_distance(const FileSystem *fs, uint64_t hash, uint32_t slot) {
+    uint32_t mask = fs->hash_capacity - 1;
+    return (slot - (uint32_t)(hash & mask)) & mask;
 }
 
-// Initialise la hash table
-static void hash_table_init(FileSystem *fs) {
-    for (int i = 0; i < HASH_TABLE_SIZE; i++) {
-        fs->hash_table[i].inode_index = -1;
-        fs->hash_table[i].full_path[0] = '\0';
+static int hash_table_alloc(FileSystem *fs, uint32_t capacity) {
+    HashEntry *table = calloc(capacity, sizeof(HashEntry));
+    if (!table) return -1;
+    for (uint32_t i = 0; i < capacity; i++) {
+        table[i].inode_index = -1;
     }
+    fs->hash_table = table;
+    fs->hash_capacity = capacity;
+    fs->hash_count = 0;
+    return 0;
 }
 
-// Insere une entree dans la hash table avec gestion des collisions (linear probing)
-static void hash_table_insert(FileSystem *fs, const char *full_path, int inode_index) {
-    uint32_t idx = hash_path(full_path);
-    int attempts = 0;
-    
-    while (attempts < HASH_TABLE_SIZE) {
-        if (fs->hash_table[idx].inode_index == -1) {
-            fs->hash_table[idx].inode_index = inode_index;
-            strncpy(fs->hash_table[idx].full_path, full_path, MAX_PATH - 1);
-            fs->hash_table[idx].full_path[MAX_PATH - 1] = '\0';
-            return;
+// Initialise la hash table, dimensionnee pour expected entrees
+static int hash_table_init(FileSystem *fs, uint32_t expected) {
+    uint32_t capacity = HASH_TABLE_SIZE;
+    while ((uint64_t)expected * 8 > (uint64_t)capacity * 7) capacity *= 2;
+
+    free(fs->hash_table);
+    fs->hash_table = NULL;
+    return hash_table_alloc(fs, capacity);
+}
+
+static void hash_table_place(FileSystem *fs, HashEntry entry) {
+    uint32_t mask = fs->hash_capacity - 1;
+    uint32_t slot = (uint32_t)(entry.hash & mask);
+    uint32_t dist = 0;
+
+    while (fs->hash_table[slot].inode_index != -1) {
+        uint32_t existing = hash_probe_distance(fs, fs->hash_table[slot].hash, slot);
+        if (existing < dist) {
+            HashEntry tmp = fs->hash_table[slot];
+            fs->hash_table[slot] = entry;
+            entry = tmp;
+            dist = existing;
         }
-        idx = (idx + 1) % HASH_TABLE_SIZE;
-        attempts++;
+        slot = (slot + 1) & mask;
+        dist++;
     }
-    fprintf(stderr, "Avertissement : hash table pleine, insertion impossible\n");
+    fs->hash_table[slot] = entry;
+    fs->hash_count++;
 }
 
-// Recherche dans la hash table - retourne l'index de l'inode ou -1
-static int hash_table_lookup(FileSystem *fs, const char *full_path) {
-    uint32_t idx = hash_path(full_path);
-    int attempts = 0;
-    
-    while (attempts < HASH_TABLE_SIZE) {
-        if (fs->hash_table[idx].inode_index == -1) {
+static int hash_table_grow(FileSystem *fs) {
+    HashEntry *old = fs->hash_table;
+    uint32_t old_capacity = fs->hash_capacity;
+
+    if (hash_table_alloc(fs, old_capacity * 2) != 0) {
+        fs->hash_table = old;
+        fs->hash_capacity = old_capacity;
+        return -1;
+    }
+    for (uint32_t i = 0; i < old_capacity; i++) {
+        if (old[i].inode_index != -1) hash_table_place(fs, old[i]);
+    }
+    free(old);
+    return 0;
+}
+
+static int hash_entry_matches(FileSystem *fs, const HashEntry *entry, uint64_t hash,
+                              uint32_t parent, const char *name) {
+    return entry->hash == hash &&
+           entry->parent == parent &&
+           entry->name_offset < fs->names.size &&
+           strcmp(fs->names.data + entry->name_offset, name) == 0;
+}
+
+// Insere une entree, en doublant la table au-dela de 7/8 de remplissage
+static void hash_table_insert(FileSystem *fs, uint32_t parent, uint64_t name_offset, int inode_index) {
+    if ((uint64_t)(fs->hash_count + 1) * 8 > (uint64_t)fs->hash_capacity * 7 &&
+        hash_table_grow(fs) != 0 && fs->hash_count + 1 >= fs->hash_capacity) {
+        fprintf(stderr, "Avertissement : mémoire insuffisante, entrée non indexée\n");
+        return;
+    }
+
+    HashEntry entry;
+    entry.hash = hash_dentry(parent, fs->names.data + name_offset);
+    entry.inode_index = inode_index;
+    entry.parent = parent;
+    entry.name_offset = name_offset;
+    hash_table_place(fs, entry);
+    fs->path_index_changed = 1;
+}
+
+// Case de l'entree (parent, nom), -1 si absente
+static int hash_table_find(FileSystem *fs, uint32_t parent, const char *name) {
+    uint64_t hash = hash_dentry(parent, name);
+    uint32_t mask = fs->hash_capacity - 1;
+    uint32_t slot = (uint32_t)(hash & mask);
+
+    for (uint32_t dist = 0; ; dist++) {
+        const HashEntry *entry = &fs->hash_table[slot];
+        if (entry->inode_index == -1 || hash_probe_distance(fs, entry->hash, slot) < dist) {
             return -1;
         }
-        if (strcmp(fs->hash_table[idx].full_path, full_path) == 0) {
-            return fs->hash_table[idx].inode_index;
+        if (hash_entry_matches(fs, entry, hash, parent, name)) {
+            return (int)slot;
         }
-        idx = (idx + 1) % HASH_TABLE_SIZE;
-        attempts++;
+        slot = (slot + 1) & mask;
     }
-    return -1;
 }
 
-// Supprime une entree de la hash table
-static void hash_table_delete(FileSystem *fs, const char *full_path) {
-    uint32_t idx = hash_path(full_path);
-    int attempts = 0;
-    
-    while (attempts < HASH_TABLE_SIZE) {
-        if (fs->hash_table[idx].inode_index == -1) {
-            return;
-        }
-        if (strcmp(fs->hash_table[idx].full_path, full_path) == 0) {
-            fs->hash_table[idx].inode_index = -1;
-            fs->hash_table[idx].full_path[0] = '\0';
-            return;
-        }
-        idx = (idx + 1) % HASH_TABLE_SIZE;
-        attempts++;
+// Recherche dans la hash table - retourne l'index de l'inode ou -1
+static int hash_table_lookup(FileSystem *fs, uint32_t parent, const char *name) {
+    int slot = hash_table_find(fs, parent, name);
+    return slot == -1 ? -1 : fs->hash_table[slot].inode_index;
+}
+
+// Supprime une entree en decalant vers l'arriere celles qui la suivent
+static void hash_table_delete(FileSystem *fs, uint32_t parent, const char *name) {
+    int found = hash_table_find(fs, parent, name);
+    if (found == -1) return;
+
+    uint32_t mask = fs->hash_capacity - 1;
+    uint32_t slot = (uint32_t)found;
+    for (;;) {
+        uint32_t next = (slot + 1) & mask;
+        const HashEntry *entry = &fs->hash_table[next];
+        if (entry->inode_index == -1 || hash_probe_distance(fs, entry->hash, next) == 0) break;
+        fs->hash_table[slot] = *entry;
+        slot = next;
+    }
+    fs->hash_table[slot].inode_index = -1;
+    fs->hash_count--;
+    fs->path_index_changed = 1;
+}
+
+// Resout un chemin normalise composant par composant depuis la racine. Un
+// lien est rendu tel quel : voir hash_table_resolve pour son fichier.
+static int hash_table_resolve_entry(FileSystem *fs, const char *normalized) {
+    int idx = ROOT_INODE;
+    const char *p = normalized;
+
+    while (*p) {
+        while (*p == '/') p++;
+        if (*p == '\0') break;
+
+        const char *end = strchr(p, '/');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        if (len >= MAX_FILENAME) return -1;
+
+        char name[MAX_FILENAME];
+        memcpy(name, p, len);
+        name[len] = '\0';
+
+        idx = hash_table_lookup(fs, (uint32_t)idx, name);
+        if (idx == -1) return -1;
+        p += len;
     }
+    return idx;
+}
+
+// Contenu d'un fichier lie : un inode sans nom, designe par ses liens
+static int inode_is_shared(const Inode *inode) {
+    return inode->type == INODE_FILE && (inode->flags & INODE_FLAG_SHARED);
+}
+
+int fs_link_target(FileSystem *fs, int inode_index) {
+    if (inode_index < 0) return -1;
+    const Inode *inode = get_inode(fs, inode_index);
+    if (inode->type != INODE_LINK) return inode_index;
+    return inode->target < fs->sb.max_files ? (int)inode->target : -1;
+}
+
+// Inode designe par un chemin, le fichier d'un lien plutot que le lien : les
+// liens ne designent que des fichiers, seul le dernier composant peut en etre
+// un
+static int hash_table_resolve(FileSystem *fs, const char *normalized) {
+    return fs_link_target(fs, hash_table_resolve_entry(fs, normalized));
 }
 
 // --- Gestion du Cache LRU ---
 
-static void write_inode_to_disk(FileSystem *fs, int inode_index, const Inode *inode) {
-    uint64_t offset = fs->sb.inode_table_offset + (uint64_t)inode_index * sizeof(Inode);
-    fseek(fs->container, offset, SEEK_SET);
-    fwrite(inode, sizeof(Inode), 1, fs->container);
+static int journal_record(FileSystem *fs, uint64_t offset, const void *data, size_t len);
+static int journal_lookup(FileSystem *fs, uint64_t offset, void *out, size_t len);
+
+// Segments de la table d'inodes : le segment 0 compte base entrees, le
+// segment k (k >= 1) base << (k - 1) et commence a l'inode base << (k - 1)
+static uint64_t inode_segment_entries(const SuperBlock *sb, uint32_t k) {
+    return k == 0 ? sb->inode_segment_base : (uint64_t)sb->inode_segment_base << (k - 1);
+}
+
+static uint64_t inode_segment_offset(const SuperBlock *sb, uint32_t k) {
+    return k == 0 ? sb->inode_table_offset : sb->inode_segments[k - 1];
+}
+
+static uint64_t inode_offset(const SuperBlock *sb, uint32_t inode_index) {
+    uint32_t k = 0;
+    uint64_t first = 0;
+    while (k + 1 < sb->inode_segment_count && inode_index >= inode_segment_entries(sb, k + 1)) {
+        k++;
+    }
+    if (k > 0) first = inode_segment_entries(sb, k);
+    return inode_segment_offset(sb, k) + (inode_index - first) * sizeof(Inode);
 }
 
 static void read_inode_from_disk(FileSystem *fs, int inode_index, Inode *inode) {
-    uint64_t offset = fs->sb.inode_table_offset + (uint64_t)inode_index * sizeof(Inode);
-    fseek(fs->container, offset, SEEK_SET);
-    if (fread(inode, sizeof(Inode), 1, fs->container) != 1) {
+    uint64_t offset = inode_offset(&fs->sb, (uint32_t)inode_index);
+    // Un inode modifie puis evince n'est encore que dans la transaction
+    if (journal_lookup(fs, offset, inode, sizeof(Inode)) == 0) return;
+    if (io_read(fs->container, offset, inode, sizeof(Inode)) != sizeof(Inode)) {
         memset(inode, 0, sizeof(Inode));
     }
 }
 
+// Ecrit un inode modifie a sa place, a travers la transaction en construction
+static void inode_write_back(FileSystem *fs, CacheNode *node) {
+    uint64_t offset = inode_offset(&fs->sb, (uint32_t)node->inode_index);
+    journal_record(fs, offset, &node->inode, sizeof(Inode));
+    node->dirty = 0;
+    fs->cache_dirty--;
+}
+
+static CacheList *cache_segment(FileSystem *fs, const CacheNode *node) {
+    return node->segment == CACHE_PROTECTED ? &fs->cache_protected : &fs->cache_probation;
+}
+
 static void cache_remove(FileSystem *fs, CacheNode *node) {
+    CacheList *list = cache_segment(fs, node);
     if (node->prev) node->prev->next = node->next;
-    else fs->cache_head = node->next;
+    else list->head = node->next;
     
     if (node->next) node->next->prev = node->prev;
-    else fs->cache_tail = node->prev;
+    else list->tail = node->prev;
     
     node->prev = node->next = NULL;
+    list->count--;
 }
 
-static void cache_push_front(FileSystem *fs, CacheNode *node) {
-    node->next = fs->cache_head;
+static void cache_push_front(FileSystem *fs, CacheNode *node, int segment) {
+    node->segment = segment;
+    CacheList *list = cache_segment(fs, node);
+    node->next = list->head;
     node->prev = NULL;
-    if (fs->cache_head) fs->cache_head->prev = node;
-    fs->cache_head = node;
-    if (!fs->cache_tail) fs->cache_tail = node;
+    if (list->head) list->head->prev = node;
+    list->head = node;
+    if (!list->tail) list->tail = node;
+    list->count++;
+}
+
+// Inode relu : il passe (ou reste) en tete du segment protege. Si ce segment
+// deborde, son plus ancien inode redescend en periode d'essai.
+static void cache_touch(FileSystem *fs, CacheNode *node) {
+    if (node->segment == CACHE_PROBATION && fs->cache_scan > 0) return;
+    if (node->segment == CACHE_PROBATION && fs->cache_protected_max == 0) {
+        cache_remove(fs, node);
+        cache_push_front(fs, node, CACHE_PROBATION);
+        return;
+    }
+
+    cache_remove(fs, node);
+    cache_push_front(fs, node, CACHE_PROTECTED);
+    if (fs->cache_protected.count > fs->cache_protected_max) {
+        CacheNode *demoted = fs->cache_protected.tail;
+        cache_remove(fs, demoted);
+        cache_push_front(fs, demoted, CACHE_PROBATION);
+    }
+}
+
+// Index des noeuds du cache par numero d'inode
+static CacheNode **cache_bucket(FileSystem *fs, int inode_index) {
+    return &fs->cache_buckets[((uint32_t)inode_index * 2654435761u) & fs->cache_bucket_mask];
+}
+
+static CacheNode *cache_find(FileSystem *fs, int inode_index) {
+    for (CacheNode *node = *cache_bucket(fs, inode_index); node; node = node->hash_next) {
+        if (node->inode_index == inode_index) return node;
+    }
+    return NULL;
+}
+
+static void cache_index(FileSystem *fs, CacheNode *node) {
+    CacheNode **bucket = cache_bucket(fs, node->inode_index);
+    node->hash_next = *bucket;
+    *bucket = node;
+}
+
+static void cache_unindex(FileSystem *fs, CacheNode *node) {
+    CacheNode **link = cache_bucket(fs, node->inode_index);
+    while (*link && *link != node) link = &(*link)->hash_next;
+    if (*link) *link = node->hash_next;
+    node->hash_next = NULL;
+}
+
+static int cache_init(FileSystem *fs, uint32_t capacity) {
+    uint32_t buckets = 16;
+    while (buckets < capacity) buckets *= 2;
+
+    memset(&fs->cache_probation, 0, sizeof(CacheList));
+    memset(&fs->cache_protected, 0, sizeof(CacheList));
+    memset(&fs->cache_stats, 0, sizeof(FsCacheStats));
+    fs->cache_scan = 0;
+    fs->cache_dirty = 0;
+    fs->cache_count = 0;
+    fs->cache_capacity = (int)capacity;
+    // Un quart du cache au moins reste disponible pour la periode d'essai
+    fs->cache_protected_max = capacity - (capacity / 4 > 0 ? capacity / 4 : 1);
+    fs->cache_bucket_mask = buckets - 1;
+    fs->cache_pool = calloc(capacity, sizeof(CacheNode));
+    fs->cache_buckets = calloc(buckets, sizeof(CacheNode *));
+    if (!fs->cache_pool || !fs->cache_buckets) {
+        free(fs->cache_pool);
+        free(fs->cache_buckets);
+        fs->cache_pool = NULL;
+        fs->cache_buckets = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+static void cache_destroy(FileSystem *fs) {
+    free(fs->cache_pool);
+    free(fs->cache_buckets);
+    fs->cache_pool = NULL;
+    fs->cache_buckets = NULL;
+    fs->cache_count = 0;
+}
+
+// Un inode modifie ne quitte le cache qu'avec la transaction suivante : la
+// victime est le plus ancien inode non modifie
+static CacheNode *cache_victim(FileSystem *fs) {
+    for (CacheNode *node = fs->cache_probation.tail; node; node = node->prev) {
+        if (!node->dirty) return node;
+    }
+    for (CacheNode *node = fs->cache_protected.tail; node; node = node->prev) {
+        if (!node->dirty) return node;
+    }
+    return NULL;
 }
 
 Inode* get_inode(FileSystem *fs, int inode_index) {
-    if (inode_index < 0 || inode_index >= fs->sb.max_files) return NULL;
+    if (inode_index < 0 || inode_index >= (int)fs->sb.max_files) return NULL;
     
     // Chercher dans le cache
-    for (int i = 0; i < fs->cache_count; i++) {
-        if (fs->cache_nodes[i]->inode_index == inode_index) {
-            CacheNode *node = fs->cache_nodes[i];
-            // Déplacer à l'avant (LRU)
-            cache_remove(fs, node);
-            cache_push_front(fs, node);
-            return &node->inode;
-        }
+    CacheNode *node = cache_find(fs, inode_index);
+    if (node) {
+        fs->cache_stats.hits++;
+        cache_touch(fs, node);
+        return &node->inode;
     }
     
     // Pas dans le cache, charger depuis le disque
-    CacheNode *node = NULL;
-    if (fs->cache_count < LRU_CACHE_SIZE) {
-        node = malloc(sizeof(CacheNode));
-        fs->cache_nodes[fs->cache_count++] = node;
+    fs->cache_stats.misses++;
+    if (fs->cache_count < fs->cache_capacity) {
+        node = &fs->cache_pool[fs->cache_count++];
     } else {
-        // Évincer le plus ancien (tail)
-        node = fs->cache_tail;
-        if (node->dirty) {
-            write_inode_to_disk(fs, node->inode_index, &node->inode);
+        // Évincer le plus ancien inode en période d'essai, sinon du segment protégé
+        node = cache_victim(fs);
+        if (!node) {
+            // Cache rempli d'inodes modifiés : le plus ancien rejoint la
+            // transaction en construction
+            node = fs->cache_probation.tail ? fs->cache_probation.tail : fs->cache_protected.tail;
+            inode_write_back(fs, node);
+            fs->cache_stats.writebacks++;
         }
         cache_remove(fs, node);
+        cache_unindex(fs, node);
+        fs->cache_stats.evictions++;
     }
     
     node->inode_index = inode_index;
     read_inode_from_disk(fs, inode_index, &node->inode);
     node->dirty = 0;
-    cache_push_front(fs, node);
+    cache_push_front(fs, node, CACHE_PROBATION);
+    cache_index(fs, node);
     
     return &node->inode;
 }
 
-void mark_inode_dirty(FileSystem *fs, int inode_index) {
-    for (int i = 0; i < fs->cache_count; i++) {
-        if (fs->cache_nodes[i]->inode_index == inode_index) {
-            fs->cache_nodes[i]->dirty = 1;
-            return;
+void mark_inode_dirty(FileSystem *fs, Inode *inode) {
+    if (!inode) return;
+    CacheNode *node = (CacheNode *)((char *)inode - offsetof(CacheNode, inode));
+    if (!node->dirty) {
+        node->dirty = 1;
+        fs->cache_dirty++;
+    }
+}
+
+void fs_cache_scan_begin(FileSystem *fs) {
+    fs->cache_scan++;
+}
+
+void fs_cache_scan_end(FileSystem *fs) {
+    if (fs->cache_scan > 0) fs->cache_scan--;
+}
+
+void fs_cache_stats(FileSystem *fs, FsCacheStats *stats) {
+    *stats = fs->cache_stats;
+    stats->size = (uint32_t)fs->cache_count;
+    stats->protected_count = fs->cache_protected.count;
+    stats->capacity = (uint32_t)fs->cache_capacity;
+}
+
+// Lit un inode sans toucher à l'ordre LRU : la copie en cache (éventuellement
+// sale) prime sur celle du disque
+static void read_inode_current(FileSystem *fs, int inode_index, Inode *inode) {
+    CacheNode *node = cache_find(fs, inode_index);
+    if (node) {
+        *inode = node->inode;
+        return;
+    }
+    read_inode_from_disk(fs, inode_index, inode);
+}
+
+// --- Parcours sequentiel de la table d'inodes ---
+//
+// La table est lue par morceaux de INODE_SCAN_CHUNK octets (en place si le
+// conteneur est projete), le morceau suivant etant demande au noyau pendant
+// le traitement du courant : un parcours complet coute quelques lectures
+// par segment, et non une par inode.
+
+typedef struct {
+    FileSystem *fs;
+    uint32_t segment;     // Segment en cours
+    uint64_t next;        // Prochaine entree du segment a lire
+    uint32_t index;       // Numero du prochain inode rendu
+    const Inode *chunk;   // Morceau en cours
+    uint32_t count;
+    uint32_t pos;
+    Inode *buf;           // Copie du morceau (conteneur non projete)
+    Inode pending;        // Version d'un inode encore dans la transaction
+    int failed;           // Memoire insuffisante
+} InodeScan;
+
+static void inode_scan_open(FileSystem *fs, InodeScan *scan) {
+    memset(scan, 0, sizeof(*scan));
+    scan->fs = fs;
+    for (uint32_t k = 0; k < fs->sb.inode_segment_count; k++) {
+        io_advise(fs->container, inode_segment_offset(&fs->sb, k),
+                  inode_segment_entries(&fs->sb, k) * sizeof(Inode), IO_ADVISE_SEQUENTIAL);
+    }
+}
+
+static void inode_scan_close(InodeScan *scan) {
+    free(scan->buf);
+    scan->buf = NULL;
+}
+
+// Charge le morceau suivant : 0 en fin de table
+static int inode_scan_fill(InodeScan *scan) {
+    const SuperBlock *sb = &scan->fs->sb;
+    IoFile *io = scan->fs->container;
+    uint32_t per_chunk = INODE_SCAN_CHUNK / sizeof(Inode);
+
+    while (scan->segment < sb->inode_segment_count &&
+           scan->next >= inode_segment_entries(sb, scan->segment)) {
+        scan->segment++;
+        scan->next = 0;
+    }
+    if (scan->segment >= sb->inode_segment_count) return 0;
+
+    uint64_t left = inode_segment_entries(sb, scan->segment) - scan->next;
+    uint32_t count = left < per_chunk ? (uint32_t)left : per_chunk;
+    uint64_t offset = inode_segment_offset(sb, scan->segment) + scan->next * sizeof(Inode);
+    size_t bytes = (size_t)count * sizeof(Inode);
+    if (left > count) {
+        uint64_t ahead = left - count < per_chunk ? left - count : per_chunk;
+        io_advise(io, offset + bytes, ahead * sizeof(Inode), IO_ADVISE_WILLNEED);
+    }
+
+    scan->chunk = io_map(io, offset, bytes);
+    if (!scan->chunk) {
+        if (!scan->buf && !(scan->buf = malloc(INODE_SCAN_CHUNK))) {
+            scan->failed = 1;
+            return 0;
+        }
+        // Les entrees non lues restent a zero (libres)
+        size_t got = io_read(io, offset, scan->buf, bytes);
+        if (got < bytes) memset((char *)scan->buf + got, 0, bytes - got);
+        scan->chunk = scan->buf;
+    }
+    scan->count = count;
+    scan->pos = 0;
+    scan->next += count;
+    return 1;
+}
+
+// Inode suivant et son numero, NULL en fin de table. Comme pour
+// read_inode_current, la copie en cache ou dans la transaction en
+// construction prime sur celle du disque.
+static const Inode *inode_scan_next(InodeScan *scan, uint32_t *index) {
+    if (scan->pos == scan->count && !inode_scan_fill(scan)) return NULL;
+
+    FileSystem *fs = scan->fs;
+    const Inode *inode = &scan->chunk[scan->pos++];
+    *index = scan->index++;
+    if (fs->cache_count > 0) {
+        CacheNode *node = cache_find(fs, (int)*index);
+        if (node) return &node->inode;
+    }
+    if (fs->journal.slot_count > 0 &&
+        journal_lookup(fs, inode_offset(&fs->sb, *index), &scan->pending, sizeof(Inode)) == 0) {
+        return &scan->pending;
+    }
+    return inode;
+}
+
+// --- Bitmap des inodes libres ---
+
+static int inode_bitmap_resize(FileSystem *fs, uint32_t old_max, uint32_t new_max) {
+    uint32_t words = (new_max + 63) / 64;
+    uint64_t *bitmap = realloc(fs->inode_bitmap, words * sizeof(uint64_t));
+    if (!bitmap) return -1;
+
+    for (uint32_t w = fs->inode_bitmap_words; w < words; w++) bitmap[w] = 0;
+    fs->inode_bitmap = bitmap;
+    fs->inode_bitmap_words = words;
+
+    // Les nouvelles entrees sont libres
+    for (uint32_t i = old_max; i < new_max; i++) {
+        bitmap[i / 64] |= 1ULL << (i % 64);
+    }
+    if (old_max < new_max && old_max / 64 < fs->inode_hint) fs->inode_hint = old_max / 64;
+    fs->path_index_changed = 1;
+    return 0;
+}
+
+static void inode_mark_used(FileSystem *fs, int inode_index) {
+    fs->inode_bitmap[inode_index / 64] &= ~(1ULL << (inode_index % 64));
+    fs->path_index_changed = 1;
+}
+
+static void inode_mark_free(FileSystem *fs, int inode_index) {
+    fs->inode_bitmap[inode_index / 64] |= 1ULL << (inode_index % 64);
+    fs->path_index_changed = 1;
+    if ((uint32_t)inode_index / 64 < fs->inode_hint) fs->inode_hint = inode_index / 64;
+}
+
+// Premier inode libre (-1 si la table est pleine), un mot de 64 entrees a la fois
+static int inode_bitmap_find(FileSystem *fs) {
+    for (uint32_t w = fs->inode_hint; w < fs->inode_bitmap_words; w++) {
+        if (fs->inode_bitmap[w] != 0) {
+            fs->inode_hint = w;
+            return (int)(w * 64 + (uint32_t)__builtin_ctzll(fs->inode_bitmap[w]));
         }
     }
+    fs->inode_hint = fs->inode_bitmap_words;
+    return -1;
+}
+
+// --- Tas de noms ---
+
+#define MAX_DEPTH 256
+
+static int name_heap_reserve(NameHeap *heap, uint64_t needed) {
+    if (needed <= heap->capacity) return 0;
+
+    uint64_t capacity = heap->capacity ? heap->capacity * 2 : BLOCK_SIZE;
+    while (capacity < needed) capacity *= 2;
+
+    char *data = realloc(heap->data, capacity);
+    if (!data) return -1;
+    heap->data = data;
+    heap->capacity = capacity;
+    return 0;
+}
+
+// Ajoute un nom en fin de tas et retourne sa position (0 en cas d'erreur :
+// la position 0 est la chaine vide de la racine)
+static uint64_t name_heap_add(NameHeap *heap, const char *name) {
+    uint64_t len = strlen(name) + 1;
+    if (name_heap_reserve(heap, heap->size + len) != 0) return 0;
+
+    uint64_t offset = heap->size;
+    memcpy(heap->data + offset, name, len);
+    heap->size += len;
+    return offset;
+}
+
+// Le nom n'est pas retire du tas : il sera recupere au prochain compactage
+static void name_heap_release(NameHeap *heap, uint64_t offset) {
+    if (offset == 0 || offset >= heap->size) return;
+    heap->garbage += strlen(heap->data + offset) + 1;
+}
+
+// Charge le tas de noms ; un tas vide commence par la chaine vide de la racine
+static int name_heap_load(FileSystem *fs) {
+    NameHeap *heap = &fs->names;
+    memset(heap, 0, sizeof(NameHeap));
+
+    uint64_t size = fs->sb.name_heap_offset != 0 ? fs->sb.name_heap_size : 0;
+    if (size > fs->sb.name_heap_capacity) return -1;
+    if (name_heap_reserve(heap, size > 0 ? size : 1) != 0) return -1;
+
+    if (size == 0) {
+        heap->data[0] = '\0';
+        heap->size = 1;
+        return 0;
+    }
+
+    if (io_read(fs->container, fs->sb.name_heap_offset, heap->data, size) != size ||
+        heap->data[0] != '\0' || heap->data[size - 1] != '\0') {
+        return -1;
+    }
+    heap->size = size;
+    heap->flushed = size;
+    return 0;
+}
+
+const char *fs_inode_name(FileSystem *fs, const Inode *inode) {
+    if (inode->name_offset >= fs->names.size) return "";
+    return fs->names.data + inode->name_offset;
+}
+
+// --- Cache des chemins (dentry cache) ---
+
+static void dentry_cache_init(FileSystem *fs) {
+    for (int i = 0; i < DENTRY_CACHE_SIZE; i++) {
+        fs->dentry_cache[i].inode_index = -1;
+    }
+    fs->dentry_generation = 0;
+}
+
+// Un deplacement ou une suppression de repertoire change les chemins de tout
+// son sous-arbre : toutes les entrees sont invalidees d'un coup
+static void dentry_cache_invalidate(FileSystem *fs) {
+    fs->dentry_generation++;
+}
+
+static const char *dentry_cache_get(FileSystem *fs, uint32_t idx) {
+    DentryCacheEntry *entry = &fs->dentry_cache[idx % DENTRY_CACHE_SIZE];
+    if (entry->inode_index == (int)idx && entry->generation == fs->dentry_generation) {
+        return entry->path;
+    }
+    return NULL;
+}
+
+static void dentry_cache_put(FileSystem *fs, uint32_t idx, const char *path) {
+    DentryCacheEntry *entry = &fs->dentry_cache[idx % DENTRY_CACHE_SIZE];
+    entry->inode_index = (int)idx;
+    entry->generation = fs->dentry_generation;
+    strncpy(entry->path, path, MAX_PATH - 1);
+    entry->path[MAX_PATH - 1] = '\0';
 }
 
-// Reconstruit la hash table a partir des inodes actuels
-static void hash_table_rebuild(FileSystem *fs) {
-    hash_table_init(fs);
-    for (int i = 0; i < fs->sb.max_files; i++) {
+// Construit le chemin absolu d'un inode en remontant la chaine des parents
+// jusqu'a la racine ou jusqu'au premier repertoire dont le chemin est en
+// cache. Les chemins des repertoires traverses sont mis en cache au passage.
+static int build_inode_path(FileSystem *fs, uint32_t idx, char *out, size_t size) {
+    uint32_t chain[MAX_DEPTH];
+    uint64_t names[MAX_DEPTH];
+    int depth = 0;
+    size_t off = 0;
+
+    if (size < 2) return -1;
+    out[0] = '\0';
+
+    while (idx != ROOT_INODE) {
+        const char *cached = dentry_cache_get(fs, idx);
+        if (cached) {
+            off = strlen(cached);
+            if (off + 1 > size) return -1;
+            memcpy(out, cached, off + 1);
+            break;
+        }
+        if (depth == MAX_DEPTH || idx >= fs->sb.max_files) return -1;
+
         Inode inode;
-        read_inode_from_disk(fs, i, &inode);
-        if (inode.filename[0] != '\0') {
-            char full_path[MAX_PATH];
-            if (strcmp(inode.parent_path, "/") == 0) {
-                snprintf(full_path, MAX_PATH, "/%s", inode.filename);
-            } else {
-                snprintf(full_path, MAX_PATH, "%s/%s", inode.parent_path,
-                         inode.filename);
+        read_inode_current(fs, (int)idx, &inode);
+        if (inode.type == INODE_FREE) return -1;
+
+        chain[depth] = idx;
+        names[depth] = inode.name_offset;
+        depth++;
+        idx = inode.parent;
+    }
+
+    for (int i = depth - 1; i >= 0; i--) {
+        const char *name = names[i] < fs->names.size ? fs->names.data + names[i] : "";
+        size_t len = strlen(name);
+        if (off + len + 2 > size) return -1;
+        out[off++] = '/';
+        memcpy(out + off, name, len);
+        off += len;
+        out[off] = '\0';
+        // Seuls les ancetres sont des repertoires surs
+        if (i > 0) dentry_cache_put(fs, chain[i], out);
+    }
+
+    if (off == 0) strcpy(out, "/");
+    return 0;
+}
+
+int fs_inode_path(FileSystem *fs, int inode_index, char *out, size_t size) {
+    if (inode_index < 0) return -1;
+    return build_inode_path(fs, (uint32_t)inode_index, out, size);
+}
+
+// --- Index des enfants des repertoires (en memoire) ---
+
+static DirIndex *dir_index_new(void) {
+    return calloc(1, sizeof(DirIndex));
+}
+
+static void dir_index_free(DirIndex *di) {
+    if (!di) return;
+    free(di->children);
+    free(di);
+}
+
+static int dir_index_push(DirIndex *di, uint32_t child) {
+    if (di->count == di->capacity) {
+        uint32_t capacity = di->capacity ? di->capacity * 2 : 16;
+        uint32_t *children = realloc(di->children, capacity * sizeof(uint32_t));
+        if (!children) return -1;
+        di->children = children;
+        di->capacity = capacity;
+    }
+    di->children[di->count++] = child;
+    di->dirty = 1;
+    return 0;
+}
+
+static int dir_index_resize(FileSystem *fs, uint32_t new_max) {
+    if (new_max <= fs->dirs_capacity) return 0;
+    DirIndex **dirs = realloc(fs->dirs, new_max * sizeof(DirIndex *));
+    if (!dirs) return -1;
+    memset(dirs + fs->dirs_capacity, 0, (new_max - fs->dirs_capacity) * sizeof(DirIndex *));
+    fs->dirs = dirs;
+    fs->dirs_capacity = new_max;
+    return 0;
+}
+
+static void dir_index_destroy(FileSystem *fs) {
+    for (uint32_t i = 0; i < fs->dirs_capacity; i++) {
+        dir_index_free(fs->dirs[i]);
+    }
+    free(fs->dirs);
+    fs->dirs = NULL;
+    fs->dirs_capacity = 0;
+}
+
+static uint64_t inode_data_end(FileSystem *fs, const Inode *inode);
+
+// Parcourt la table d'inodes une seule fois, par gros morceaux, pour
+// reconstruire la hash table et le bitmap des inodes libres, et si data_end
+// n'est pas NULL la fin des donnees des inodes. Chaque entree est indexee
+// par (parent, nom), sans reconstruire de chemin. Les repertoires qui n'ont
+// pas encore d'index de leurs enfants (images plus anciennes) le recoivent
+// pendant ce parcours.
+static int inode_table_load(FileSystem *fs, uint64_t *data_end) {
+    if (hash_table_init(fs, fs->sb.num_files) != 0) return -1;
+    free(fs->inode_bitmap);
+    fs->inode_bitmap = NULL;
+    fs->inode_bitmap_words = 0;
+    fs->inode_hint = 0;
+    if (inode_bitmap_resize(fs, 0, fs->sb.max_files) != 0) return -1;
+
+    dir_index_destroy(fs);
+    if (dir_index_resize(fs, fs->sb.max_files) != 0) return -1;
+
+    // Enfants vus avant leur repertoire : rattaches une fois la table lue
+    uint32_t *later = NULL;
+    size_t later_count = 0, later_capacity = 0;
+    int ret = -1;
+
+    InodeScan scan;
+    const Inode *inode;
+    uint32_t i;
+    inode_scan_open(fs, &scan);
+    while ((inode = inode_scan_next(&scan, &i)) != NULL) {
+        if (inode->type == INODE_FREE) continue;
+
+        inode_mark_used(fs, (int)i);
+        if (data_end) {
+            uint64_t end = inode_data_end(fs, inode);
+            if (end > *data_end) *data_end = end;
+        }
+        if (inode->type == INODE_DIR && !(inode->flags & INODE_FLAG_DIR_INDEX)) {
+            fs->dirs[i] = dir_index_new();
+            if (!fs->dirs[i]) goto out;
+            fs->dirs[i]->dirty = 1;
+        }
+        if (i == ROOT_INODE || inode_is_shared(inode)) continue;
+
+        if (inode->name_offset == 0 || inode->name_offset >= fs->names.size ||
+            inode->parent >= fs->sb.max_files) {
+            fprintf(stderr, "Avertissement : inode %u sans nom ou parent valide\n", i);
+            continue;
+        }
+        hash_table_insert(fs, inode->parent, inode->name_offset, (int)i);
+        // Le repertoire des instantanes n'est pas liste dans la racine
+        if (i == fs->sb.snapshot_dir) continue;
+        if (inode->parent < i) {
+            DirIndex *parent_dir = fs->dirs[inode->parent];
+            if (parent_dir && dir_index_push(parent_dir, i) != 0) goto out;
+            continue;
+        }
+        if (later_count + 2 > later_capacity) {
+            size_t capacity = later_capacity ? later_capacity * 2 : 256;
+            uint32_t *grown = realloc(later, capacity * sizeof(uint32_t));
+            if (!grown) goto out;
+            later = grown;
+            later_capacity = capacity;
+        }
+        later[later_count++] = inode->parent;
+        later[later_count++] = i;
+    }
+    if (scan.failed) goto out;
+
+    for (size_t k = 0; k < later_count; k += 2) {
+        DirIndex *parent_dir = fs->dirs[later[k]];
+        if (parent_dir && dir_index_push(parent_dir, later[k + 1]) != 0) goto out;
+    }
+    ret = 0;
+
+out:
+    inode_scan_close(&scan);
+    free(later);
+    return ret;
+}
+
+// Ecrit les inodes sales du cache, a travers la transaction en cours
+static void cache_flush(FileSystem *fs) {
+    for (int i = 0; i < fs->cache_count; i++) {
+        CacheNode *node = &fs->cache_pool[i];
+        if (node->dirty) inode_write_back(fs, node);
+    }
+}
+
+// --- Gestion des extents ---
+
+typedef struct {
+    Extent *items;
+    uint32_t count;
+    uint32_t capacity;
+} ExtentList;
+
+static uint64_t blocks_for_size(uint64_t size) {
+    return (size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+}
+
+// Ajoute une plage a la liste en la fusionnant avec la precedente si contigue
+static int extent_list_push(ExtentList *list, uint64_t offset, uint64_t length) {
+    if (list->count > 0) {
+        Extent *last = &list->items[list->count - 1];
+        if (last->offset + last->length == offset) {
+            last->length += length;
+            return 0;
+        }
+    }
+    if (list->count == list->capacity) {
+        uint32_t capacity = list->capacity ? list->capacity * 2 : 8;
+        Extent *items = realloc(list->items, capacity * sizeof(Extent));
+        if (!items) return -1;
+        list->items = items;
+        list->capacity = capacity;
+    }
+    list->items[list->count].offset = offset;
+    list->items[list->count].length = length;
+    list->count++;
+    return 0;
+}
+
+static void extent_list_free(ExtentList *list) {
+    free(list->items);
+    list->items = NULL;
+    list->count = list->capacity = 0;
+}
+
+// Charge la liste complete des extents d'un inode (inline + blocs de debordement)
+static int inode_load_extents(FileSystem *fs, const Inode *inode, ExtentList *list) {
+    list->items = NULL;
+    list->count = list->capacity = 0;
+
+    if (inode->type == INODE_FREE || inode->extent_count == 0) return 0;
+
+    uint32_t inline_count = inode->extent_count < INODE_INLINE_EXTENTS ?
+                            inode->extent_count : INODE_INLINE_EXTENTS;
+    for (uint32_t i = 0; i < inline_count; i++) {
+        if (extent_list_push(list, inode->extents[i].offset, inode->extents[i].length) != 0) {
+            extent_list_free(list);
+            return -1;
+        }
+    }
+
+    uint64_t block = inode->extent_block;
+    while (block != 0) {
+        ExtentBlock eb;
+        if (io_read(fs->container, block, &eb, sizeof(ExtentBlock)) != sizeof(ExtentBlock) ||
+            eb.magic != EXTENT_BLOCK_MAGIC || eb.count > EXTENTS_PER_BLOCK) {
+            fprintf(stderr, "Erreur : bloc d'extents corrompu (offset %llu)\n",
+                    (unsigned long long)block);
+            extent_list_free(list);
+            return -1;
+        }
+        for (uint32_t i = 0; i < eb.count; i++) {
+            if (extent_list_push(list, eb.extents[i].offset, eb.extents[i].length) != 0) {
+                extent_list_free(list);
+                return -1;
             }
-            hash_table_insert(fs, full_path, i);
         }
+        block = eb.next;
+    }
+    return 0;
+}
+
+// Fin de la derniere zone occupee par un inode (donnees et blocs de debordement)
+static uint64_t inode_data_end(FileSystem *fs, const Inode *inode) {
+    if (inode->type == INODE_FREE || inode->extent_count == 0) return 0;
+
+    uint64_t end = 0;
+
+    uint32_t inline_count = inode->extent_count < INODE_INLINE_EXTENTS ?
+                            inode->extent_count : INODE_INLINE_EXTENTS;
+    for (uint32_t i = 0; i < inline_count; i++) {
+        uint64_t e = inode->extents[i].offset + inode->extents[i].length;
+        if (e > end) end = e;
+    }
+
+    uint64_t block = inode->extent_block;
+    while (block != 0) {
+        if (block + BLOCK_SIZE > end) end = block + BLOCK_SIZE;
+        ExtentBlock eb;
+        if (io_read(fs->container, block, &eb, sizeof(ExtentBlock)) != sizeof(ExtentBlock) ||
+            eb.magic != EXTENT_BLOCK_MAGIC || eb.count > EXTENTS_PER_BLOCK) {
+            break;
+        }
+        for (uint32_t i = 0; i < eb.count; i++) {
+            uint64_t e = eb.extents[i].offset + eb.extents[i].length;
+            if (e > end) end = e;
+        }
+        block = eb.next;
     }
+    return end;
 }
 
 static char *normalize_path(const char *path) {
@@ -272,14 +1060,14 @@ static void extract_parent_path(const char *path, char *parent, size_t size) {
 static int path_exists(FileSystem *fs, const char *path, int *is_dir) {
     char *normalized = normalize_path(path);
     
-    int idx = hash_table_lookup(fs, normalized);
+    int idx = hash_table_resolve(fs, normalized);
     if (idx >= 0) {
         Inode *inode = get_inode(fs, idx);
         if (inode) {
             inode->accessed = time(NULL);
-            mark_inode_dirty(fs, idx);
+            mark_inode_dirty(fs, inode);
             if (is_dir) {
-                *is_dir = inode->is_directory;
+                *is_dir = inode->type == INODE_DIR;
             }
         }
         free(normalized);
@@ -290,27 +1078,59 @@ static int path_exists(FileSystem *fs, const char *path, int *is_dir) {
     return -1;
 }
 
-static int parent_exists(FileSystem *fs, const char *parent_path) {
-    if (strcmp(parent_path, "/") == 0) return 1;
-    return path_exists(fs, parent_path, NULL) >= 0;
+// Index du repertoire parent, -1 s'il n'existe pas ou n'est pas un repertoire
+static int parent_index(FileSystem *fs, const char *parent_path) {
+    int is_dir = 0;
+    int idx = path_exists(fs, parent_path, &is_dir);
+    return (idx >= 0 && is_dir) ? idx : -1;
+}
+
+int fs_in_snapshot(FileSystem *fs, int inode_index) {
+    if (fs->sb.snapshot_dir == 0 || inode_index < 0) return 0;
+    uint32_t p = (uint32_t)inode_index;
+    for (uint32_t depth = 0; depth < MAX_DEPTH && p != ROOT_INODE; depth++) {
+        if (p == fs->sb.snapshot_dir) return 1;
+        Inode ancestor;
+        read_inode_current(fs, (int)p, &ancestor);
+        p = ancestor.parent;
+    }
+    return 0;
+}
+
+// Les instantanes ne changent qu'a travers fs_snapshot_* : -1 (avec le
+// message) si l'entree idx en fait partie
+static int snapshot_refuse(FileSystem *fs, int idx, const char *path) {
+    if (!fs_in_snapshot(fs, idx)) return 0;
+    fprintf(stderr, "Erreur : '%s' appartient à un instantané, en lecture seule\n", path);
+    return -1;
+}
+
+int fs_lookup(FileSystem *fs, const char *path) {
+    char *normalized = normalize_path(path);
+    if (!normalized) return -1;
+    int idx = hash_table_resolve(fs, normalized);
+    free(normalized);
+    return idx;
 }
 
 int fs_create(const char *path) {
-    FILE *f = fopen(path, "wb");
-    if (!f) {
+    IoFile *io = io_create(path);
+    if (!io) {
         perror("Impossible de créer le système de fichiers");
         return -1;
     }
 
     SuperBlock sb = {0};
     sb.magic = FS_MAGIC;
-    sb.version = 2; // Nouvelle version avec alignement et métadonnées riches
-    sb.num_files = 0;
+    sb.version = FS_VERSION; // Inodes compacts, noms dans un tas séparé
+    sb.num_files = 1;        // La racine
     sb.max_files = MAX_FILES;
     
     // Aligner la table d'inodes sur 4096 octets
     // Le SuperBlock fait 4096 octets grâce au padding
     sb.inode_table_offset = sizeof(SuperBlock);
+    sb.inode_segment_base = MAX_FILES;
+    sb.inode_segment_count = 1;
     
     // Aligner la zone de données après la table d'inodes initiale
     uint64_t inode_table_size = (uint64_t)MAX_FILES * sizeof(Inode);
@@ -318,73 +1138,222 @@ int fs_create(const char *path) {
     sb.data_offset = sb.inode_table_offset + aligned_inode_table_size;
     
     sb.first_free_block = 0;
+    sb.data_end = sb.data_offset;
 
-    if (fwrite(&sb, sizeof(SuperBlock), 1, f) != 1) {
-        perror("Échec d'écriture du superblock");
-        fclose(f);
-        return -1;
-    }
+    // Table d'inodes : la racine, puis des zéros jusqu'à l'offset de données
+    Inode root = {0};
+    root.type = INODE_DIR;
+    root.mode = 0755;
+    root.uid = getuid();
+    root.gid = getgid();
+    root.link_count = 1;
+    root.parent = ROOT_INODE;
+    root.created = time(NULL);
+    root.modified = root.created;
+    root.accessed = root.created;
 
-    // Initialiser la table d'inodes avec des zéros (jusqu'à l'offset de données)
-    fseek(f, sb.inode_table_offset, SEEK_SET);
-    Inode empty = {0};
-    for (int i = 0; i < MAX_FILES; i++) {
-        if (fwrite(&empty, sizeof(Inode), 1, f) != 1) {
-            perror("Échec d'initialisation des inodes");
-            fclose(f);
-            return -1;
-        }
-    }
-    
-    // Remplir le reste de l'alignement de la table d'inodes avec des zéros si nécessaire
-    long current_pos = ftell(f);
-    if ((uint64_t)current_pos < sb.data_offset) {
-        uint64_t remaining = sb.data_offset - (uint64_t)current_pos;
-        char *zero_buf = calloc(1, remaining);
-        fwrite(zero_buf, 1, remaining, f);
-        free(zero_buf);
+    // SuperBlock et racine se suivent : une seule écriture vectorisée. Le
+    // reste de la table n'est pas écrit : le fichier est agrandi jusqu'à
+    // l'offset de données et ces inodes libres restent un trou.
+    struct iovec iov[2] = {
+        { &sb, sizeof(SuperBlock) },
+        { &root, sizeof(Inode) },
+    };
+    if (io_writev(io, 0, iov, 2) != sizeof(SuperBlock) + sizeof(Inode) ||
+        io_extend(io, sb.data_offset) != 0) {
+        perror("Échec d'initialisation du système de fichiers");
+        io_close(io);
+        return -1;
     }
 
-    fclose(f);
+    io_close(io);
     printf("Système de fichiers créé : %s (Aligné sur 4096 octets)\n", path);
     return 0;
 }
 
+static int data_end_valid(FileSystem *fs);
+static uint64_t inodes_data_end(FileSystem *fs);
+static void rebuild_data_end(FileSystem *fs, uint64_t inodes_end);
+static void release_data_tail(FileSystem *fs);
+static void free_map_load(FileSystem *fs);
+static void free_map_save(FileSystem *fs);
+static void name_heap_save(FileSystem *fs, int compact);
+static void dir_index_save_all(FileSystem *fs);
+static int journal_replay(FileSystem *fs);
+static int journal_create(FileSystem *fs);
+static int journal_commit(FileSystem *fs, int compact);
+static int path_index_load(FileSystem *fs);
+static void path_index_reserve(FileSystem *fs);
+static void path_index_save(FileSystem *fs);
+static void ref_map_load(FileSystem *fs);
+static void dedup_index_load(FileSystem *fs);
+static void dedup_index_reserve(FileSystem *fs);
+static void dedup_index_save(FileSystem *fs);
+
 FileSystem *fs_open(const char *path) {
+    return fs_open_with(path, NULL);
+}
+
+FileSystem *fs_open_with(const char *path, const FsOpenOptions *options) {
+    uint32_t cache_size = LRU_CACHE_SIZE;
+    if (options && options->cache_size > 0) cache_size = options->cache_size;
+
+    // Backend d'E/S : option, sinon variable CSFS_IO, sinon pread
+    int io_backend = options ? options->io_backend : 0;
+    if (io_backend == 0) {
+        const char *env = getenv("CSFS_IO");
+        io_backend = io_backend_from_name(env);
+        if (env && io_backend == 0) {
+            fprintf(stderr, "Avertissement : CSFS_IO='%s' inconnu, backend pread utilisé\n", env);
+        }
+    }
+    if (io_backend == 0) io_backend = IO_BACKEND_PREAD;
+
+    // Verification des sommes : option, sinon variable CSFS_VERIFY, sinon stricte
+    int verify = options ? options->verify : 0;
+    if (verify == 0) {
+        const char *env = getenv("CSFS_VERIFY");
+        verify = fs_verify_from_name(env);
+        if (env && verify == 0) {
+            fprintf(stderr, "Avertissement : CSFS_VERIFY='%s' inconnu, vérification stricte\n", env);
+        }
+    }
+    if (verify == 0) verify = FS_VERIFY_STRICT;
+
     FileSystem *fs = malloc(sizeof(FileSystem));
     if (!fs) return NULL;
+    fs->verify = verify;
 
-    fs->container = fopen(path, "r+b");
+    fs->container = io_open(path, io_backend);
     if (!fs->container) {
         free(fs);
         perror("Impossible d'ouvrir le système de fichiers");
         return NULL;
     }
 
-    if (fread(&fs->sb, sizeof(SuperBlock), 1, fs->container) != 1) {
+    if (io_read(fs->container, 0, &fs->sb, sizeof(SuperBlock)) != sizeof(SuperBlock)) {
         perror("Lecture du superblock échouée");
-        fclose(fs->container);
+        io_close(fs->container);
         free(fs);
         return NULL;
     }
 
     if (fs->sb.magic != FS_MAGIC) {
         fprintf(stderr, "Erreur : ce n'est pas un système de fichiers valide\n");
-        fclose(fs->container);
+        io_close(fs->container);
+        free(fs);
+        return NULL;
+    }
+
+    if (fs->sb.version != FS_VERSION) {
+        if (fs->sb.version == 2) {
+            fprintf(stderr, "Erreur : image au format v2, la convertir avec la commande 'upgrade'\n");
+        } else {
+            fprintf(stderr, "Erreur : version de format %u non supportée\n", fs->sb.version);
+        }
+        io_close(fs->container);
+        free(fs);
+        return NULL;
+    }
+
+    // Transaction interrompue : le SuperBlock relu est celui qu'elle valide
+    memset(&fs->journal, 0, sizeof(Journal));
+    freemap_init(&fs->journal.pending_free);
+    if (journal_replay(fs) != 0) {
+        fprintf(stderr, "Erreur : rejeu du journal impossible\n");
+        io_close(fs->container);
+        free(fs);
+        return NULL;
+    }
+    // Ce qui est corrige ci-dessous (segments, fin des donnees, ancienne free
+    // list) l'est sur disque a la premiere transaction
+    fs->journal.committed = fs->sb;
+
+    // Table d'un seul tenant (image anterieure aux segments) : un seul segment
+    if (fs->sb.inode_segment_count == 0) {
+        fs->sb.inode_segment_base = fs->sb.max_files;
+        fs->sb.inode_segment_count = 1;
+    }
+    if (fs->sb.inode_segment_base == 0 || fs->sb.inode_segment_count > INODE_SEGMENTS ||
+        ((uint64_t)fs->sb.inode_segment_base << (fs->sb.inode_segment_count - 1)) != fs->sb.max_files) {
+        fprintf(stderr, "Erreur : table d'inodes incohérente\n");
+        io_close(fs->container);
+        free(fs);
+        return NULL;
+    }
+
+    if (name_heap_load(fs) != 0) {
+        fprintf(stderr, "Erreur : tas de noms corrompu\n");
+        free(fs->names.data);
+        io_close(fs->container);
         free(fs);
         return NULL;
     }
 
     // Initialiser le cache LRU
-    fs->cache_head = NULL;
-    fs->cache_tail = NULL;
-    fs->cache_count = 0;
-    for (int i = 0; i < LRU_CACHE_SIZE; i++) {
-        fs->cache_nodes[i] = NULL;
+    if (cache_init(fs, cache_size) != 0) {
+        fprintf(stderr, "Erreur : mémoire insuffisante\n");
+        free(fs->names.data);
+        io_close(fs->container);
+        free(fs);
+        return NULL;
+    }
+
+    // Repertoire des instantanes qui n'en est pas un : oublie
+    if (fs->sb.snapshot_dir != 0) {
+        Inode snapshots = {0};
+        if (fs->sb.snapshot_dir < fs->sb.max_files) {
+            read_inode_current(fs, (int)fs->sb.snapshot_dir, &snapshots);
+        }
+        if (snapshots.type != INODE_DIR || snapshots.parent != ROOT_INODE) {
+            fprintf(stderr, "Avertissement : répertoire des instantanés invalide, ignoré\n");
+            fs->sb.snapshot_dir = 0;
+        }
+    }
+
+    // Hash table pour recherche O(1) et bitmap des inodes libres : index
+    // sauvegarde s'il est a jour, sinon parcours de la table d'inodes
+    dentry_cache_init(fs);
+    fs->inode_bitmap = NULL;
+    fs->dirs = NULL;
+    fs->dirs_capacity = 0;
+    fs->hash_table = NULL;
+    fs->path_index_current = 0;
+    // Une marque de fin des donnees a recalculer l'est pendant ce parcours
+    int rescan = !data_end_valid(fs);
+    uint64_t inodes_end = 0;
+    if (path_index_load(fs) == 0) {
+        if (rescan) inodes_end = inodes_data_end(fs);
+    } else if (inode_table_load(fs, rescan ? &inodes_end : NULL) != 0) {
+        fprintf(stderr, "Erreur : mémoire insuffisante\n");
+        cache_destroy(fs);
+        dir_index_destroy(fs);
+        free(fs->hash_table);
+        free(fs->inode_bitmap);
+        free(fs->names.data);
+        io_close(fs->container);
+        free(fs);
+        return NULL;
     }
+    // L'index reconstruit decrit l'etat valide : il reste a le sauvegarder
+    fs->path_index_changed = 0;
 
-    // Construire la hash table pour recherche O(1)
-    hash_table_rebuild(fs);
+    // Fixer la marque de fin des donnees, puis charger l'espace libre
+    if (rescan) rebuild_data_end(fs, inodes_end);
+    free_map_load(fs);
+    freemap_truncate(&fs->free_map, fs->sb.data_end);
+    ref_map_load(fs);
+    dedup_index_load(fs);
+
+    // Le journal est cree apres tout ce que l'etat sur disque designe ou
+    // decrit comme libre
+    fs->journal.last_commit = time(NULL);
+    if (fs->sb.journal_offset == 0 && journal_create(fs) != 0) {
+        fprintf(stderr, "Avertissement : création du journal impossible, écritures directes\n");
+        fs->sb.journal_offset = 0;
+        fs->sb.journal_capacity = 0;
+    }
+    release_data_tail(fs);
 
     return fs;
 }
@@ -392,525 +1361,4408 @@ FileSystem *fs_open(const char *path) {
 void fs_close(FileSystem *fs) {
     if (!fs) return;
 
-    // Sauvegarder le SuperBlock
-    fseek(fs->container, 0, SEEK_SET);
-    fwrite(&fs->sb, sizeof(SuperBlock), 1, fs->container);
-
-    // Écrire les inodes sales du cache sur le disque
-    for (int i = 0; i < fs->cache_count; i++) {
-        if (fs->cache_nodes[i]->dirty) {
-            write_inode_to_disk(fs, fs->cache_nodes[i]->inode_index, &fs->cache_nodes[i]->inode);
-        }
+    // Derniere transaction, avec compactage du tas de noms si besoin, puis
+    // l'index des entrees qu'elle laisse
+    path_index_reserve(fs);
+    dedup_index_reserve(fs);
+    if (journal_commit(fs, 1) == 0) {
+        path_index_save(fs);
+        dedup_index_save(fs);
     }
+    dir_index_destroy(fs);
+    free(fs->names.data);
+    freemap_destroy(&fs->free_map);
+    refmap_destroy(&fs->ref_map);
+    dedup_destroy(&fs->dedup);
+    freemap_destroy(&fs->journal.pending_free);
+    free(fs->journal.buf);
+    free(fs->journal.slots);
 
     // Libérer la mémoire du cache
-    for (int i = 0; i < fs->cache_count; i++) {
-        free(fs->cache_nodes[i]);
-    }
+    cache_destroy(fs);
+    free(fs->inode_bitmap);
+    free(fs->hash_table);
 
-    fclose(fs->container);
+    io_close(fs->container);
     free(fs);
 }
 
-static uint64_t find_data_end(const FileSystem *fs) {
-    uint64_t offset = fs->sb.data_offset;
-    for (int i = 0; i < fs->sb.max_files; i++) {
-        Inode inode;
-        uint64_t inode_offset = fs->sb.inode_table_offset + (uint64_t)i * sizeof(Inode);
-        fseek(fs->container, inode_offset, SEEK_SET);
-        if (fread(&inode, sizeof(Inode), 1, fs->container) == 1) {
-            if (inode.filename[0] != '\0' && !inode.is_directory) {
-                uint64_t end = inode.offset + inode.size;
-                if (end > offset) offset = end;
+// --- Conversion v2 -> v3 ---
+
+typedef struct {
+    char *path;
+    uint32_t index;       // Index v3 du repertoire
+} UpgradeDir;
+
+static int upgrade_dir_cmp(const void *a, const void *b) {
+    return strcmp(((const UpgradeDir *)a)->path, ((const UpgradeDir *)b)->path);
+}
+
+// Marque une plage comme occupee. Une plage qui en chevauche une autre deja
+// marquee est reprise bloc par bloc.
+static void upgrade_mark_used(FreeMap *used, uint64_t offset, uint64_t length) {
+    if (freemap_insert(used, offset, length) == 0) return;
+    for (uint64_t pos = 0; pos < length; pos += BLOCK_SIZE) {
+        uint64_t chunk = length - pos < BLOCK_SIZE ? length - pos : BLOCK_SIZE;
+        const FreeRun *next = freemap_next(used, offset + pos);
+        if (!next || next->offset >= offset + pos + chunk) freemap_insert(used, offset + pos, chunk);
+    }
+}
+
+// Plages encore utilisees par une image v2 : donnees des fichiers et blocs
+// de debordement de leurs extents
+static void upgrade_collect_used(IoFile *f, const InodeV2 *old, uint32_t old_max, FreeMap *used) {
+    for (uint32_t i = 0; i < old_max; i++) {
+        const InodeV2 *src = &old[i];
+        if (src->filename[0] == '\0' || src->is_directory) continue;
+
+        if (src->extent_count == 0) {
+            if (src->size > 0) upgrade_mark_used(used, src->offset, blocks_for_size(src->size) * BLOCK_SIZE);
+            continue;
+        }
+
+        uint32_t inline_count = src->extent_count < INODE_INLINE_EXTENTS ? src->extent_count : INODE_INLINE_EXTENTS;
+        for (uint32_t e = 0; e < inline_count; e++) {
+            upgrade_mark_used(used, src->extents[e].offset, src->extents[e].length);
+        }
+
+        uint32_t remaining = src->extent_count - inline_count;
+        uint64_t block = src->extent_block;
+        for (uint32_t hops = 0; block != 0 && remaining > 0 && hops < src->extent_count; hops++) {
+            ExtentBlock eb;
+            if (io_read(f, block, &eb, sizeof(ExtentBlock)) != sizeof(ExtentBlock) ||
+                eb.magic != EXTENT_BLOCK_MAGIC) {
+                break;
+            }
+            upgrade_mark_used(used, block, BLOCK_SIZE);
+            uint32_t n = eb.count < EXTENTS_PER_BLOCK ? eb.count : (uint32_t)EXTENTS_PER_BLOCK;
+            if (n > remaining) n = remaining;
+            for (uint32_t e = 0; e < n; e++) {
+                upgrade_mark_used(used, eb.extents[e].offset, eb.extents[e].length);
             }
+            remaining -= n;
+            block = eb.next;
         }
     }
-    
-    // La table d'inodes occupe aussi de l'espace
-    uint64_t table_end = fs->sb.inode_table_offset + (uint64_t)fs->sb.max_files * sizeof(Inode);
-    if (table_end > offset) offset = table_end;
-    
-    // Aligner la fin sur 4096 octets pour le prochain fichier
-    return (offset + 4095) & ~4095ULL;
 }
 
-static int find_free_inode(FileSystem *fs) {
-    for (int i = 0; i < fs->sb.max_files; i++) {
-        Inode inode;
-        read_inode_from_disk(fs, i, &inode);
-        if (inode.filename[0] == '\0') return i;
+// Reprend la chaine de blocs libres v2 en ne gardant que les blocs
+// reellement libres. L'ancien add ecrivait en fin de donnees sans consulter
+// la chaine : un bloc libere puis recouvert par un fichier y figure encore,
+// et son pointeur suivant est alors un octet de donnees. Le parcours
+// s'arrete donc au premier bloc invalide ou occupe ; les blocs suivants sont
+// perdus, jamais rendus a tort. Retourne 1 si la chaine a ete coupee.
+static int upgrade_filter_free_chain(IoFile *f, uint64_t first, uint64_t data_offset, uint64_t end,
+                                     const FreeMap *used, FreeMap *kept) {
+    uint64_t block = first;
+    while (block != 0) {
+        if (block % BLOCK_SIZE != 0 || block < data_offset || block + BLOCK_SIZE > end) return 1;
+        const FreeRun *next_used = freemap_next(used, block);
+        if (next_used && next_used->offset < block + BLOCK_SIZE) return 1;
+
+        FreeBlock fb;
+        if (io_read(f, block, &fb, sizeof(FreeBlock)) != sizeof(FreeBlock)) return 1;
+        // Un bloc deja present signale une boucle dans la chaine
+        if (freemap_insert(kept, block, BLOCK_SIZE) != 0) return 0;
+        block = fb.next_free_block;
     }
-    
-    // Plus d'inode libre, on étend la table
-    int old_max = fs->sb.max_files;
-    int new_max = old_max + 256;
-    
-    // Déplacer la table d'inodes après la fin des données actuelles pour éviter les chevauchements
-    uint64_t data_end = find_data_end(fs);
-    uint64_t new_table_offset = data_end;
-    
-    // Charger tous les anciens inodes et les réécrire au nouvel emplacement
-    Inode *all_inodes = malloc(old_max * sizeof(Inode));
-    for (int i = 0; i < old_max; i++) {
-        read_inode_from_disk(fs, i, &all_inodes[i]);
+    return 0;
+}
+
+// Convertit une image v2 : les inodes sont reecrits au format compact dans
+// une nouvelle table placee en fin de donnees, suivie du tas de noms.
+// L'inode v2 i devient l'inode v3 i + 1, la racine prenant l'inode 0. Les
+// donnees des fichiers ne sont pas deplacees ; l'ancienne table et les blocs
+// de l'ancienne chaine libre que plus aucun fichier n'occupe sont rendus a
+// l'espace libre.
+int fs_upgrade(const char *path) {
+    IoFile *f = io_open(path, IO_BACKEND_PREAD);
+    if (!f) {
+        perror("Impossible d'ouvrir le système de fichiers");
+        return -1;
     }
-    
-    fs->sb.inode_table_offset = new_table_offset;
-    fs->sb.max_files = new_max;
-    
-    // Réécrire les anciens
-    for (int i = 0; i < old_max; i++) {
-        write_inode_to_disk(fs, i, &all_inodes[i]);
+
+    SuperBlock sb;
+    if (io_read(f, 0, &sb, sizeof(SuperBlock)) != sizeof(SuperBlock) || sb.magic != FS_MAGIC) {
+        fprintf(stderr, "Erreur : ce n'est pas un système de fichiers valide\n");
+        io_close(f);
+        return -1;
     }
-    free(all_inodes);
-    
-    // Initialiser les nouveaux
-    Inode empty = {0};
-    for (int i = old_max; i < new_max; i++) {
-        write_inode_to_disk(fs, i, &empty);
+    if (sb.version == FS_VERSION) {
+        printf("Image déjà au format v%u : %s\n", FS_VERSION, path);
+        io_close(f);
+        return 0;
+    }
+    if (sb.version != 2) {
+        fprintf(stderr, "Erreur : version de format %u non supportée\n", sb.version);
+        io_close(f);
+        return -1;
     }
-    
-    printf("Table d'inodes étendue : %d -> %d entrées (nouvel offset: %llu)\n", 
-           old_max, new_max, (unsigned long long)new_table_offset);
-    
-    return old_max; // Le premier nouvel inode libre
-}
 
-int fs_mkdir(FileSystem *fs, const char *path) {
-    char *normalized = normalize_path(path);
-    char parent_path[MAX_PATH];
-    char dirname[MAX_FILENAME];
+    uint32_t old_max = sb.max_files;
+    uint32_t new_max = old_max + 256;
+    uint64_t old_table = sb.inode_table_offset;
+    uint64_t old_table_size = blocks_for_size((uint64_t)old_max * sizeof(InodeV2)) * BLOCK_SIZE;
 
-    extract_parent_path(normalized, parent_path, MAX_PATH);
-    extract_filename(normalized, dirname, MAX_FILENAME);
+    InodeV2 *old = calloc(old_max, sizeof(InodeV2));
+    Inode *table = calloc(new_max, sizeof(Inode));
+    UpgradeDir *dirs = calloc(old_max, sizeof(UpgradeDir));
+    NameHeap heap;
+    memset(&heap, 0, sizeof(heap));
+    FreeMap used, kept;
+    freemap_init(&used);
+    freemap_init(&kept);
+    int ret = -1;
+    uint32_t ndirs = 0;
 
-    if (path_exists(fs, normalized, NULL) >= 0) {
-        fprintf(stderr, "Erreur : '%s' existe déjà\n", normalized);
-        free(normalized);
-        return -1;
+    if (!old || !table || !dirs || name_heap_reserve(&heap, BLOCK_SIZE) != 0) {
+        fprintf(stderr, "Erreur : mémoire insuffisante\n");
+        goto out;
     }
+    heap.data[0] = '\0';
+    heap.size = 1;
 
-    if (!parent_exists(fs, parent_path)) {
-        fprintf(stderr, "Erreur : le répertoire parent '%s' n'existe pas\n", parent_path);
-        free(normalized);
-        return -1;
+    size_t old_bytes = (size_t)old_max * sizeof(InodeV2);
+    if (io_read(f, old_table, old, old_bytes) != old_bytes) {
+        fprintf(stderr, "Erreur : lecture de la table d'inodes v2 impossible\n");
+        goto out;
     }
 
-    int idx = find_free_inode(fs);
-    if (idx == -1) {
-        fprintf(stderr, "Erreur : pas d'inode disponible\n");
-        free(normalized);
-        return -1;
+    // Chemins des repertoires, tries pour resoudre les parent_path
+    for (uint32_t i = 0; i < old_max; i++) {
+        if (old[i].filename[0] == '\0' || !old[i].is_directory) continue;
+        char full_path[MAX_PATH + MAX_FILENAME];
+        if (strcmp(old[i].parent_path, "/") == 0) {
+            snprintf(full_path, sizeof(full_path), "/%s", old[i].filename);
+        } else {
+            snprintf(full_path, sizeof(full_path), "%s/%s", old[i].parent_path, old[i].filename);
+        }
+        dirs[ndirs].path = strdup(full_path);
+        dirs[ndirs].index = i + 1;
+        if (!dirs[ndirs].path) {
+            fprintf(stderr, "Erreur : mémoire insuffisante\n");
+            goto out;
+        }
+        ndirs++;
     }
+    qsort(dirs, ndirs, sizeof(UpgradeDir), upgrade_dir_cmp);
 
-    Inode *inode = get_inode(fs, idx);
-    strncpy(inode->filename, dirname, MAX_FILENAME - 1);
-    inode->filename[MAX_FILENAME - 1] = '\0';
-    strncpy(inode->parent_path, parent_path, MAX_PATH - 1);
-    inode->parent_path[MAX_PATH - 1] = '\0';
-    inode->is_directory = 1;
-    inode->size = 0;
-    inode->offset = 0;
-    inode->created = time(NULL);
-    inode->modified = inode->created;
-    inode->accessed = inode->created;
-    inode->uid = getuid();
-    inode->gid = getgid();
-    inode->mode = 0755;
-    inode->link_count = 1;
-    inode->inode_number = idx;
-    mark_inode_dirty(fs, idx);
+    Inode *root = &table[ROOT_INODE];
+    root->type = INODE_DIR;
+    root->mode = 0755;
+    root->uid = getuid();
+    root->gid = getgid();
+    root->link_count = 1;
+    root->parent = ROOT_INODE;
+    root->created = time(NULL);
+    root->modified = root->created;
+    root->accessed = root->created;
 
-    fs->sb.num_files++;
+    uint32_t num_files = 1;
+    for (uint32_t i = 0; i < old_max; i++) {
+        const InodeV2 *src = &old[i];
+        if (src->filename[0] == '\0') continue;
 
-    // Ajouter a la hash table pour acces O(1)
-    hash_table_insert(fs, normalized, idx);
+        Inode *dst = &table[i + 1];
+        dst->type = src->is_directory ? INODE_DIR : INODE_FILE;
+        dst->flags = (uint16_t)src->flags;
+        dst->mode = src->mode;
+        dst->uid = src->uid;
+        dst->gid = src->gid;
+        dst->link_count = src->link_count;
+        dst->size = src->size;
+        dst->created = src->created;
+        dst->modified = src->modified;
+        dst->accessed = src->accessed;
 
-    printf("Répertoire créé : %s\n", normalized);
-    free(normalized);
-    return 0;
-}
+        dst->name_offset = name_heap_add(&heap, src->filename);
+        if (dst->name_offset == 0) {
+            fprintf(stderr, "Erreur : mémoire insuffisante\n");
+            goto out;
+        }
 
-int fs_add_file(FileSystem *fs, const char *fs_path, const char *source_path) {
-    if (fs->sb.num_files >= fs->sb.max_files) {
-        fprintf(stderr, "Erreur : système de fichiers plein\n");
-        return -1;
+        dst->parent = ROOT_INODE;
+        if (strcmp(src->parent_path, "/") != 0) {
+            UpgradeDir key = { (char *)src->parent_path, 0 };
+            UpgradeDir *parent = bsearch(&key, dirs, ndirs, sizeof(UpgradeDir), upgrade_dir_cmp);
+            if (parent) {
+                dst->parent = parent->index;
+            } else {
+                fprintf(stderr, "Avertissement : parent '%s' introuvable pour '%s', rattaché à la racine\n",
+                        src->parent_path, src->filename);
+            }
+        }
+
+        if (!src->is_directory) {
+            if (src->extent_count == 0 && src->size > 0) {
+                // Ancien inode : une seule plage contigue depuis offset
+                dst->extent_count = 1;
+                dst->extents[0].offset = src->offset;
+                dst->extents[0].length = blocks_for_size(src->size) * BLOCK_SIZE;
+            } else {
+                dst->extent_count = src->extent_count;
+                dst->extent_block = src->extent_block;
+                memcpy(dst->extents, src->extents, sizeof(dst->extents));
+            }
+        }
+        num_files++;
     }
 
-    FILE *src = fopen(source_path, "rb");
-    if (!src) {
-        perror("Impossible d'ouvrir le fichier source");
-        return -1;
+    // Nouvelle table puis tas de noms en fin de donnees. Une marque de fin
+    // absente ou incoherente est remplacee par la taille du conteneur.
+    uint64_t file_end = blocks_for_size(io_size(f)) * BLOCK_SIZE;
+    uint64_t end = sb.data_end;
+    if (end == 0 || end % BLOCK_SIZE != 0 || end > file_end ||
+        end < old_table + old_table_size ||
+        (sb.free_map_offset != 0 && end < sb.free_map_offset + sb.free_map_capacity)) {
+        end = file_end;
     }
 
-    char *normalized = normalize_path(fs_path);
-    char parent_path[MAX_PATH];
-    char filename[MAX_FILENAME];
+    // Blocs de l'ancienne chaine libre, verifies contre les donnees vivantes
+    upgrade_mark_used(&used, old_table, old_table_size);
+    upgrade_collect_used(f, old, old_max, &used);
+    if (upgrade_filter_free_chain(f, sb.first_free_block, sb.data_offset, end, &used, &kept)) {
+        fprintf(stderr, "Avertissement : liste de blocs libres v2 recouverte par des données, "
+                        "%llu octets repris, le reste est écarté\n", (unsigned long long)kept.total);
+    }
 
-    extract_parent_path(normalized, parent_path, MAX_PATH);
-    extract_filename(normalized, filename, MAX_FILENAME);
+    uint64_t table_offset = end;
+    uint64_t heap_offset = table_offset + blocks_for_size((uint64_t)new_max * sizeof(Inode)) * BLOCK_SIZE;
+    uint64_t heap_capacity = blocks_for_size(heap.size + heap.size / 2) * BLOCK_SIZE;
 
-    if (path_exists(fs, normalized, NULL) >= 0) {
-        fprintf(stderr, "Erreur : '%s' existe déjà\n", normalized);
-        fclose(src);
-        free(normalized);
-        return -1;
+    size_t table_bytes = (size_t)new_max * sizeof(Inode);
+    if (io_write(f, table_offset, table, table_bytes) != table_bytes) {
+        fprintf(stderr, "Erreur : écriture de la table d'inodes impossible\n");
+        goto out;
     }
-
-    if (!parent_exists(fs, parent_path)) {
-        fprintf(stderr, "Erreur : le répertoire parent '%s' n'existe pas\n", parent_path);
-        fclose(src);
-        free(normalized);
-        return -1;
+    if (io_write(f, heap_offset, heap.data, heap.size) != heap.size) {
+        fprintf(stderr, "Erreur : écriture du tas de noms impossible\n");
+        goto out;
+    }
+    // La table et le tas doivent etre sur disque avant le SuperBlock qui les designe
+    if (io_sync(f) != 0) {
+        perror("Synchronisation impossible");
+        goto out;
     }
 
-    fseek(src, 0, SEEK_END);
-    uint64_t size = (uint64_t)ftell(src);
-    fseek(src, 0, SEEK_SET);
-
-    uint64_t num_blocks_needed = (size + BLOCK_SIZE - 1) / BLOCK_SIZE;
-    uint64_t offset = 0;
+    // Le SuperBlock n'est reecrit qu'une fois la nouvelle table en place
+    sb.version = FS_VERSION;
+    sb.num_files = num_files;
+    sb.max_files = new_max;
+    sb.inode_table_offset = table_offset;
+    sb.inode_segment_base = new_max;
+    sb.inode_segment_count = 1;
+    sb.name_heap_offset = heap_offset;
+    sb.name_heap_capacity = heap_capacity;
+    sb.name_heap_size = heap.size;
+    sb.data_end = heap_offset + heap_capacity;
+    // La chaine libre filtree est reprise dans la carte apres ouverture
+    sb.first_free_block = 0;
+    // Le journal est cree a la premiere ouverture
+    sb.journal_offset = 0;
+    sb.journal_capacity = 0;
+    sb.journal_sequence = 0;
+    sb.path_index_offset = 0;
+    sb.path_index_capacity = 0;
+    sb.path_index_generation = 0;
 
-    // Chercher dans la free list (First-fit)
-    // Note: Pour simplifier, on cherche un bloc contigu si possible, 
-    // ou on prend juste le premier si le fichier tient dans un bloc.
-    // Si le fichier fait plusieurs blocs, on a besoin de blocs contigus 
-    // car l'inode n'a qu'un seul offset.
-    // Algorithme: Chercher une séquence de blocs libres contigus.
-    
-    if (num_blocks_needed > 0) {
-        // Pour l'instant on ne gère que la réutilisation d'un seul bloc libre 
-        // ou on continue à la fin si on ne trouve pas de séquence contigüe.
-        // C'est une limitation due à la structure de l'Inode (un seul offset).
-        
-        uint64_t current = fs->sb.first_free_block;
-        uint64_t prev = 0;
-        
-        while (current != 0) {
-            // Vérifier si on a assez de blocs contigus à partir de 'current'
-            // Dans cette implémentation simple, on ne réutilise un bloc 
-            // que si le fichier tient dans un seul bloc et que le bloc est libre.
-            if (num_blocks_needed == 1) {
-                offset = current;
-                // Retirer de la liste
-                FreeBlock fb;
-                fseek(fs->container, (long)current, SEEK_SET);
-                fread(&fb, sizeof(FreeBlock), 1, fs->container);
-                
-                if (prev == 0) {
-                    fs->sb.first_free_block = fb.next_free_block;
-                } else {
-                    FreeBlock prev_fb;
-                    fseek(fs->container, (long)prev, SEEK_SET);
-                    fread(&prev_fb, sizeof(FreeBlock), 1, fs->container);
-                    prev_fb.next_free_block = fb.next_free_block;
-                    fseek(fs->container, (long)prev, SEEK_SET);
-                    fwrite(&prev_fb, sizeof(FreeBlock), 1, fs->container);
-                }
-                break;
-            }
-            // Passer au suivant
-            FreeBlock fb;
-            fseek(fs->container, (long)current, SEEK_SET);
-            fread(&fb, sizeof(FreeBlock), 1, fs->container);
-            prev = current;
-            current = fb.next_free_block;
-        }
+    if (io_write(f, 0, &sb, sizeof(SuperBlock)) != sizeof(SuperBlock)) {
+        fprintf(stderr, "Erreur : écriture du superblock impossible\n");
+        goto out;
     }
+    ret = 0;
 
-    if (offset == 0) {
-        offset = find_data_end(fs);
+out:
+    for (uint32_t i = 0; i < ndirs; i++) free(dirs[i].path);
+    free(dirs);
+    free(old);
+    free(table);
+    free(heap.data);
+    freemap_destroy(&used);
+    io_close(f);
+    if (ret != 0) {
+        freemap_destroy(&kept);
+        return ret;
     }
 
-    int idx = find_free_inode(fs);
-    if (idx == -1) {
-        fclose(src);
-        fprintf(stderr, "Erreur : pas d'inode disponible\n");
-        free(normalized);
+    // L'ancienne table et les blocs libres retenus rejoignent l'espace libre
+    FileSystem *fs = fs_open(path);
+    if (!fs) {
+        freemap_destroy(&kept);
         return -1;
     }
+    if (freemap_insert(&fs->free_map, old_table, old_table_size) != 0) {
+        fprintf(stderr, "Avertissement : ancienne table d'inodes déjà libre\n");
+    }
+    for (uint32_t i = 0; i < kept.count; i++) {
+        freemap_insert(&fs->free_map, kept.by_offset[i].offset, kept.by_offset[i].length);
+    }
+    freemap_destroy(&kept);
+    release_data_tail(fs);
+    fs_close(fs);
 
-    Inode *inode = get_inode(fs, idx);
-    strncpy(inode->filename, filename, MAX_FILENAME - 1);
-    inode->filename[MAX_FILENAME - 1] = '\0';
-    strncpy(inode->parent_path, parent_path, MAX_PATH - 1);
-    inode->parent_path[MAX_PATH - 1] = '\0';
-    inode->is_directory = 0;
-    inode->size = size;
-    inode->offset = offset;
-    inode->created = time(NULL);
-    inode->modified = inode->created;
-    inode->accessed = inode->created;
-    inode->uid = getuid();
-    inode->gid = getgid();
-    inode->mode = 0644;
-    inode->link_count = 1;
-    inode->inode_number = idx;
-    mark_inode_dirty(fs, idx);
+    printf("Image convertie au format v%u : %s (%u entrées)\n", FS_VERSION, path, num_files - 1);
+    return 0;
+}
 
-    fseek(fs->container, (long)offset, SEEK_SET);
-    char buffer[BLOCK_SIZE];
-    size_t bytes_read;
-    while ((bytes_read = fread(buffer, 1, BLOCK_SIZE, src)) > 0) {
-        fwrite(buffer, 1, bytes_read, fs->container);
+// Fin du dernier segment de la table d'inodes
+static uint64_t inode_table_end(const SuperBlock *sb) {
+    uint64_t end = 0;
+    for (uint32_t k = 0; k < sb->inode_segment_count; k++) {
+        uint64_t segment_end = inode_segment_offset(sb, k) + inode_segment_entries(sb, k) * sizeof(Inode);
+        if (segment_end > end) end = segment_end;
     }
+    return end;
+}
 
-    fclose(src);
-    fs->sb.num_files++;
+// Fin des zones de metadonnees que designe le SuperBlock
+static uint64_t metadata_end(const SuperBlock *sb) {
+    uint64_t end = sb->data_offset;
+    uint64_t table_end = inode_table_end(sb);
+    if (table_end > end) end = table_end;
 
-    // Ajouter a la hash table pour acces O(1)
-    hash_table_insert(fs, normalized, idx);
+    // La carte d'espace libre
+    uint64_t map_end = sb->free_map_offset + sb->free_map_capacity;
+    if (sb->free_map_offset != 0 && map_end > end) end = map_end;
 
-    printf("Fichier ajouté : %s (%lu octets)\n", normalized, (unsigned long)size);
-    free(normalized);
-    return 0;
+    // Le tas de noms
+    uint64_t names_end = sb->name_heap_offset + sb->name_heap_capacity;
+    if (sb->name_heap_offset != 0 && names_end > end) end = names_end;
+
+    // Le journal
+    uint64_t journal_end = sb->journal_offset + sb->journal_capacity;
+    if (sb->journal_offset != 0 && journal_end > end) end = journal_end;
+
+    // L'index des entrees
+    uint64_t index_end = sb->path_index_offset + sb->path_index_capacity;
+    if (sb->path_index_offset != 0 && index_end > end) end = index_end;
+
+    // Les compteurs de references et l'index des empreintes
+    uint64_t refs_end = sb->ref_map_offset + sb->ref_map_capacity;
+    if (sb->ref_map_offset != 0 && refs_end > end) end = refs_end;
+    uint64_t dedup_end = sb->dedup_index_offset + sb->dedup_index_capacity;
+    if (sb->dedup_index_offset != 0 && dedup_end > end) end = dedup_end;
+    return end;
 }
 
-int fs_extract_file(FileSystem *fs, const char *fs_path, const char *dest_path) {
-    char *normalized = normalize_path(fs_path);
+// Verifie la marque de fin des donnees. Une valeur absente (image plus
+// ancienne) ou incoherente avec les metadonnees ou la taille du conteneur
+// doit etre recalculee depuis la table d'inodes.
+static int data_end_valid(FileSystem *fs) {
+    uint64_t end = fs->sb.data_end;
+    uint64_t file_end = blocks_for_size(io_size(fs->container)) * BLOCK_SIZE;
+    return end != 0 && end % BLOCK_SIZE == 0 && end >= metadata_end(&fs->sb) && end <= file_end;
+}
 
-    int idx = path_exists(fs, normalized, NULL);
-    if (idx == -1) {
-        fprintf(stderr, "Erreur : fichier '%s' introuvable\n", normalized);
-        free(normalized);
-        return -1;
+// Fin des donnees des inodes, par un parcours complet de la table
+static uint64_t inodes_data_end(FileSystem *fs) {
+    uint64_t end = 0;
+    InodeScan scan;
+    const Inode *inode;
+    uint32_t i;
+    inode_scan_open(fs, &scan);
+    while ((inode = inode_scan_next(&scan, &i)) != NULL) {
+        uint64_t e = inode_data_end(fs, inode);
+        if (e > end) end = e;
     }
+    inode_scan_close(&scan);
+    return end;
+}
 
-    Inode *inode = get_inode(fs, idx);
-    if (!inode || inode->is_directory) {
-        fprintf(stderr, "Erreur : '%s' est un répertoire, pas un fichier\n", normalized);
-        free(normalized);
-        return -1;
+// Remplace une marque de fin invalide, a partir de la fin des donnees des
+// inodes et des zones de metadonnees
+static void rebuild_data_end(FileSystem *fs, uint64_t inodes_end) {
+    if (fs->sb.data_end != 0) {
+        fprintf(stderr, "Avertissement : fin des données incohérente, reconstruction\n");
     }
-    
-    inode->accessed = time(NULL);
-    mark_inode_dirty(fs, idx);
+    uint64_t end = metadata_end(&fs->sb);
+    if (inodes_end > end) end = inodes_end;
+    // Aligner la fin sur 4096 octets pour le prochain fichier
+    fs->sb.data_end = (end + 4095) & ~4095ULL;
+}
 
-    FILE *dest = fopen(dest_path, "wb");
-    if (!dest) {
-        perror("Impossible de créer le fichier de destination");
-        free(normalized);
-        return -1;
+// Reserve length octets en fin de donnees et avance la marque de fin
+static uint64_t alloc_at_end(FileSystem *fs, uint64_t length) {
+    uint64_t offset = fs->sb.data_end;
+    fs->sb.data_end += blocks_for_size(length) * BLOCK_SIZE;
+    return offset;
+}
+
+// Rend a la fin des donnees la plage libre qui la touche, pour que les
+// prochains ajouts en queue la reprennent d'un seul tenant
+static void release_data_tail(FileSystem *fs) {
+    const FreeRun *last = freemap_last(&fs->free_map);
+    if (last && last->offset + last->length == fs->sb.data_end) {
+        uint64_t offset = last->offset;
+        freemap_take(&fs->free_map, offset, last->length);
+        fs->sb.data_end = offset;
     }
+}
 
-    fseek(fs->container, (long)inode->offset, SEEK_SET);
-    char buffer[BLOCK_SIZE];
-    uint64_t remaining = inode->size;
+// Rend a l'hote les blocs d'une zone liberee : seules les parties encore
+// libres (ou au-dela de la fin des donnees) sont percees, une allocation ayant
+// pu reprendre le reste. Retourne les octets rendus.
+static uint64_t punch_free_range(FileSystem *fs, uint64_t offset, uint64_t length) {
+    uint64_t end = offset + length;
+    uint64_t punched = 0;
 
-    while (remaining > 0) {
-        size_t to_read = (remaining < BLOCK_SIZE) ? (size_t)remaining : BLOCK_SIZE;
-        size_t bytes_read = fread(buffer, 1, to_read, fs->container);
-        fwrite(buffer, 1, bytes_read, dest);
-        remaining -= bytes_read;
+    if (end > fs->sb.data_end) {
+        uint64_t start = offset > fs->sb.data_end ? offset : fs->sb.data_end;
+        if (io_punch(fs->container, start, end - start) != 0) return 0;
+        punched += end - start;
+        end = start;
     }
 
-    fclose(dest);
-    printf("Fichier extrait : %s -> %s\n", normalized, dest_path);
-    free(normalized);
-    return 0;
+    const FreeMap *fm = &fs->free_map;
+    for (const FreeRun *run = freemap_next(fm, offset);
+         run && run < fm->by_offset + fm->count && run->offset < end; run++) {
+        uint64_t start = run->offset > offset ? run->offset : offset;
+        uint64_t stop = run->offset + run->length < end ? run->offset + run->length : end;
+        if (io_punch(fs->container, start, stop - start) != 0) break;
+        punched += stop - start;
+    }
+    return punched;
 }
 
-int fs_copy_file(FileSystem *fs, const char *src_path, const char *dest_path) {
-    if (fs->sb.num_files >= fs->sb.max_files) {
-        fprintf(stderr, "Erreur : système de fichiers plein\n");
-        return -1;
+// Rend une zone qui n'est plus utilisee. Elle n'est reutilisable qu'apres la
+// prochaine transaction : jusque-la, l'etat valide sur disque peut encore la
+// designer.
+static void space_release_unshared(void *ctx, uint64_t offset, uint64_t length) {
+    FileSystem *fs = ctx;
+    if (freemap_insert(&fs->journal.pending_free, offset, length) != 0) {
+        fprintf(stderr, "Avertissement : plage %llu+%llu déjà libre, ignorée\n",
+                (unsigned long long)offset, (unsigned long long)length);
     }
+    // Un bloc libere ne doit plus etre propose au partage
+    dedup_forget(&fs->dedup, offset, length);
+}
 
-    char *normalized_src = normalize_path(src_path);
-    char *normalized_dest = normalize_path(dest_path);
-
-    // Utiliser hash table pour recherche rapide
-    int src_idx = hash_table_lookup(fs, normalized_src);
-
-    if (src_idx == -1) {
-        fprintf(stderr, "Erreur : fichier source '%s' introuvable\n", normalized_src);
-        free(normalized_src);
-        free(normalized_dest);
-        return -1;
+static void space_release(FileSystem *fs, uint64_t offset, uint64_t length) {
+    if (length == 0) return;
+    // Donnees partagees : seule la derniere reference libere la zone
+    if (refmap_shared(&fs->ref_map, offset, length) == 0) {
+        space_release_unshared(fs, offset, length);
+        return;
+    }
+    if (refmap_drop(&fs->ref_map, offset, length, space_release_unshared, fs) != 0) {
+        fprintf(stderr, "Avertissement : plage partagée %llu+%llu conservée (mémoire insuffisante)\n",
+                (unsigned long long)offset, (unsigned long long)length);
+        return;
+    }
+    fs->ref_map_changed = 1;
+}
+
+// Remet a zero une zone neuve. Au-dela de la fin du conteneur, l'agrandir
+// suffit : le trou se lit comme des zeros. En deca, la zone est percee si
+// l'hote le permet, et sinon reecrite.
+static int zero_fill(FileSystem *fs, uint64_t offset, uint64_t length) {
+    if (offset >= io_size(fs->container)) return io_extend(fs->container, offset + length);
+    if (io_punch(fs->container, offset, length) == 0) return io_extend(fs->container, offset + length);
+
+    size_t chunk = 64 * 1024;
+    char *zeros = calloc(1, chunk);
+    if (!zeros) return -1;
+    for (uint64_t done = 0; done < length; done += chunk) {
+        size_t n = length - done < chunk ? (size_t)(length - done) : chunk;
+        if (io_write(fs->container, offset + done, zeros, n) != n) {
+            free(zeros);
+            return -1;
+        }
+    }
+    free(zeros);
+    return 0;
+}
+
+// Retourne un inode libre sans le reserver : l'appelant le marque occupe
+// une fois l'inode rempli
+static int find_free_inode(FileSystem *fs) {
+    int idx = inode_bitmap_find(fs);
+    if (idx >= 0) return idx;
+
+    // Plus d'inode libre : un nouveau segment aussi grand que la table la
+    // double, sans deplacer ni recopier les inodes existants
+    uint32_t k = fs->sb.inode_segment_count;
+    uint32_t old_max = fs->sb.max_files;
+    if (k >= INODE_SEGMENTS || old_max > UINT32_MAX / 2) {
+        fprintf(stderr, "Erreur : table d'inodes pleine\n");
+        return -1;
+    }
+    uint32_t new_max = old_max * 2;
+
+    uint64_t capacity = blocks_for_size((uint64_t)old_max * sizeof(Inode)) * BLOCK_SIZE;
+    uint64_t offset;
+    if (freemap_alloc_best_fit(&fs->free_map, capacity, &offset) != 0) {
+        offset = alloc_at_end(fs, capacity);
+    }
+    // Le bitmap en dernier : ses nouvelles entrees libres ne doivent pas
+    // survivre a un echec
+    if (zero_fill(fs, offset, capacity) != 0 || dir_index_resize(fs, new_max) != 0 ||
+        inode_bitmap_resize(fs, old_max, new_max) != 0) {
+        fprintf(stderr, "Erreur : extension de la table d'inodes impossible\n");
+        freemap_insert(&fs->free_map, offset, capacity);
+        release_data_tail(fs);
+        return -1;
+    }
+
+    fs->sb.inode_segments[k - 1] = offset;
+    fs->sb.inode_segment_count = k + 1;
+    fs->sb.max_files = new_max;
+
+    printf("Table d'inodes étendue : %u -> %u entrées (segment %u, offset %llu)\n",
+           old_max, new_max, k, (unsigned long long)offset);
+
+    return (int)old_max; // Le premier nouvel inode libre
+}
+
+
+// --- Allocation des blocs de donnees ---
+
+// Rend les extents d'une liste, a la prochaine transaction
+static void free_extent_list(FileSystem *fs, const ExtentList *list) {
+    for (uint32_t i = 0; i < list->count; i++) {
+        space_release(fs, list->items[i].offset, list->items[i].length);
+    }
+}
+
+// Alloue nblocks blocs. Une plage libre assez grande est choisie en best-fit
+// pour garder le fichier contigu ; a defaut, les plus grandes plages sont
+// prises en premier pour limiter le nombre d'extents, et le reste vient de la
+// fin des donnees.
+static int alloc_blocks(FileSystem *fs, uint64_t nblocks, ExtentList *list) {
+    uint64_t want = nblocks * BLOCK_SIZE;
+    uint64_t offset;
+
+    if (want == 0) return 0;
+
+    if (freemap_alloc_best_fit(&fs->free_map, want, &offset) == 0) {
+        if (extent_list_push(list, offset, want) != 0) {
+            freemap_insert(&fs->free_map, offset, want);
+            return -1;
+        }
+        return 0;
+    }
+
+    const FreeRun *run;
+    while (want > 0 && (run = freemap_largest(&fs->free_map)) != NULL) {
+        uint64_t length = run->length < want ? run->length : want;
+        offset = run->offset;
+        if (freemap_take(&fs->free_map, offset, length) != 0) break;
+        if (extent_list_push(list, offset, length) != 0) {
+            freemap_insert(&fs->free_map, offset, length);
+            return -1;
+        }
+        want -= length;
+    }
+
+    if (want > 0) {
+        offset = alloc_at_end(fs, want);
+        if (extent_list_push(list, offset, want) != 0) {
+            freemap_insert(&fs->free_map, offset, want);
+            release_data_tail(fs);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// --- Carte d'espace libre ---
+
+// Charge l'espace libre : carte compacte si elle existe, sinon ancienne free
+// list chainee (parcourue une seule fois, puis abandonnee). Une carte
+// corrompue est ignoree : l'espace qu'elle decrivait est perdu, pas reutilise.
+static void free_map_load(FileSystem *fs) {
+    freemap_init(&fs->free_map);
+
+    if (fs->sb.free_map_offset != 0) {
+        FreeMapHeader header;
+        if (io_read(fs->container, fs->sb.free_map_offset, &header, sizeof(header)) != sizeof(header) ||
+            header.magic != FREE_MAP_MAGIC ||
+            sizeof(header) + header.count * sizeof(FreeRun) > fs->sb.free_map_capacity) {
+            fprintf(stderr, "Avertissement : carte d'espace libre corrompue, ignorée\n");
+            return;
+        }
+        size_t bytes = (size_t)header.count * sizeof(FreeRun);
+        FreeRun *runs = malloc(bytes > 0 ? bytes : 1);
+        int ok = runs &&
+                 io_read(fs->container, fs->sb.free_map_offset + sizeof(header), runs, bytes) == bytes;
+        for (uint64_t i = 0; ok && i < header.count; i++) {
+            if (freemap_insert(&fs->free_map, runs[i].offset, runs[i].length) != 0) ok = 0;
+        }
+        free(runs);
+        if (!ok) {
+            fprintf(stderr, "Avertissement : carte d'espace libre corrompue, ignorée\n");
+            freemap_destroy(&fs->free_map);
+        }
+        return;
+    }
+
+    uint64_t block = fs->sb.first_free_block;
+    while (block != 0) {
+        FreeBlock fb;
+        if (io_read(fs->container, block, &fb, sizeof(FreeBlock)) != sizeof(FreeBlock)) break;
+        // Un bloc deja present signale une boucle dans la chaine
+        if (freemap_insert(&fs->free_map, block, BLOCK_SIZE) != 0) break;
+        block = fb.next_free_block;
+    }
+    fs->sb.first_free_block = 0;
+}
+
+// Ecrit la carte d'espace libre dans sa zone, en la deplacant si elle a
+// grandi au-dela de la capacite reservee
+static void free_map_save(FileSystem *fs) {
+    FreeMap *fm = &fs->free_map;
+
+    if (fm->count == 0 && fs->sb.free_map_offset == 0) return;
+
+    uint64_t needed = sizeof(FreeMapHeader) + (uint64_t)fm->count * sizeof(FreeRun);
+    if (needed > fs->sb.free_map_capacity) {
+        if (fs->sb.free_map_offset != 0) {
+            freemap_insert(fm, fs->sb.free_map_offset, fs->sb.free_map_capacity);
+            fs->sb.free_map_offset = 0;
+            fs->sb.free_map_capacity = 0;
+            release_data_tail(fs);
+        }
+
+        // Marge de moitie pour ne pas deplacer la zone a chaque fermeture
+        needed = sizeof(FreeMapHeader) + (uint64_t)(fm->count + 1) * sizeof(FreeRun);
+        uint64_t capacity = blocks_for_size(needed + needed / 2) * BLOCK_SIZE;
+        uint64_t offset;
+        if (freemap_alloc_best_fit(fm, capacity, &offset) != 0) {
+            offset = alloc_at_end(fs, capacity);
+        }
+        fs->sb.free_map_offset = offset;
+        fs->sb.free_map_capacity = capacity;
+    }
+
+    FreeMapHeader header = {0};
+    header.magic = FREE_MAP_MAGIC;
+    header.count = fm->count;
+    // La zone peut etre celle que designe l'etat valide : reecriture en place
+    if (journal_record(fs, fs->sb.free_map_offset, &header, sizeof(header)) != 0 ||
+        journal_record(fs, fs->sb.free_map_offset + sizeof(header), fm->by_offset,
+                       (size_t)fm->count * sizeof(FreeRun)) != 0) {
+        fprintf(stderr, "Erreur : écriture de la carte d'espace libre impossible\n");
+    }
+}
+
+// --- Compteurs de references des donnees partagees ---
+
+static int ref_point_compare(const void *a, const void *b) {
+    const Extent *x = a;
+    const Extent *y = b;
+    return x->offset < y->offset ? -1 : x->offset > y->offset;
+}
+
+// Recompte les references depuis les extents de tous les inodes : chaque
+// debut d'extent ajoute une reference, chaque fin en retire une, et les
+// zones couvertes plusieurs fois sont partagees
+static void ref_map_rebuild(FileSystem *fs) {
+    // Points (offset, +1 ou -1), le signe range dans length
+    ExtentList points = {0};
+    InodeScan scan;
+    uint32_t index;
+    const Inode *inode;
+    inode_scan_open(fs, &scan);
+    while ((inode = inode_scan_next(&scan, &index)) != NULL) {
+        if (inode->type == INODE_FREE || inode->extent_count == 0) continue;
+        ExtentList list;
+        if (inode_load_extents(fs, inode, &list) != 0) continue;
+        for (uint32_t e = 0; e < list.count; e++) {
+            // extent_list_push fusionnerait deux points contigus
+            if (points.count + 2 > points.capacity) {
+                uint32_t capacity = points.capacity ? points.capacity * 2 : 1024;
+                Extent *items = realloc(points.items, capacity * sizeof(Extent));
+                if (!items) break;
+                points.items = items;
+                points.capacity = capacity;
+            }
+            points.items[points.count++] = (Extent){ list.items[e].offset, 1 };
+            points.items[points.count++] = (Extent){ list.items[e].offset + list.items[e].length, (uint64_t)-1 };
+        }
+        extent_list_free(&list);
+    }
+    inode_scan_close(&scan);
+
+    qsort(points.items, points.count, sizeof(Extent), ref_point_compare);
+    uint64_t depth = 0;
+    for (uint32_t i = 0; i < points.count;) {
+        uint64_t at = points.items[i].offset;
+        while (i < points.count && points.items[i].offset == at) depth += points.items[i++].length;
+        if (i < points.count && depth > 1) {
+            uint64_t next = points.items[i].offset;
+            const RefRun *last = fs->ref_map.count ? &fs->ref_map.runs[fs->ref_map.count - 1] : NULL;
+            if (last && last->refs == depth - 1 && last->offset + last->length == at) {
+                fs->ref_map.runs[fs->ref_map.count - 1].length += next - at;
+            } else {
+                refmap_append(&fs->ref_map, at, next - at, depth - 1);
+            }
+        }
+    }
+    extent_list_free(&points);
+    fs->ref_map_changed = 1;
+}
+
+// Charge les compteurs de references. Des compteurs illisibles sont
+// recalcules depuis les inodes : les ignorer ferait liberer des blocs encore
+// references ailleurs.
+static void ref_map_load(FileSystem *fs) {
+    refmap_init(&fs->ref_map);
+    fs->ref_map_changed = 0;
+    if (fs->sb.ref_map_offset == 0) return;
+
+    RefMapHeader header;
+    int ok = io_read(fs->container, fs->sb.ref_map_offset, &header, sizeof(header)) == sizeof(header) &&
+             header.magic == REF_MAP_MAGIC &&
+             sizeof(header) + header.count * sizeof(RefRun) <= fs->sb.ref_map_capacity;
+    size_t bytes = ok ? (size_t)header.count * sizeof(RefRun) : 0;
+    RefRun *runs = ok ? malloc(bytes > 0 ? bytes : 1) : NULL;
+    ok = runs && io_read(fs->container, fs->sb.ref_map_offset + sizeof(header), runs, bytes) == bytes;
+    for (uint64_t i = 0; ok && i < header.count; i++) {
+        if (refmap_append(&fs->ref_map, runs[i].offset, runs[i].length, runs[i].refs) != 0) ok = 0;
+    }
+    free(runs);
+    if (!ok) {
+        fprintf(stderr, "Avertissement : compteurs de références corrompus, recomptage\n");
+        refmap_destroy(&fs->ref_map);
+        ref_map_rebuild(fs);
+    }
+}
+
+// Ecrit les compteurs s'ils ont change, en deplacant leur zone si elle est
+// devenue trop petite
+static void ref_map_save(FileSystem *fs) {
+    if (!fs->ref_map_changed) return;
+    fs->ref_map_changed = 0;
+
+    RefMap *rm = &fs->ref_map;
+    uint64_t needed = sizeof(RefMapHeader) + (uint64_t)rm->count * sizeof(RefRun);
+    if (needed > fs->sb.ref_map_capacity) {
+        if (fs->sb.ref_map_offset != 0) space_release(fs, fs->sb.ref_map_offset, fs->sb.ref_map_capacity);
+        // Marge de moitie, comme pour la carte d'espace libre
+        uint64_t capacity = blocks_for_size(needed + needed / 2) * BLOCK_SIZE;
+        uint64_t offset;
+        if (freemap_alloc_best_fit(&fs->free_map, capacity, &offset) != 0) {
+            offset = alloc_at_end(fs, capacity);
+        }
+        fs->sb.ref_map_offset = offset;
+        fs->sb.ref_map_capacity = capacity;
+    }
+
+    RefMapHeader header = { REF_MAP_MAGIC, 0, rm->count };
+    if (journal_record(fs, fs->sb.ref_map_offset, &header, sizeof(header)) != 0 ||
+        journal_record(fs, fs->sb.ref_map_offset + sizeof(header), rm->runs,
+                       (size_t)rm->count * sizeof(RefRun)) != 0) {
+        fprintf(stderr, "Erreur : écriture des compteurs de références impossible\n");
+    }
+}
+
+// --- Persistance du tas de noms ---
+
+// Reconstruit le tas avec les seuls noms vivants. Tous les inodes changent de
+// name_offset : la table est recopiee d'un seul segment dans une nouvelle
+// zone plutot que reecrite en place, et l'ancienne table comme l'ancien tas ne sont rendus
+// qu'avec la transaction qui designe les nouveaux. Appele a la fermeture
+// seulement.
+static void name_heap_compact(FileSystem *fs) {
+    uint64_t table_bytes = (uint64_t)fs->sb.max_files * sizeof(Inode);
+    Inode *table = malloc((size_t)table_bytes);
+    NameHeap fresh;
+    memset(&fresh, 0, sizeof(fresh));
+    if (!table || name_heap_reserve(&fresh, fs->names.size - fs->names.garbage) != 0) {
+        free(table);
+        return;
+    }
+    fresh.data[0] = '\0';
+    fresh.size = 1;
+
+    InodeScan scan;
+    const Inode *inode;
+    uint32_t i;
+    inode_scan_open(fs, &scan);
+    while ((inode = inode_scan_next(&scan, &i)) != NULL) {
+        table[i] = *inode;
+        if (inode->type == INODE_FREE || i == ROOT_INODE || inode_is_shared(inode)) continue;
+        uint64_t offset = name_heap_add(&fresh, fs_inode_name(fs, inode));
+        if (offset == 0) break;
+        table[i].name_offset = offset;
+    }
+    inode_scan_close(&scan);
+    if (inode || scan.failed) {
+        free(table);
+        free(fresh.data);
+        return;
+    }
+
+    uint64_t table_offset = alloc_at_end(fs, table_bytes);
+    if (io_write(fs->container, table_offset, table, (size_t)table_bytes) != table_bytes) {
+        fprintf(stderr, "Erreur : écriture de la table d'inodes impossible\n");
+        space_release(fs, table_offset, blocks_for_size(table_bytes) * BLOCK_SIZE);
+        free(table);
+        free(fresh.data);
+        return;
+    }
+
+    // Les copies en cache suivent la nouvelle table, et l'index des entrees
+    // aussi : seul l'offset du nom change, pas son hash
+    for (int i = 0; i < fs->cache_count; i++) {
+        CacheNode *node = &fs->cache_pool[i];
+        node->inode.name_offset = table[node->inode_index].name_offset;
+    }
+    for (uint32_t slot = 0; slot < fs->hash_capacity; slot++) {
+        HashEntry *entry = &fs->hash_table[slot];
+        if (entry->inode_index != -1) entry->name_offset = table[entry->inode_index].name_offset;
+    }
+    fs->path_index_changed = 1;
+    free(table);
+    for (uint32_t k = 0; k < fs->sb.inode_segment_count; k++) {
+        uint64_t bytes = inode_segment_entries(&fs->sb, k) * sizeof(Inode);
+        space_release(fs, inode_segment_offset(&fs->sb, k), blocks_for_size(bytes) * BLOCK_SIZE);
+    }
+    fs->sb.inode_table_offset = table_offset;
+    fs->sb.inode_segment_base = fs->sb.max_files;
+    fs->sb.inode_segment_count = 1;
+
+    free(fs->names.data);
+    fs->names = fresh;
+
+    if (fs->sb.name_heap_offset != 0) {
+        space_release(fs, fs->sb.name_heap_offset, fs->sb.name_heap_capacity);
+        fs->sb.name_heap_offset = 0;
+        fs->sb.name_heap_capacity = 0;
+    }
+}
+
+// Ecrit les noms ajoutes depuis la derniere sauvegarde. La zone est deplacee
+// (et le tas reecrit en entier) quand elle devient trop petite. Les noms
+// ajoutes sont au-dela de la taille validee : ils sont ecrits directement.
+static void name_heap_save(FileSystem *fs, int compact) {
+    NameHeap *heap = &fs->names;
+
+    if (compact && heap->garbage > BLOCK_SIZE && heap->garbage > heap->size / 2) {
+        name_heap_compact(fs);
+    }
+    if (heap->flushed == heap->size && fs->sb.name_heap_offset != 0) return;
+
+    if (heap->size > fs->sb.name_heap_capacity) {
+        if (fs->sb.name_heap_offset != 0) {
+            space_release(fs, fs->sb.name_heap_offset, fs->sb.name_heap_capacity);
+        }
+
+        uint64_t capacity = blocks_for_size(heap->size + heap->size / 2) * BLOCK_SIZE;
+        uint64_t offset;
+        if (freemap_alloc_best_fit(&fs->free_map, capacity, &offset) != 0) {
+            offset = alloc_at_end(fs, capacity);
+        }
+        fs->sb.name_heap_offset = offset;
+        fs->sb.name_heap_capacity = capacity;
+        heap->flushed = 0;
+    }
+
+    if (io_write(fs->container, fs->sb.name_heap_offset + heap->flushed, heap->data + heap->flushed,
+                 heap->size - heap->flushed) != heap->size - heap->flushed) {
+        fprintf(stderr, "Erreur : écriture du tas de noms impossible\n");
+        return;
+    }
+    heap->flushed = heap->size;
+    fs->sb.name_heap_size = heap->size;
+}
+
+// --- Journal des metadonnees ---
+//
+// Une transaction regroupe les reecritures en place de nombreuses operations
+// (inodes, carte d'espace libre, index de repertoires, SuperBlock en dernier).
+// Elle est ecrite d'un seul tenant dans la zone du journal et synchronisee
+// une fois, puis recopiee a sa place sans attendre : la synchronisation de la
+// transaction suivante rend cette recopie durable. Les zones neuves (donnees,
+// noms ajoutes, index deplaces) sont ecrites directement, avant la
+// transaction qui les designe.
+
+#define JOURNAL_CHECKSUM_SEED 14695981039346656037ULL
+
+// FNV-1a 64 bits, continue a partir de hash
+static uint64_t journal_checksum(uint64_t hash, const void *data, size_t len) {
+    const uint8_t *p = data;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static uint32_t journal_slot_hash(uint64_t offset) {
+    return (uint32_t)(((offset >> 7) * 0x9E3779B97F4A7C15ULL) >> 32);
+}
+
+// Position (plus 1) de l'enregistrement de len octets a offset, 0 si la
+// transaction en construction n'en contient pas
+static size_t journal_find(const Journal *j, uint64_t offset, size_t len) {
+    if (j->slot_count == 0) return 0;
+    for (uint32_t s = journal_slot_hash(offset) & j->slot_mask; j->slots[s].pos != 0;
+         s = (s + 1) & j->slot_mask) {
+        if (j->slots[s].offset == offset) {
+            JournalRecord record;
+            memcpy(&record, j->buf + j->slots[s].pos - 1, sizeof(record));
+            return record.length == len ? j->slots[s].pos : 0;
+        }
+    }
+    return 0;
+}
+
+// Indexe l'enregistrement ajoute a pos. L'index est double a moitie plein.
+static int journal_index(Journal *j, uint64_t offset, size_t pos) {
+    if ((j->slot_count + 1) * 2 > j->slot_mask + 1 || !j->slots) {
+        uint32_t capacity = j->slots ? (j->slot_mask + 1) * 2 : 1024;
+        JournalSlot *slots = calloc(capacity, sizeof(JournalSlot));
+        if (!slots) {
+            // Index plein aux 7/8 sans pouvoir grandir : pas de fusion
+            if (!j->slots || (j->slot_count + 1) * 8 > (j->slot_mask + 1) * 7) return -1;
+        } else {
+            for (uint32_t i = 0; j->slots && i <= j->slot_mask; i++) {
+                if (j->slots[i].pos == 0) continue;
+                uint32_t s = journal_slot_hash(j->slots[i].offset) & (capacity - 1);
+                while (slots[s].pos != 0) s = (s + 1) & (capacity - 1);
+                slots[s] = j->slots[i];
+            }
+            free(j->slots);
+            j->slots = slots;
+            j->slot_mask = capacity - 1;
+        }
+    }
+
+    uint32_t s = journal_slot_hash(offset) & j->slot_mask;
+    while (j->slots[s].pos != 0 && j->slots[s].offset != offset) s = (s + 1) & j->slot_mask;
+    if (j->slots[s].pos == 0) j->slot_count++;
+    j->slots[s].offset = offset;
+    j->slots[s].pos = pos + 1;
+    return 0;
+}
+
+// Ajoute une reecriture en place a la transaction en construction ; une
+// zone deja reecrite dans la transaction est simplement mise a jour. Sans
+// journal, l'ecriture est faite directement.
+static int journal_record(FileSystem *fs, uint64_t offset, const void *data, size_t len) {
+    // Zone vide (data peut alors etre NULL) : rien a enregistrer
+    if (len == 0) return 0;
+    Journal *j = &fs->journal;
+    int journaled = fs->sb.journal_offset != 0;
+    size_t pos = journaled ? journal_find(j, offset, len) : 0;
+    if (pos != 0) {
+        memcpy(j->buf + pos - 1 + sizeof(JournalRecord), data, len);
+        return 0;
+    }
+
+    size_t needed = j->len + sizeof(JournalRecord) + len;
+    if (journaled && needed > j->capacity) {
+        size_t capacity = j->capacity ? j->capacity : 64 * 1024;
+        while (capacity < needed) capacity *= 2;
+        uint8_t *buf = realloc(j->buf, capacity);
+        if (buf) {
+            j->buf = buf;
+            j->capacity = capacity;
+        }
+    }
+    if (!journaled || needed > j->capacity || journal_index(j, offset, j->len) != 0) {
+        // Memoire insuffisante : ecriture directe plutot que perdue
+        return io_write(fs->container, offset, data, len) == len ? 0 : -1;
+    }
+
+    JournalRecord record = { offset, len };
+    memcpy(j->buf + j->len, &record, sizeof(record));
+    memcpy(j->buf + j->len + sizeof(record), data, len);
+    j->len = needed;
+    j->records++;
+    return 0;
+}
+
+// Version, dans la transaction en construction, d'une zone ecrite en place
+// d'un seul enregistrement (inode) : -1 si la transaction ne la contient pas
+static int journal_lookup(FileSystem *fs, uint64_t offset, void *out, size_t len) {
+    size_t pos = journal_find(&fs->journal, offset, len);
+    if (pos == 0) return -1;
+    memcpy(out, fs->journal.buf + pos - 1 + sizeof(JournalRecord), len);
+    return 0;
+}
+
+// Recopie les enregistrements d'une transaction a leur place
+static void journal_apply(FileSystem *fs, const uint8_t *buf, uint64_t len) {
+    uint64_t pos = 0;
+    while (pos + sizeof(JournalRecord) <= len) {
+        JournalRecord record;
+        memcpy(&record, buf + pos, sizeof(record));
+        pos += sizeof(record);
+        if (record.length > len - pos) break;
+        io_write(fs->container, record.offset, buf + pos, (size_t)record.length);
+        pos += record.length;
+    }
+}
+
+typedef struct {
+    uint64_t offset;
+    uint64_t length;
+    size_t pos;                // Donnees dans le tampon de la transaction
+} JournalSpan;
+
+static int journal_span_cmp(const void *a, const void *b) {
+    const JournalSpan *x = a, *y = b;
+    if (x->offset != y->offset) return x->offset < y->offset ? -1 : 1;
+    return x->pos < y->pos ? -1 : x->pos > y->pos;
+}
+
+#define JOURNAL_IOV_MAX 64
+
+// Recopie la transaction validee a sa place en un seul passage : les
+// enregistrements sont tries par offset et les zones contigues ecrites
+// ensemble. Des enregistrements qui se chevauchent gardent leur ordre.
+static void journal_checkpoint(FileSystem *fs) {
+    Journal *j = &fs->journal;
+    JournalSpan *spans = malloc((j->records ? j->records : 1) * sizeof(JournalSpan));
+    if (!spans) {
+        journal_apply(fs, j->buf, j->len);
+        return;
+    }
+
+    uint32_t count = 0;
+    size_t pos = 0;
+    while (pos + sizeof(JournalRecord) <= j->len && count < j->records) {
+        JournalRecord record;
+        memcpy(&record, j->buf + pos, sizeof(record));
+        spans[count].offset = record.offset;
+        spans[count].length = record.length;
+        spans[count].pos = pos + sizeof(record);
+        count++;
+        pos += sizeof(record) + (size_t)record.length;
+    }
+    qsort(spans, count, sizeof(JournalSpan), journal_span_cmp);
+    for (uint32_t i = 1; i < count; i++) {
+        if (spans[i].offset < spans[i - 1].offset + spans[i - 1].length) {
+            free(spans);
+            journal_apply(fs, j->buf, j->len);
+            return;
+        }
+    }
+
+    // Le SuperBlock (offset 0) est ecrit en dernier : tant qu'il n'est pas
+    // en place, la transaction sera rejouee
+    uint32_t first = count > 0 && spans[0].offset == 0 ? 1 : 0;
+    struct iovec iov[JOURNAL_IOV_MAX];
+    for (uint32_t i = first; i < count;) {
+        uint64_t offset = spans[i].offset;
+        uint64_t end = offset;
+        int n = 0;
+        while (i < count && n < JOURNAL_IOV_MAX && spans[i].offset == end) {
+            iov[n].iov_base = j->buf + spans[i].pos;
+            iov[n].iov_len = (size_t)spans[i].length;
+            end += spans[i].length;
+            n++;
+            i++;
+        }
+        io_writev(fs->container, offset, iov, n);
+    }
+    if (first) {
+        io_write(fs->container, 0, j->buf + spans[0].pos, (size_t)spans[0].length);
+    }
+    free(spans);
+}
+
+// Rejoue la derniere transaction valide si sa recopie n'est pas certaine.
+// Les transactions se suivent depuis le debut de la zone avec des numeros
+// consecutifs ; chacune n'est ecrite qu'une fois la precedente recopiee, si
+// bien que seule la derniere peut manquer a sa place.
+static int journal_replay(FileSystem *fs) {
+    SuperBlock *sb = &fs->sb;
+    if (sb->journal_offset == 0) return 0;
+
+    JournalHeader last = {0};
+    uint8_t *last_buf = NULL;
+    int found = 0;
+    uint64_t pos = 0;
+    while (pos + sizeof(JournalHeader) <= sb->journal_capacity) {
+        JournalHeader header;
+        if (io_read(fs->container, sb->journal_offset + pos, &header, sizeof(header)) != sizeof(header) ||
+            header.magic != JOURNAL_MAGIC ||
+            header.length > sb->journal_capacity - pos - sizeof(header) ||
+            (found && header.sequence != last.sequence + 1)) {
+            break;
+        }
+        uint8_t *buf = malloc(header.length ? (size_t)header.length : 1);
+        if (!buf) break;
+        if (io_read(fs->container, sb->journal_offset + pos + sizeof(header), buf,
+                    (size_t)header.length) != header.length) {
+            free(buf);
+            break;
+        }
+        uint64_t checksum = header.checksum;
+        header.checksum = 0;
+        uint64_t hash = journal_checksum(JOURNAL_CHECKSUM_SEED, &header, sizeof(header));
+        header.checksum = checksum;
+        if (journal_checksum(hash, buf, (size_t)header.length) != checksum) {
+            free(buf);
+            break;
+        }
+        free(last_buf);
+        last_buf = buf;
+        last = header;
+        found = 1;
+        pos += blocks_for_size(sizeof(header) + header.length) * BLOCK_SIZE;
+    }
+
+    if (!found || last.sequence < sb->journal_sequence) {
+        free(last_buf);
+        return 0;
+    }
+
+    journal_apply(fs, last_buf, last.length);
+    free(last_buf);
+    if (io_sync(fs->container) != 0 ||
+        io_read(fs->container, 0, sb, sizeof(SuperBlock)) != sizeof(SuperBlock) ||
+        sb->magic != FS_MAGIC) {
+        return -1;
+    }
+    fprintf(stderr, "Journal : transaction %llu rejouée\n", (unsigned long long)last.sequence);
+    return 0;
+}
+
+// Reserve la zone du journal d'une image qui n'en a pas encore
+static int journal_create(FileSystem *fs) {
+    fs->sb.journal_offset = alloc_at_end(fs, JOURNAL_SIZE);
+    fs->sb.journal_capacity = JOURNAL_SIZE;
+    fs->sb.journal_sequence = 1;
+    if (io_extend(fs->container, fs->sb.data_end) != 0 ||
+        io_write(fs->container, 0, &fs->sb, sizeof(SuperBlock)) != sizeof(SuperBlock) ||
+        io_sync(fs->container) != 0) {
+        return -1;
+    }
+    fs->journal.committed = fs->sb;
+    return 0;
+}
+
+// Deplace le journal dans une zone assez grande pour size octets. La
+// derniere transaction est d'abord rendue durable a sa place (elle ne
+// pourra plus etre rejouee), puis le SuperBlock valide est reecrit pour
+// designer la nouvelle zone, placee apres tout ce qu'il designe.
+static int journal_relocate(FileSystem *fs, uint64_t size) {
+    Journal *j = &fs->journal;
+    uint64_t capacity = JOURNAL_SIZE;
+    while (capacity < 2 * size) capacity *= 2;
+
+    uint64_t offset = fs->sb.data_end;
+    if (j->committed.data_end > offset) {
+        offset = j->committed.data_end;
+        if (freemap_insert(&fs->free_map, fs->sb.data_end, offset - fs->sb.data_end) != 0) {
+            fprintf(stderr, "Avertissement : plage %llu+%llu déjà libre, ignorée\n",
+                    (unsigned long long)fs->sb.data_end,
+                    (unsigned long long)(offset - fs->sb.data_end));
+        }
+    }
+    fs->sb.data_end = offset + capacity;
+
+    SuperBlock home = j->committed;
+    home.journal_offset = offset;
+    home.journal_capacity = capacity;
+    home.data_end = offset + capacity;
+    if (io_sync(fs->container) != 0 || io_extend(fs->container, home.data_end) != 0 ||
+        io_write(fs->container, 0, &home, sizeof(SuperBlock)) != sizeof(SuperBlock) ||
+        io_sync(fs->container) != 0) {
+        fprintf(stderr, "Erreur : déplacement du journal impossible\n");
+        return -1;
+    }
+
+    space_release(fs, fs->sb.journal_offset, fs->sb.journal_capacity);
+    fs->sb.journal_offset = offset;
+    fs->sb.journal_capacity = capacity;
+    j->committed = home;
+    j->head = 0;
+    return 0;
+}
+
+// Rend l'espace libere depuis la derniere transaction : l'etat qu'elle
+// valide ne le designe plus
+static void journal_release_pending(FileSystem *fs) {
+    FreeMap *pending = &fs->journal.pending_free;
+    for (uint32_t i = 0; i < pending->count; i++) {
+        const FreeRun *run = &pending->by_offset[i];
+        if (freemap_insert(&fs->free_map, run->offset, run->length) != 0) {
+            fprintf(stderr, "Avertissement : plage %llu+%llu déjà libre, ignorée\n",
+                    (unsigned long long)run->offset, (unsigned long long)run->length);
+        }
+    }
+    freemap_destroy(pending);
+    release_data_tail(fs);
+}
+
+// Valide toutes les modifications en attente. compact autorise le compactage
+// du tas de noms (fermeture).
+static int journal_commit(FileSystem *fs, int compact) {
+    Journal *j = &fs->journal;
+    int journaled = fs->sb.journal_offset != 0;
+
+    // Index de repertoires et tas de noms d'abord : leurs zones neuves sont
+    // ecrites directement, avant l'espace libere qui pourrait les accueillir
+    dir_index_save_all(fs);
+    name_heap_save(fs, compact);
+    cache_flush(fs);
+    ref_map_save(fs);
+
+    // Une transaction qui modifie les entrees rend caduc l'index sauvegarde
+    if (journaled && fs->path_index_changed) {
+        fs->sb.path_index_generation++;
+        fs->path_index_current = 0;
+    }
+    fs->path_index_changed = 0;
+
+    // Rien n'a change : pas de transaction vide
+    if (journaled && j->len == 0 && j->pending_free.count == 0 &&
+        memcmp(&fs->sb, &j->committed, sizeof(SuperBlock)) == 0) {
+        j->ops = 0;
+        j->last_commit = time(NULL);
+        return 0;
+    }
+
+    int ret = 0;
+    if (journaled) {
+        // Taille majoree de la transaction une fois la carte d'espace libre
+        // et le SuperBlock ajoutes
+        FreeMap *fm = &fs->free_map;
+        uint64_t map_bytes = sizeof(FreeMapHeader) +
+                             (uint64_t)(fm->count + j->pending_free.count + 4) * sizeof(FreeRun);
+        uint64_t size = blocks_for_size(sizeof(JournalHeader) + j->len + 3 * sizeof(JournalRecord) +
+                                        map_bytes + sizeof(SuperBlock)) * BLOCK_SIZE;
+        if (size > fs->sb.journal_capacity && journal_relocate(fs, size) != 0) ret = -1;
+    }
+
+    // Les grandes plages liberees seront aussi rendues a l'hote, une fois la
+    // transaction durable : jusque-la, l'etat valide peut encore les designer
+    ExtentList punch = {0};
+    if (journaled) {
+        const FreeMap *pending = &j->pending_free;
+        for (uint32_t i = 0; i < pending->count; i++) {
+            if (pending->by_offset[i].length >= PUNCH_MIN) {
+                extent_list_push(&punch, pending->by_offset[i].offset, pending->by_offset[i].length);
+            }
+        }
+    }
+
+    journal_release_pending(fs);
+    free_map_save(fs);
+    // Les zones reservees avec une marge ne sont ecrites qu'en partie : le
+    // conteneur doit tout de meme couvrir la fin des donnees
+    io_extend(fs->container, fs->sb.data_end);
+
+    if (!journaled) {
+        io_write(fs->container, 0, &fs->sb, sizeof(SuperBlock));
+        return 0;
+    }
+
+    uint64_t sequence = fs->sb.journal_sequence;
+    fs->sb.journal_sequence = sequence + 1;
+    // L'index des empreintes sauvegarde ne connait pas cette transaction
+    fs->dedup_current = 0;
+    journal_record(fs, 0, &fs->sb, sizeof(SuperBlock));
+
+    // Zone pleine : les transactions precedentes doivent etre durables a leur
+    // place avant que le journal ne reparte du debut
+    uint64_t size = blocks_for_size(sizeof(JournalHeader) + j->len) * BLOCK_SIZE;
+    int wrap = j->head + size > fs->sb.journal_capacity;
+    // Mode ordonne : les donnees et zones neuves ecrites directement depuis
+    // la derniere mise en place doivent etre durables avant l'enregistrement
+    // qui les designe, sans quoi un rejeu apres coupure pourrait designer des
+    // blocs qui contiennent encore l'ancien contenu
+    int ordered = io_write_count(fs->container) != j->checkpoint_writes && io_unsynced(fs->container);
+    if ((wrap || ordered) && io_sync(fs->container) != 0) ret = -1;
+    if (wrap) j->head = 0;
+
+    JournalHeader header = { JOURNAL_MAGIC, j->records, sequence, j->len, 0 };
+    uint64_t hash = journal_checksum(JOURNAL_CHECKSUM_SEED, &header, sizeof(header));
+    header.checksum = journal_checksum(hash, j->buf, j->len);
+    struct iovec iov[2] = {
+        { &header, sizeof(header) },
+        { j->buf, j->len },
+    };
+    if (io_writev(fs->container, fs->sb.journal_offset + j->head, iov, 2) != sizeof(header) + j->len ||
+        io_sync(fs->container) != 0) {
+        fprintf(stderr, "Erreur : écriture du journal impossible\n");
+        ret = -1;
+    }
+
+    journal_checkpoint(fs);
+    if (ret == 0) {
+        for (uint32_t i = 0; i < punch.count; i++) {
+            punch_free_range(fs, punch.items[i].offset, punch.items[i].length);
+        }
+    }
+    extent_list_free(&punch);
+    j->checkpoint_writes = io_write_count(fs->container);
+    j->len = 0;
+    j->records = 0;
+    if (j->slots) memset(j->slots, 0, (j->slot_mask + 1) * sizeof(JournalSlot));
+    j->slot_count = 0;
+    j->head += size;
+    j->committed = fs->sb;
+    j->ops = 0;
+    j->last_commit = time(NULL);
+    return ret;
+}
+
+// Fin d'une operation, seul moment ou l'etat est coherent : la transaction
+// est validee quand assez d'operations sont regroupees, quand le cache ou la
+// transaction se remplissent, ou quand la precedente date de plus de
+// JOURNAL_INTERVAL secondes
+static void journal_op_end(FileSystem *fs) {
+    Journal *j = &fs->journal;
+    j->ops++;
+    if (j->depth > 0) {
+        // Transaction explicite : seule la taille de la transaction compte
+        if (j->len * 2 >= fs->sb.journal_capacity) journal_commit(fs, 0);
+        return;
+    }
+    if (j->ops >= JOURNAL_GROUP_OPS || fs->cache_dirty * 2 >= (uint32_t)fs->cache_capacity ||
+        j->len * 2 >= fs->sb.journal_capacity || time(NULL) - j->last_commit >= JOURNAL_INTERVAL) {
+        journal_commit(fs, 0);
+    }
+}
+
+int fs_sync(FileSystem *fs) {
+    return journal_commit(fs, 0);
+}
+
+void fs_txn_begin(FileSystem *fs) {
+    fs->journal.depth++;
+}
+
+int fs_txn_commit(FileSystem *fs) {
+    Journal *j = &fs->journal;
+    if (j->depth == 0 || --j->depth > 0) return 0;
+    return journal_commit(fs, 0);
+}
+
+// --- Index des entrees sauvegarde ---
+
+static uint64_t path_index_bytes(const FileSystem *fs) {
+    return sizeof(PathIndexHeader) + (uint64_t)fs->hash_capacity * sizeof(HashEntry) +
+           (uint64_t)fs->inode_bitmap_words * sizeof(uint64_t);
+}
+
+static uint64_t path_index_checksum(PathIndexHeader header, const struct iovec *iov, int count) {
+    header.checksum = 0;
+    uint64_t hash = journal_checksum(JOURNAL_CHECKSUM_SEED, &header, sizeof(header));
+    for (int i = 0; i < count; i++) {
+        hash = journal_checksum(hash, iov[i].iov_base, iov[i].iov_len);
+    }
+    return hash;
+}
+
+// Reprend la table de hachage et le bitmap des inodes libres sauvegardes a
+// la derniere fermeture, sans parcourir la table d'inodes. Echoue (la table
+// est alors parcourue) si l'index manque, decrit une autre transaction que
+// la derniere validee ou ne correspond pas a sa somme de controle.
+static int path_index_load(FileSystem *fs) {
+    if (fs->sb.path_index_offset == 0 || fs->sb.journal_offset == 0) return -1;
+
+    PathIndexHeader header;
+    if (io_read(fs->container, fs->sb.path_index_offset, &header, sizeof(header)) != sizeof(header) ||
+        header.magic != PATH_INDEX_MAGIC || header.generation != fs->sb.path_index_generation ||
+        header.max_files != fs->sb.max_files || header.hash_capacity < HASH_TABLE_SIZE ||
+        (header.hash_capacity & (header.hash_capacity - 1)) != 0 ||
+        header.hash_count >= header.hash_capacity) {
+        return -1;
+    }
+
+    uint32_t words = (fs->sb.max_files + 63) / 64;
+    size_t table_bytes = (size_t)header.hash_capacity * sizeof(HashEntry);
+    size_t bitmap_bytes = (size_t)words * sizeof(uint64_t);
+    if (sizeof(header) + table_bytes + bitmap_bytes > fs->sb.path_index_capacity) return -1;
+
+    HashEntry *table = malloc(table_bytes);
+    uint64_t *bitmap = malloc(bitmap_bytes);
+    struct iovec iov[2] = {
+        { table, table_bytes },
+        { bitmap, bitmap_bytes },
+    };
+    if (!table || !bitmap ||
+        io_readv(fs->container, fs->sb.path_index_offset + sizeof(header), iov, 2) != table_bytes + bitmap_bytes ||
+        path_index_checksum(header, iov, 2) != header.checksum) {
+        free(table);
+        free(bitmap);
+        return -1;
+    }
+
+    // Les index de repertoires sont tous sur disque : ils seront lus a la demande
+    dir_index_destroy(fs);
+    if (dir_index_resize(fs, fs->sb.max_files) != 0) {
+        free(table);
+        free(bitmap);
+        return -1;
+    }
+
+    free(fs->hash_table);
+    fs->hash_table = table;
+    fs->hash_capacity = header.hash_capacity;
+    fs->hash_count = header.hash_count;
+    free(fs->inode_bitmap);
+    fs->inode_bitmap = bitmap;
+    fs->inode_bitmap_words = words;
+    fs->inode_hint = 0;
+    fs->path_index_current = 1;
+    return 0;
+}
+
+// Reserve la zone de l'index avant la derniere transaction, qui la designe.
+// Sans journal, rien ne permettrait de savoir si l'index est a jour.
+static void path_index_reserve(FileSystem *fs) {
+    uint64_t needed = path_index_bytes(fs);
+    if (fs->sb.journal_offset == 0 || needed <= fs->sb.path_index_capacity) return;
+
+    if (fs->sb.path_index_offset != 0) {
+        space_release(fs, fs->sb.path_index_offset, fs->sb.path_index_capacity);
+    }
+    uint64_t capacity = blocks_for_size(needed) * BLOCK_SIZE;
+    uint64_t offset;
+    if (freemap_alloc_best_fit(&fs->free_map, capacity, &offset) != 0) {
+        offset = alloc_at_end(fs, capacity);
+    }
+    fs->sb.path_index_offset = offset;
+    fs->sb.path_index_capacity = capacity;
+}
+
+// Ecrit l'index apres la derniere transaction, s'il a change depuis sa
+// derniere sauvegarde. Sa
+// zone n'est pas journalisee : une ecriture interrompue ne passe pas la somme
+// de controle, et l'ouverture suivante reconstruit l'index.
+static void path_index_save(FileSystem *fs) {
+    if (fs->path_index_current || fs->sb.journal_offset == 0 ||
+        path_index_bytes(fs) > fs->sb.path_index_capacity) {
+        return;
+    }
+
+    PathIndexHeader header = { PATH_INDEX_MAGIC, fs->sb.max_files, fs->sb.path_index_generation,
+                               fs->hash_capacity, fs->hash_count, 0 };
+    struct iovec iov[3] = {
+        { &header, sizeof(header) },
+        { fs->hash_table, (size_t)fs->hash_capacity * sizeof(HashEntry) },
+        { fs->inode_bitmap, (size_t)fs->inode_bitmap_words * sizeof(uint64_t) },
+    };
+    header.checksum = path_index_checksum(header, iov + 1, 2);
+    if (io_writev(fs->container, fs->sb.path_index_offset, iov, 3) != path_index_bytes(fs)) {
+        fprintf(stderr, "Avertissement : sauvegarde de l'index des entrées impossible\n");
+        return;
+    }
+    fs->path_index_current = 1;
+}
+
+// --- Index des empreintes sauvegarde ---
+
+static uint64_t dedup_index_bytes(const FileSystem *fs) {
+    return sizeof(DedupIndexHeader) + (uint64_t)fs->dedup.count * sizeof(DedupEntry);
+}
+
+// Reprend l'index des empreintes sauvegarde a la derniere fermeture. Un index
+// manquant, d'une autre transaction ou abime repart vide : les blocs deja
+// ecrits ne seront simplement plus proposes au partage.
+static void dedup_index_load(FileSystem *fs) {
+    dedup_init(&fs->dedup);
+    fs->dedup_current = 0;
+    if (fs->sb.dedup_index_offset == 0 || fs->sb.journal_offset == 0) return;
+
+    DedupIndexHeader header;
+    if (io_read(fs->container, fs->sb.dedup_index_offset, &header, sizeof(header)) != sizeof(header) ||
+        header.magic != DEDUP_INDEX_MAGIC || header.sequence != fs->sb.journal_sequence ||
+        sizeof(header) + header.count * sizeof(DedupEntry) > fs->sb.dedup_index_capacity) {
+        return;
+    }
+
+    size_t bytes = (size_t)header.count * sizeof(DedupEntry);
+    DedupEntry *entries = malloc(bytes > 0 ? bytes : 1);
+    uint64_t checksum = header.checksum;
+    header.checksum = 0;
+    if (!entries ||
+        io_read(fs->container, fs->sb.dedup_index_offset + sizeof(header), entries, bytes) != bytes ||
+        journal_checksum(journal_checksum(JOURNAL_CHECKSUM_SEED, &header, sizeof(header)), entries,
+                         bytes) != checksum) {
+        free(entries);
+        return;
+    }
+    for (uint64_t i = 0; i < header.count; i++) {
+        if (dedup_insert(&fs->dedup, entries[i].fingerprint, entries[i].offset) != 0) {
+            dedup_destroy(&fs->dedup);
+            free(entries);
+            return;
+        }
+    }
+    free(entries);
+    fs->dedup_current = 1;
+}
+
+// Reserve la zone de l'index avant la derniere transaction, qui la designe
+static void dedup_index_reserve(FileSystem *fs) {
+    uint64_t needed = dedup_index_bytes(fs);
+    if (fs->sb.journal_offset == 0 || (fs->dedup.count == 0 && fs->sb.dedup_index_offset == 0) ||
+        needed <= fs->sb.dedup_index_capacity) {
+        return;
+    }
+
+    if (fs->sb.dedup_index_offset != 0) {
+        space_release(fs, fs->sb.dedup_index_offset, fs->sb.dedup_index_capacity);
+    }
+    uint64_t capacity = blocks_for_size(needed) * BLOCK_SIZE;
+    uint64_t offset;
+    if (freemap_alloc_best_fit(&fs->free_map, capacity, &offset) != 0) {
+        offset = alloc_at_end(fs, capacity);
+    }
+    fs->sb.dedup_index_offset = offset;
+    fs->sb.dedup_index_capacity = capacity;
+}
+
+// Ecrit l'index apres la derniere transaction, hors journal comme l'index des
+// entrees : une ecriture interrompue ne passe pas la somme de controle
+static void dedup_index_save(FileSystem *fs) {
+    if (fs->dedup_current || fs->sb.dedup_index_offset == 0 ||
+        dedup_index_bytes(fs) > fs->sb.dedup_index_capacity) {
+        return;
+    }
+
+    size_t bytes = (size_t)fs->dedup.count * sizeof(DedupEntry);
+    DedupEntry *entries = malloc(bytes > 0 ? bytes : 1);
+    if (!entries) return;
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < fs->dedup.capacity; i++) {
+        if (fs->dedup.by_offset[i].offset != 0) entries[n++] = fs->dedup.by_offset[i];
+    }
+
+    DedupIndexHeader header = { DEDUP_INDEX_MAGIC, 0, fs->sb.journal_sequence, n, 0 };
+    header.checksum = journal_checksum(journal_checksum(JOURNAL_CHECKSUM_SEED, &header, sizeof(header)),
+                                       entries, bytes);
+    struct iovec iov[2] = {
+        { &header, sizeof(header) },
+        { entries, bytes },
+    };
+    if (io_writev(fs->container, fs->sb.dedup_index_offset, iov, 2) != sizeof(header) + bytes) {
+        fprintf(stderr, "Avertissement : sauvegarde de l'index des empreintes impossible\n");
+    } else {
+        fs->dedup_current = 1;
+    }
+    free(entries);
+}
+
+// Enregistre les extents dans l'inode. Au-dela de INODE_INLINE_EXTENTS, les
+// suivants sont ecrits dans une chaine de blocs de debordement.
+static int inode_store_extents(FileSystem *fs, Inode *inode, const ExtentList *list) {
+    uint32_t inline_count = list->count < INODE_INLINE_EXTENTS ? list->count : INODE_INLINE_EXTENTS;
+
+    memset(inode->extents, 0, sizeof(inode->extents));
+    if (inline_count) memcpy(inode->extents, list->items, inline_count * sizeof(Extent));
+    inode->extent_count = list->count;
+    inode->extent_block = 0;
+
+    if (list->count <= INODE_INLINE_EXTENTS) return 0;
+
+    uint32_t overflow = list->count - INODE_INLINE_EXTENTS;
+    uint64_t nblocks = (overflow + EXTENTS_PER_BLOCK - 1) / EXTENTS_PER_BLOCK;
+
+    ExtentList blocks = {0};
+    if (alloc_blocks(fs, nblocks, &blocks) != 0) {
+        extent_list_free(&blocks);
+        return -1;
+    }
+
+    uint64_t *offsets = malloc(nblocks * sizeof(uint64_t));
+    if (!offsets) {
+        free_extent_list(fs, &blocks);
+        extent_list_free(&blocks);
+        return -1;
+    }
+    uint64_t n = 0;
+    for (uint32_t i = 0; i < blocks.count; i++) {
+        for (uint64_t off = 0; off < blocks.items[i].length; off += BLOCK_SIZE) {
+            offsets[n++] = blocks.items[i].offset + off;
+        }
+    }
+
+    uint32_t pos = INODE_INLINE_EXTENTS;
+    int ret = 0;
+    for (uint64_t b = 0; b < nblocks; b++) {
+        ExtentBlock eb;
+        memset(&eb, 0, sizeof(eb));
+        eb.magic = EXTENT_BLOCK_MAGIC;
+        eb.count = (list->count - pos) < EXTENTS_PER_BLOCK ? (list->count - pos) : EXTENTS_PER_BLOCK;
+        eb.next = (b + 1 < nblocks) ? offsets[b + 1] : 0;
+        memcpy(eb.extents, &list->items[pos], eb.count * sizeof(Extent));
+        pos += eb.count;
+
+        if (io_write(fs->container, offsets[b], &eb, sizeof(ExtentBlock)) != sizeof(ExtentBlock)) {
+            ret = -1;
+            break;
+        }
+    }
+
+    if (ret == 0) {
+        inode->extent_block = offsets[0];
+    } else {
+        free_extent_list(fs, &blocks);
+    }
+    free(offsets);
+    extent_list_free(&blocks);
+    return ret;
+}
+
+// Libere les blocs de donnees d'un inode ainsi que ses blocs de debordement
+static void inode_free_data(FileSystem *fs, Inode *inode) {
+    ExtentList list;
+    if (inode_load_extents(fs, inode, &list) == 0) {
+        ExtentList chain = {0};
+        uint64_t block = inode->extent_count > INODE_INLINE_EXTENTS ? inode->extent_block : 0;
+        while (block != 0) {
+            ExtentBlock eb;
+            if (io_read(fs->container, block, &eb, sizeof(ExtentBlock)) != sizeof(ExtentBlock) ||
+                eb.magic != EXTENT_BLOCK_MAGIC) {
+                break;
+            }
+            extent_list_push(&chain, block, BLOCK_SIZE);
+            block = eb.next;
+        }
+        free_extent_list(fs, &list);
+        free_extent_list(fs, &chain);
+        extent_list_free(&chain);
+        extent_list_free(&list);
+    }
+
+    inode->size = 0;
+    inode->extent_count = 0;
+    inode->extent_block = 0;
+    memset(inode->extents, 0, sizeof(inode->extents));
+}
+
+// --- Lecture a travers les extents ---
+
+// Lit len octets a la position off des donnees stockees dans des extents
+static size_t extents_read(FileSystem *fs, const Extent *extents, uint32_t count, uint64_t off,
+                           void *buf, size_t len) {
+    size_t done = 0;
+    for (uint32_t e = 0; e < count && done < len; e++) {
+        if (off >= extents[e].length) {
+            off -= extents[e].length;
+            continue;
+        }
+        uint64_t chunk = extents[e].length - off;
+        if (chunk > len - done) chunk = len - done;
+        size_t n = io_read(fs->container, extents[e].offset + off, (char *)buf + done, (size_t)chunk);
+        done += n;
+        if (n < chunk) break;
+        off = 0;
+    }
+    return done;
+}
+
+// Lit la table des sommes d'un fichier (voir ChecksumHeader). -1 si elle est
+// illisible ou ne correspond pas au contenu.
+static int checksum_table_read(FileSystem *fs, const Inode *inode, const Extent *extents,
+                               uint32_t count, ChecksumHeader *header, uint32_t **sums) {
+    uint64_t at = (uint64_t)inode->checksum_block * BLOCK_SIZE;
+    *sums = NULL;
+    if (extents_read(fs, extents, count, at, header, sizeof(*header)) != sizeof(*header) ||
+        header->magic != CHECKSUM_MAGIC || header->block_size != BLOCK_SIZE ||
+        header->block_count != blocks_for_size(inode->size)) {
+        return -1;
+    }
+
+    size_t bytes = (size_t)header->block_count * sizeof(uint32_t);
+    uint32_t *table = malloc(bytes > 0 ? bytes : 1);
+    ChecksumHeader blank = *header;
+    blank.table_crc = 0;
+    if (!table || extents_read(fs, extents, count, at + sizeof(*header), table, bytes) != bytes ||
+        crc32c(crc32c(0, &blank, sizeof(blank)), table, bytes) != header->table_crc) {
+        free(table);
+        return -1;
+    }
+    *sums = table;
+    return 0;
+}
+
+// Signale un contenu qui ne correspond pas a ses sommes. -1 en mode strict :
+// la lecture s'arrete.
+static int reader_corrupt(FsReader *reader, const char *what, uint64_t block) {
+    reader->corrupt++;
+    int strict = reader->fs->verify == FS_VERIFY_STRICT;
+    if (block == UINT64_MAX) {
+        fprintf(stderr, "%s : %s du contenu différent\n", strict ? "Erreur" : "Avertissement", what);
+    } else {
+        fprintf(stderr, "%s : bloc %llu du contenu corrompu (%s)\n", strict ? "Erreur" : "Avertissement",
+                (unsigned long long)block, what);
+    }
+    return strict ? -1 : 0;
+}
+
+// Verifie les octets [reader->pos, reader->pos + len) du contenu, presents
+// dans data, avant de les rendre. Chaque bloc touche l'est une fois : un bloc
+// que la lecture ne couvre qu'en partie est relu en entier (sauf dans un
+// morceau compresse, verifie au decodage). Le SHA-256 suit les lectures
+// consecutives depuis le debut. -1 si un bloc est corrompu en mode strict.
+static int reader_check(FsReader *reader, const uint8_t *data, size_t len) {
+    uint64_t pos = reader->pos;
+    uint64_t size = reader->pos + reader->remaining;
+
+    for (uint64_t b = pos / BLOCK_SIZE; reader->sums && b * BLOCK_SIZE < pos + len; b++) {
+        if (b >= reader->verified_from && b < reader->verified_to) continue;
+        uint64_t start = b * BLOCK_SIZE;
+        size_t n = size - start < BLOCK_SIZE ? (size_t)(size - start) : BLOCK_SIZE;
+        const uint8_t *block = data + (start - pos);
+        if (start < pos || start + n > pos + len) {
+            if (reader->chunks) continue;
+            if (!reader->block && !(reader->block = malloc(BLOCK_SIZE))) return -1;
+            block = reader->block;
+            if (extents_read(reader->fs, reader->extents, reader->count, start, reader->block, n) != n) {
+                memset(reader->block, 0, n);
+            }
+        }
+        if (crc32c(0, block, n) != reader->sums[b] && reader_corrupt(reader, "CRC32C", b) != 0) return -1;
+        if (b != reader->verified_to) reader->verified_from = b;
+        reader->verified_to = b + 1;
+    }
+
+    if (reader->check_sha && pos == reader->sha_pos) {
+        sha256_update(&reader->sha, data, len);
+        reader->sha_pos += len;
+        if (reader->sha_pos == size) {
+            uint8_t digest[SHA256_SIZE];
+            sha256_final(&reader->sha, digest);
+            reader->check_sha = 0;
+            if (memcmp(digest, reader->sha256, SHA256_SIZE) != 0 &&
+                reader_corrupt(reader, "SHA-256", UINT64_MAX) != 0) {
+                return -1;
+            }
+        }
+    } else {
+        reader->check_sha = 0;
+    }
+    return 0;
+}
+
+// Un contenu corrompu arrete la lecture pour de bon en mode strict, un
+// morceau illisible dans tous les modes
+static int reader_stopped(const FsReader *reader) {
+    return reader->failed || (reader->corrupt > 0 && reader->fs->verify == FS_VERIFY_STRICT);
+}
+
+// Charge la table des morceaux d'un fichier compresse. Elle est verifiee une
+// fois pour toutes : positions croissantes, dans les extents, et morceaux
+// jamais plus gros qu'une fois decodes.
+static int reader_open_chunks(FsReader *reader, uint64_t size) {
+    uint64_t stored = 0;
+    for (uint32_t e = 0; e < reader->count; e++) stored += reader->extents[e].length;
+
+    CompressHeader header;
+    if (extents_read(reader->fs, reader->extents, reader->count, 0, &header, sizeof(header)) !=
+            sizeof(header) ||
+        header.magic != COMPRESS_MAGIC || header.chunk_size == 0 || header.chunk_size > COMPRESS_CHUNK ||
+        header.chunk_count != (size + header.chunk_size - 1) / header.chunk_size ||
+        header.chunk_count > stored / sizeof(uint64_t)) {
+        return -1;
+    }
+
+    size_t table_bytes = (size_t)(header.chunk_count + 1) * sizeof(uint64_t);
+    reader->chunks = malloc(table_bytes);
+    reader->chunk = malloc(header.chunk_size);
+    reader->packed = malloc(header.chunk_size);
+    if (!reader->chunks || !reader->chunk || !reader->packed ||
+        extents_read(reader->fs, reader->extents, reader->count, sizeof(header), reader->chunks,
+                     table_bytes) != table_bytes) {
+        return -1;
+    }
+
+    uint64_t prev = sizeof(header) + table_bytes;
+    for (uint64_t i = 0; i <= header.chunk_count; i++) {
+        uint64_t at = reader->chunks[i] & ~COMPRESS_RAW;
+        if (at < prev || at > stored || (i > 0 && at - prev > header.chunk_size)) return -1;
+        prev = at;
+    }
+    reader->chunk_count = header.chunk_count;
+    reader->chunk_size = header.chunk_size;
+    reader->chunk_index = header.chunk_count;
+    return 0;
+}
+
+// Decode le morceau index dans reader->chunk
+static int reader_load_chunk(FsReader *reader, uint64_t index) {
+    uint64_t start = reader->chunks[index] & ~COMPRESS_RAW;
+    size_t stored = (size_t)((reader->chunks[index + 1] & ~COMPRESS_RAW) - start);
+    uint64_t size = reader->pos + reader->remaining;
+    size_t want = index + 1 < reader->chunk_count ? reader->chunk_size
+                                                 : (size_t)(size - index * reader->chunk_size);
+
+    int ok;
+    if (reader->chunks[index] & COMPRESS_RAW) {
+        ok = stored == want && extents_read(reader->fs, reader->extents, reader->count, start,
+                                            reader->chunk, want) == want;
+    } else {
+        ok = extents_read(reader->fs, reader->extents, reader->count, start, reader->packed, stored) ==
+                 stored &&
+             lz_decompress(reader->packed, stored, reader->chunk, want) == 0;
+    }
+    if (!ok) {
+        // Rien a rendre a la place : la lecture s'arrete quel que soit le mode
+        fprintf(stderr, "Erreur : morceau compressé %llu illisible\n", (unsigned long long)index);
+        reader->chunk_index = reader->chunk_count;
+        reader->corrupt++;
+        reader->failed = 1;
+        return -1;
+    }
+
+    // Blocs du morceau decode, sans toucher au SHA-256 (suivi a la lecture)
+    if (reader->sums) {
+        int check_sha = reader->check_sha;
+        uint64_t pos = reader->pos;
+        uint64_t remaining = reader->remaining;
+        reader->pos = index * reader->chunk_size;
+        reader->remaining = size - reader->pos;
+        reader->check_sha = 0;
+        ok = reader_check(reader, reader->chunk, want) == 0;
+        reader->pos = pos;
+        reader->remaining = remaining;
+        reader->check_sha = check_sha;
+        if (!ok) {
+            reader->chunk_index = reader->chunk_count;
+            return -1;
+        }
+    }
+    reader->chunk_index = index;
+    reader->chunk_len = want;
+    return 0;
+}
+
+static int reader_open(FileSystem *fs, const Inode *inode, FsReader *reader, int stored) {
+    ExtentList list;
+    if (inode_load_extents(fs, inode, &list) != 0) return -1;
+
+    memset(reader, 0, sizeof(*reader));
+    reader->fs = fs;
+    reader->extents = list.items;
+    reader->count = list.count;
+    reader->remaining = inode->type != INODE_FREE ? inode->size : 0;
+    if (reader->remaining == 0) return 0;
+
+    if (stored) {
+        // Donnees telles que stockees, table des sommes comprise : les
+        // extents sont ajustes au bloc pres
+        if (!(inode->flags & (INODE_FLAG_COMPRESSED | INODE_FLAG_CHECKSUM))) return 0;
+        reader->remaining = 0;
+        for (uint32_t e = 0; e < list.count; e++) reader->remaining += list.items[e].length;
+        return 0;
+    }
+
+    if ((inode->flags & INODE_FLAG_CHECKSUM) && fs->verify != FS_VERIFY_OFF) {
+        ChecksumHeader header;
+        if (checksum_table_read(fs, inode, list.items, list.count, &header, &reader->sums) == 0) {
+            reader->sum_count = header.block_count;
+            reader->check_sha = (header.flags & CHECKSUM_SHA256) != 0;
+            sha256_init(&reader->sha);
+            memcpy(reader->sha256, header.sha256, SHA256_SIZE);
+        } else if (fs->verify == FS_VERIFY_STRICT) {
+            fprintf(stderr, "Erreur : table des sommes de contrôle illisible\n");
+            fs_reader_close(reader);
+            return -1;
+        } else {
+            fprintf(stderr, "Avertissement : table des sommes de contrôle illisible, contenu non vérifié\n");
+        }
+    }
+
+    if ((inode->flags & INODE_FLAG_COMPRESSED) && reader_open_chunks(reader, inode->size) != 0) {
+        fprintf(stderr, "Erreur : table des morceaux compressés illisible\n");
+        fs_reader_close(reader);
+        return -1;
+    }
+    return 0;
+}
+
+int fs_reader_open(FileSystem *fs, const Inode *inode, FsReader *reader) {
+    return reader_open(fs, inode, reader, 0);
+}
+
+// Lecteur des donnees telles que stockees (compressees ou non), pour les
+// recopier sans les decoder
+static int stored_reader_open(FileSystem *fs, const Inode *inode, FsReader *reader) {
+    return reader_open(fs, inode, reader, 1);
+}
+
+size_t fs_reader_read(FsReader *reader, void *buf, size_t len) {
+    size_t done = 0;
+    if (reader_stopped(reader)) return 0;
+
+    if (reader->chunks) {
+        while (done < len && reader->remaining > 0) {
+            uint64_t index = reader->pos / reader->chunk_size;
+            if (index != reader->chunk_index && reader_load_chunk(reader, index) != 0) break;
+            size_t at = (size_t)(reader->pos % reader->chunk_size);
+            size_t n = reader->chunk_len - at;
+            if (n > len - done) n = len - done;
+            if (reader->check_sha && reader_check(reader, reader->chunk + at, n) != 0) break;
+            memcpy((char *)buf + done, reader->chunk + at, n);
+            done += n;
+            reader->pos += n;
+            reader->remaining -= n;
+        }
+        return done;
+    }
+
+    while (done < len && reader->remaining > 0 && reader->current < reader->count) {
+        const Extent *ext = &reader->extents[reader->current];
+        uint64_t avail = ext->length - reader->ext_pos;
+        if (avail == 0) {
+            reader->current++;
+            reader->ext_pos = 0;
+            continue;
+        }
+
+        uint64_t chunk = len - done;
+        if (chunk > avail) chunk = avail;
+        if (chunk > reader->remaining) chunk = reader->remaining;
+
+        size_t n = io_read(reader->fs->container, ext->offset + reader->ext_pos,
+                           (char *)buf + done, (size_t)chunk);
+        if ((reader->sums || reader->check_sha) && reader_check(reader, (uint8_t *)buf + done, n) != 0) break;
+        done += n;
+        reader->ext_pos += n;
+        reader->pos += n;
+        reader->remaining -= n;
+        if (n < chunk) break;
+    }
+    return done;
+}
+
+int fs_reader_seek(FsReader *reader, uint64_t pos) {
+    uint64_t size = reader->pos + reader->remaining;
+    if (pos > size) return -1;
+    reader->pos = pos;
+    reader->remaining = size - pos;
+    if (reader->chunks) return 0; // Le morceau sera decode a la lecture
+
+    reader->current = 0;
+    reader->ext_pos = pos;
+    while (reader->current < reader->count &&
+           reader->ext_pos >= reader->extents[reader->current].length) {
+        reader->ext_pos -= reader->extents[reader->current].length;
+        reader->current++;
+    }
+    return 0;
+}
+
+// Lecture sans copie : pointeur vers la suite de l'extent courant dans la
+// projection du conteneur, ou vers la suite du morceau decode. NULL a la fin,
+// ou si le backend ne projette pas le fichier : fs_reader_read lit alors le
+// reste.
+const void *fs_reader_map(FsReader *reader, size_t *len) {
+    *len = 0;
+    if (reader_stopped(reader)) return NULL;
+    if (reader->chunks) {
+        if (reader->remaining == 0) return NULL;
+        uint64_t index = reader->pos / reader->chunk_size;
+        if (index != reader->chunk_index && reader_load_chunk(reader, index) != 0) return NULL;
+        size_t at = (size_t)(reader->pos % reader->chunk_size);
+        if (reader->check_sha && reader_check(reader, reader->chunk + at, reader->chunk_len - at) != 0) {
+            return NULL;
+        }
+        *len = reader->chunk_len - at;
+        reader->pos += *len;
+        reader->remaining -= *len;
+        return reader->chunk + at;
+    }
+
+    while (reader->remaining > 0 && reader->current < reader->count) {
+        const Extent *ext = &reader->extents[reader->current];
+        uint64_t avail = ext->length - reader->ext_pos;
+        if (avail == 0) {
+            reader->current++;
+            reader->ext_pos = 0;
+            continue;
+        }
+        if (avail > reader->remaining) avail = reader->remaining;
+
+        const void *data = io_map(reader->fs->container, ext->offset + reader->ext_pos, (size_t)avail);
+        if (!data) return NULL;
+        if ((reader->sums || reader->check_sha) && reader_check(reader, data, (size_t)avail) != 0) return NULL;
+        reader->ext_pos += avail;
+        reader->pos += avail;
+        reader->remaining -= avail;
+        *len = (size_t)avail;
+        return data;
+    }
+    return NULL;
+}
+
+void fs_reader_close(FsReader *reader) {
+    free(reader->extents);
+    free(reader->chunks);
+    free(reader->chunk);
+    free(reader->packed);
+    free(reader->sums);
+    free(reader->block);
+    reader->extents = NULL;
+    reader->chunks = NULL;
+    reader->chunk = NULL;
+    reader->packed = NULL;
+    reader->sums = NULL;
+    reader->block = NULL;
+    reader->count = 0;
+    reader->remaining = 0;
+}
+
+// --- Sommes de controle a l'ecriture ---
+//
+// Le contenu d'un fichier ecrit passe par une DataSource : ses CRC32C (et son
+// SHA-256) sont calcules au vol, puis ranges apres les donnees stockees.
+
+typedef struct {
+    uint32_t *sums;       // CRC32C des blocs complets
+    uint64_t count;
+    uint64_t capacity;
+    uint32_t crc;         // Bloc en cours
+    size_t fill;          // Octets deja comptes dans le bloc en cours
+    int sha;              // SHA-256 demande (SB_FLAG_SHA256)
+    Sha256 sha256;
+    int failed;           // Memoire insuffisante
+} ChecksumBuilder;
+
+static void checksum_reset(ChecksumBuilder *cb) {
+    cb->count = 0;
+    cb->crc = 0;
+    cb->fill = 0;
+    cb->failed = 0;
+    if (cb->sha) sha256_init(&cb->sha256);
+}
+
+static void checksum_begin(FileSystem *fs, ChecksumBuilder *cb) {
+    memset(cb, 0, sizeof(*cb));
+    cb->sha = (fs->sb.flags & SB_FLAG_SHA256) != 0;
+    checksum_reset(cb);
+}
+
+static void checksum_end(ChecksumBuilder *cb) {
+    free(cb->sums);
+    cb->sums = NULL;
+}
+
+static void checksum_push(ChecksumBuilder *cb) {
+    if (cb->count == cb->capacity) {
+        uint64_t capacity = cb->capacity ? cb->capacity * 2 : 256;
+        uint32_t *sums = realloc(cb->sums, (size_t)capacity * sizeof(uint32_t));
+        if (!sums) {
+            cb->failed = 1;
+            return;
+        }
+        cb->sums = sums;
+        cb->capacity = capacity;
+    }
+    cb->sums[cb->count++] = cb->crc;
+    cb->crc = 0;
+    cb->fill = 0;
+}
+
+static void checksum_feed(ChecksumBuilder *cb, const uint8_t *data, size_t len) {
+    if (cb->sha) sha256_update(&cb->sha256, data, len);
+    while (len > 0) {
+        size_t n = BLOCK_SIZE - cb->fill;
+        if (n > len) n = len;
+        cb->crc = crc32c(cb->crc, data, n);
+        cb->fill += n;
+        data += n;
+        len -= n;
+        if (cb->fill == BLOCK_SIZE) checksum_push(cb);
+    }
+}
+
+// --- Compression des fichiers ---
+//
+// Un fichier compresse est decoupe en morceaux de COMPRESS_CHUNK octets
+// compresses separement (lz), precedes de la table de leurs positions : une
+// lecture ne decode que les morceaux qu'elle touche. Un morceau qui ne
+// raccourcit pas est garde tel quel.
+
+// Source des donnees a ecrire : fichier de l'hote ou contenu d'un inode.
+// Le contenu lu alimente sums, s'il y en a.
+typedef struct {
+    FILE *file;
+    FsReader *reader;
+    ChecksumBuilder *sums;
+} DataSource;
+
+static size_t source_read(DataSource *source, void *buf, size_t len) {
+    size_t done = 0;
+    while (done < len) {
+        size_t n = source->file ? fread((char *)buf + done, 1, len - done, source->file)
+                                : fs_reader_read(source->reader, (char *)buf + done, len - done);
+        if (n == 0) break;
+        done += n;
+    }
+    if (source->sums) checksum_feed(source->sums, buf, done);
+    return done;
+}
+
+static int source_rewind(DataSource *source) {
+    if (source->sums) checksum_reset(source->sums);
+    return source->file ? fseeko(source->file, 0, SEEK_SET) : fs_reader_seek(source->reader, 0);
+}
+
+// Ecrit size octets de la source dans les extents d'une zone neuve
+static int source_write_extents(FileSystem *fs, DataSource *source, uint64_t size, const ExtentList *dest) {
+    char buffer[BLOCK_SIZE];
+
+    for (uint32_t e = 0; e < dest->count && size > 0; e++) {
+        uint64_t written = 0;
+        while (written < dest->items[e].length && size > 0) {
+            size_t want = size < BLOCK_SIZE ? (size_t)size : BLOCK_SIZE;
+            if (source_read(source, buffer, want) != want ||
+                io_write(fs->container, dest->items[e].offset + written, buffer, want) != want) {
+                return -1;
+            }
+            written += want;
+            size -= want;
+        }
+    }
+    return size == 0 ? 0 : -1;
+}
+
+// Ecrit directement len octets a la position off d'une zone neuve
+static int extents_write_at(FileSystem *fs, const ExtentList *list, uint64_t off, const void *buf,
+                            size_t len) {
+    size_t done = 0;
+    for (uint32_t e = 0; e < list->count && done < len; e++) {
+        if (off >= list->items[e].length) {
+            off -= list->items[e].length;
+            continue;
+        }
+        uint64_t chunk = list->items[e].length - off;
+        if (chunk > len - done) chunk = len - done;
+        if (io_write(fs->container, list->items[e].offset + off, (const char *)buf + done,
+                     (size_t)chunk) != chunk) {
+            return -1;
+        }
+        done += (size_t)chunk;
+        off = 0;
+    }
+    return done == len ? 0 : -1;
+}
+
+// Rend les blocs alloues au-dela des keep premiers octets. Aucun etat valide
+// ne les a designes : ils redeviennent libres tout de suite.
+static void extent_list_shrink(FileSystem *fs, ExtentList *list, uint64_t keep) {
+    uint32_t kept = 0;
+    for (uint32_t e = 0; e < list->count; e++) {
+        Extent *ext = &list->items[e];
+        if (keep >= ext->length) {
+            keep -= ext->length;
+            kept++;
+            continue;
+        }
+        freemap_insert(&fs->free_map, ext->offset + keep, ext->length - keep);
+        if (keep > 0) {
+            ext->length = keep;
+            kept++;
+        }
+        keep = 0;
+    }
+    list->count = kept;
+    release_data_tail(fs);
+}
+
+// Range la table des sommes du contenu (size octets) dans une zone neuve,
+// ajoutee a la suite des extents des donnees. *block recoit sa position dans
+// les extents, pour Inode.checksum_block.
+static int checksum_store(FileSystem *fs, ChecksumBuilder *cb, uint64_t size, ExtentList *data,
+                          uint32_t *block) {
+    if (cb->fill > 0) checksum_push(cb);
+    uint64_t stored = 0;
+    for (uint32_t e = 0; e < data->count; e++) stored += data->items[e].length;
+    if (cb->failed || cb->count != blocks_for_size(size) || stored / BLOCK_SIZE > UINT32_MAX) return -1;
+
+    ChecksumHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = CHECKSUM_MAGIC;
+    header.block_size = BLOCK_SIZE;
+    header.block_count = cb->count;
+    if (cb->sha) {
+        sha256_final(&cb->sha256, header.sha256);
+        header.flags |= CHECKSUM_SHA256;
+    }
+    size_t bytes = (size_t)cb->count * sizeof(uint32_t);
+    header.table_crc = crc32c(crc32c(0, &header, sizeof(header)), cb->sums, bytes);
+
+    ExtentList table = {0};
+    int ok = alloc_blocks(fs, blocks_for_size(sizeof(header) + bytes), &table) == 0 &&
+             extents_write_at(fs, &table, 0, &header, sizeof(header)) == 0 &&
+             extents_write_at(fs, &table, sizeof(header), cb->sums, bytes) == 0;
+    // Le premier extent de la table peut prolonger le dernier des donnees
+    uint32_t kept = data->count;
+    uint64_t last_length = kept > 0 ? data->items[kept - 1].length : 0;
+    for (uint32_t e = 0; ok && e < table.count; e++) {
+        ok = extent_list_push(data, table.items[e].offset, table.items[e].length) == 0;
+    }
+    if (!ok) {
+        data->count = kept;
+        if (kept > 0) data->items[kept - 1].length = last_length;
+        extent_list_shrink(fs, &table, 0);
+        extent_list_free(&table);
+        return -1;
+    }
+    extent_list_free(&table);
+    *block = (uint32_t)(stored / BLOCK_SIZE);
+    return 0;
+}
+
+// Ecrit size octets de la source compresses dans une zone neuve. Retourne 0
+// (zone dans out), 1 si la compression ne fait pas gagner de bloc (rien n'est
+// garde, la source est a relire depuis le debut) ou -1.
+static int compress_write(FileSystem *fs, DataSource *source, uint64_t size, ExtentList *out) {
+    uint64_t count = (size + COMPRESS_CHUNK - 1) / COMPRESS_CHUNK;
+    uint64_t head = sizeof(CompressHeader) + (count + 1) * sizeof(uint64_t);
+    uint64_t plain_blocks = blocks_for_size(size);
+    if (blocks_for_size(head + count) >= plain_blocks) return 1;
+
+    uint64_t *table = malloc((size_t)(count + 1) * sizeof(uint64_t));
+    uint8_t *in = malloc(COMPRESS_CHUNK);
+    uint8_t *packed = malloc(COMPRESS_CHUNK);
+    ExtentList list = {0};
+    int ret = 0;
+
+    // Place pour le pire cas (tout garde tel quel) ; la fin inutilisee est
+    // rendue une fois la taille connue
+    if (!table || !in || !packed || alloc_blocks(fs, blocks_for_size(head + size), &list) != 0) {
+        ret = -1;
+        goto out;
+    }
+
+    uint64_t pos = head;
+    for (uint64_t i = 0; i < count; i++) {
+        size_t want = i + 1 < count ? COMPRESS_CHUNK : (size_t)(size - i * COMPRESS_CHUNK);
+        if (source_read(source, in, want) != want) {
+            ret = -1;
+            goto out;
+        }
+        size_t n = lz_compress(in, want, packed, want - 1);
+        // Premier morceau incompressible : le fichier ne l'est sans doute
+        // pas non plus, inutile d'essayer les suivants
+        if (n == 0 && i == 0 && count > 1) {
+            ret = 1;
+            goto out;
+        }
+        table[i] = pos | (n == 0 ? COMPRESS_RAW : 0);
+        if (extents_write_at(fs, &list, pos, n ? packed : in, n ? n : want) != 0) {
+            ret = -1;
+            goto out;
+        }
+        pos += n ? n : want;
+        if (blocks_for_size(pos) >= plain_blocks) {
+            ret = 1;
+            goto out;
+        }
+    }
+    table[count] = pos;
+
+    CompressHeader header = { COMPRESS_MAGIC, COMPRESS_CHUNK, count };
+    if (extents_write_at(fs, &list, 0, &header, sizeof(header)) != 0 ||
+        extents_write_at(fs, &list, sizeof(header), table, (size_t)(count + 1) * sizeof(uint64_t)) != 0) {
+        ret = -1;
+        goto out;
+    }
+    extent_list_shrink(fs, &list, blocks_for_size(pos) * BLOCK_SIZE);
+    *out = list;
+    list.items = NULL;
+
+out:
+    if (list.items) {
+        extent_list_shrink(fs, &list, 0);
+        extent_list_free(&list);
+    }
+    if (ret == 1 && source_rewind(source) != 0) ret = -1;
+    free(table);
+    free(in);
+    free(packed);
+    return ret;
+}
+
+// --- Deduplication ---
+
+// Unites d'ecriture des blocs neufs consecutifs
+#define DEDUP_BATCH 64
+
+// Ecrit size octets de la source bloc par bloc. Un bloc dont le contenu est
+// deja dans le conteneur (meme empreinte, puis memes octets) y est reference
+// au lieu d'etre recopie ; les autres sont ecrits a la suite dans une zone
+// neuve, dont la fin inutilisee est rendue. Le dernier bloc est complete par
+// des zeros. *shared recoit les octets partages.
+static int dedup_write(FileSystem *fs, DataSource *source, uint64_t size, ExtentList *out,
+                       uint64_t *shared) {
+    uint64_t nblocks = blocks_for_size(size);
+    ExtentList space = {0};   // Zone neuve
+    ExtentList reused = {0};  // Blocs deja presents, references en plus
+    ExtentList list = {0};    // Contenu du fichier, dans l'ordre
+    uint8_t *batch = malloc((size_t)DEDUP_BATCH * BLOCK_SIZE);
+    uint8_t *other = malloc(BLOCK_SIZE);
+    uint64_t batch_at = 0;
+    size_t batch_len = 0;
+    uint32_t e = 0;           // Position d'ecriture dans la zone neuve
+    uint64_t e_off = 0;
+    uint64_t used = 0;
+    int ret = 0;
+
+    *shared = 0;
+    if (!batch || !other || alloc_blocks(fs, nblocks, &space) != 0) {
+        ret = -1;
+        goto out;
+    }
+
+    for (uint64_t b = 0; b < nblocks; b++) {
+        uint8_t *block = batch + batch_len;
+        size_t want = b + 1 < nblocks ? BLOCK_SIZE : (size_t)(size - b * BLOCK_SIZE);
+        if (source_read(source, block, want) != want) {
+            ret = -1;
+            goto out;
+        }
+        memset(block + want, 0, BLOCK_SIZE - want);
+        uint64_t fingerprint = dedup_fingerprint(block, BLOCK_SIZE);
+
+        // Le candidat peut etre un bloc neuf pas encore ecrit : il est alors
+        // compare au tampon
+        uint64_t at;
+        if (dedup_find(&fs->dedup, fingerprint, &at) == 0) {
+            const uint8_t *candidate = other;
+            if (at >= batch_at && at < batch_at + batch_len) {
+                candidate = batch + (at - batch_at);
+            } else if (io_read(fs->container, at, other, BLOCK_SIZE) != BLOCK_SIZE) {
+                candidate = NULL;
+            }
+            if (candidate && memcmp(candidate, block, BLOCK_SIZE) == 0) {
+                if (extent_list_push(&list, at, BLOCK_SIZE) != 0 ||
+                    extent_list_push(&reused, at, BLOCK_SIZE) != 0) {
+                    ret = -1;
+                    goto out;
+                }
+                continue;
+            }
+        }
+
+        while (space.items[e].length == e_off) {
+            e++;
+            e_off = 0;
+        }
+        at = space.items[e].offset + e_off;
+        if (batch_len == 0) batch_at = at;
+        batch_len += BLOCK_SIZE;
+        e_off += BLOCK_SIZE;
+        used += BLOCK_SIZE;
+        if (extent_list_push(&list, at, BLOCK_SIZE) != 0) {
+            ret = -1;
+            goto out;
+        }
+        // Un index plein n'empeche pas l'ecriture : le bloc ne sera pas partage
+        dedup_insert(&fs->dedup, fingerprint, at);
+
+        // Ecrire le lot quand il est plein ou que le bloc suivant n'est plus contigu
+        if (batch_len == (size_t)DEDUP_BATCH * BLOCK_SIZE || e_off == space.items[e].length) {
+            if (io_write(fs->container, batch_at, batch, batch_len) != batch_len) {
+                ret = -1;
+                goto out;
+            }
+            batch_len = 0;
+        }
+    }
+    if (batch_len > 0 && io_write(fs->container, batch_at, batch, batch_len) != batch_len) {
+        ret = -1;
+        goto out;
+    }
+
+    // Les references ne comptent qu'une fois tout ecrit
+    for (uint32_t i = 0; i < reused.count; i++) {
+        if (refmap_add(&fs->ref_map, reused.items[i].offset, reused.items[i].length) != 0) {
+            for (uint32_t k = 0; k < i; k++) {
+                refmap_drop(&fs->ref_map, reused.items[k].offset, reused.items[k].length, NULL, NULL);
+            }
+            ret = -1;
+            goto out;
+        }
+        *shared += reused.items[i].length;
+    }
+    if (reused.count > 0) fs->ref_map_changed = 1;
+    // Le dernier bloc peut deborder du fichier
+    if (*shared > size) *shared = size;
+
+    extent_list_shrink(fs, &space, used);
+    *out = list;
+    list.items = NULL;
+
+out:
+    if (ret != 0) {
+        for (uint32_t i = 0; i < space.count; i++) {
+            dedup_forget(&fs->dedup, space.items[i].offset, space.items[i].length);
+        }
+        extent_list_shrink(fs, &space, 0);
+    }
+    extent_list_free(&space);
+    extent_list_free(&reused);
+    extent_list_free(&list);
+    free(batch);
+    free(other);
+    return ret;
+}
+
+// --- Index des enfants des repertoires (sur disque) ---
+
+// Ecrit len octets a la suite dans les extents d'une liste. Une zone deja
+// designee par l'etat valide (reecriture en place) passe par le journal.
+static int extents_write(FileSystem *fs, const ExtentList *list, const void *buf, uint64_t len,
+                         int in_place) {
+    uint64_t done = 0;
+    for (uint32_t e = 0; e < list->count && done < len; e++) {
+        uint64_t chunk = len - done;
+        if (chunk > list->items[e].length) chunk = list->items[e].length;
+        const char *data = (const char *)buf + done;
+        if (in_place) {
+            if (journal_record(fs, list->items[e].offset, data, (size_t)chunk) != 0) return -1;
+        } else if (io_write(fs->container, list->items[e].offset, data, (size_t)chunk) != chunk) {
+            return -1;
+        }
+        done += chunk;
+    }
+    return done == len ? 0 : -1;
+}
+
+// Index des enfants d'un repertoire, lu depuis ses donnees au premier acces.
+// Les entrees qui ne designent plus un enfant du repertoire sont ecartees.
+static DirIndex *dir_index_get(FileSystem *fs, uint32_t dir) {
+    if (dir >= fs->dirs_capacity) return NULL;
+    if (fs->dirs[dir]) return fs->dirs[dir];
+
+    Inode inode;
+    read_inode_current(fs, (int)dir, &inode);
+    if (inode.type != INODE_DIR) return NULL;
+
+    DirIndex *di = dir_index_new();
+    if (!di) return NULL;
+
+    int stale = 0;
+    if (inode.flags & INODE_FLAG_DIR_INDEX) {
+        uint32_t count = (uint32_t)(inode.size / sizeof(uint32_t));
+        uint32_t *children = malloc((count ? count : 1) * sizeof(uint32_t));
+        FsReader reader;
+        if (!children || fs_reader_open(fs, &inode, &reader) != 0) {
+            free(children);
+            dir_index_free(di);
+            return NULL;
+        }
+        size_t n = fs_reader_read(&reader, children, count * sizeof(uint32_t));
+        fs_reader_close(&reader);
+        if (n != count * sizeof(uint32_t)) {
+            fprintf(stderr, "Avertissement : index du répertoire %u tronqué\n", dir);
+            count = (uint32_t)(n / sizeof(uint32_t));
+            stale = 1;
+        }
+
+        for (uint32_t k = 0; k < count; k++) {
+            Inode child;
+            uint32_t c = children[k];
+            if (c != ROOT_INODE && c < fs->sb.max_files) {
+                read_inode_current(fs, (int)c, &child);
+                if (child.type != INODE_FREE && !inode_is_shared(&child) && child.parent == dir) {
+                    if (dir_index_push(di, c) != 0) {
+                        free(children);
+                        dir_index_free(di);
+                        return NULL;
+                    }
+                    continue;
+                }
+            }
+            stale = 1;
+        }
+        free(children);
+    } else {
+        // Pas d'index sur disque : parcours complet de la table
+        InodeScan scan;
+        const Inode *child;
+        uint32_t i;
+        inode_scan_open(fs, &scan);
+        while ((child = inode_scan_next(&scan, &i)) != NULL) {
+            if (i != ROOT_INODE && i != fs->sb.snapshot_dir && child->type != INODE_FREE &&
+                !inode_is_shared(child) && child->parent == dir && dir_index_push(di, i) != 0) {
+                break;
+            }
+        }
+        inode_scan_close(&scan);
+        if (child || scan.failed) {
+            dir_index_free(di);
+            return NULL;
+        }
+        stale = 1;
+    }
+
+    di->dirty = stale;
+    fs->dirs[dir] = di;
+    return di;
+}
+
+static int dir_index_add(FileSystem *fs, uint32_t dir, uint32_t child) {
+    DirIndex *di = dir_index_get(fs, dir);
+    if (!di || dir_index_push(di, child) != 0) {
+        fprintf(stderr, "Avertissement : index du répertoire %u non mis à jour\n", dir);
+        return -1;
+    }
+    return 0;
+}
+
+static void dir_index_remove(FileSystem *fs, uint32_t dir, uint32_t child) {
+    DirIndex *di = dir_index_get(fs, dir);
+    if (!di) return;
+    for (uint32_t k = 0; k < di->count; k++) {
+        if (di->children[k] == child) {
+            memmove(&di->children[k], &di->children[k + 1], (di->count - k - 1) * sizeof(uint32_t));
+            di->count--;
+            di->dirty = 1;
+            return;
+        }
+    }
+}
+
+// Index vide pour un repertoire qui vient d'etre cree
+static int dir_index_create(FileSystem *fs, uint32_t dir) {
+    if (dir >= fs->dirs_capacity) return -1;
+    dir_index_free(fs->dirs[dir]);
+    fs->dirs[dir] = dir_index_new();
+    if (!fs->dirs[dir]) return -1;
+    fs->dirs[dir]->dirty = 1;
+    return 0;
+}
+
+// Ecrit l'index dans les donnees du repertoire. La zone n'est reallouee que
+// si elle est trop petite, avec une marge pour les ajouts suivants.
+static void dir_index_save(FileSystem *fs, uint32_t dir, const DirIndex *di) {
+    Inode *inode = get_inode(fs, (int)dir);
+    if (inode->type != INODE_DIR) return;
+
+    // Repertoire vide : sa zone est rendue, sinon elle resterait en fin de
+    // donnees sans qu'aucun contenu ne puisse la deplacer
+    if (di->count == 0) {
+        inode_free_data(fs, inode);
+        inode->flags |= INODE_FLAG_DIR_INDEX;
+        mark_inode_dirty(fs, inode);
+        return;
+    }
+
+    uint64_t needed = (uint64_t)di->count * sizeof(uint32_t);
+    ExtentList list;
+    if (inode_load_extents(fs, inode, &list) != 0) {
+        // Extents illisibles : l'ancienne zone est perdue
+        inode->extent_count = 0;
+        inode->extent_block = 0;
+        list.items = NULL;
+        list.count = list.capacity = 0;
+    }
+
+    uint64_t allocated = 0;
+    for (uint32_t e = 0; e < list.count; e++) allocated += list.items[e].length;
+
+    int in_place = 1;
+    if (needed > allocated) {
+        in_place = 0;
+        extent_list_free(&list);
+        inode_free_data(fs, inode);
+        if (alloc_blocks(fs, blocks_for_size(needed + needed / 2), &list) != 0 ||
+            inode_store_extents(fs, inode, &list) != 0) {
+            fprintf(stderr, "Erreur : écriture de l'index du répertoire %u impossible\n", dir);
+            free_extent_list(fs, &list);
+            extent_list_free(&list);
+            inode->extent_count = 0;
+            inode->extent_block = 0;
+            inode->flags &= ~INODE_FLAG_DIR_INDEX;
+            mark_inode_dirty(fs, inode);
+            return;
+        }
+    }
+
+    if (needed > 0 && extents_write(fs, &list, di->children, needed, in_place) != 0) {
+        fprintf(stderr, "Erreur : écriture de l'index du répertoire %u impossible\n", dir);
+        inode->flags &= ~INODE_FLAG_DIR_INDEX;
+    } else {
+        inode->flags |= INODE_FLAG_DIR_INDEX;
+    }
+    inode->size = needed;
+    mark_inode_dirty(fs, inode);
+    extent_list_free(&list);
+}
+
+static void dir_index_save_all(FileSystem *fs) {
+    for (uint32_t i = 0; i < fs->dirs_capacity; i++) {
+        if (fs->dirs[i] && fs->dirs[i]->dirty) {
+            dir_index_save(fs, i, fs->dirs[i]);
+            fs->dirs[i]->dirty = 0;
+        }
+    }
+}
+
+int fs_dir_open(FileSystem *fs, int dir_index, FsDirIter *iter) {
+    iter->fs = NULL;
+    iter->children = NULL;
+    iter->count = 0;
+    iter->pos = 0;
+
+    if (dir_index < 0) return -1;
+    DirIndex *di = dir_index_get(fs, (uint32_t)dir_index);
+    if (!di) return -1;
+
+    if (di->count > 0) {
+        iter->children = malloc(di->count * sizeof(uint32_t));
+        if (!iter->children) return -1;
+        memcpy(iter->children, di->children, di->count * sizeof(uint32_t));
+    }
+    iter->count = di->count;
+    iter->fs = fs;
+    fs_cache_scan_begin(fs);
+    return 0;
+}
+
+int fs_dir_next(FsDirIter *iter) {
+    if (iter->pos >= iter->count) return -1;
+    return (int)iter->children[iter->pos++];
+}
+
+void fs_dir_close(FsDirIter *iter) {
+    if (iter->fs) fs_cache_scan_end(iter->fs);
+    iter->fs = NULL;
+    free(iter->children);
+    iter->children = NULL;
+    iter->count = 0;
+    iter->pos = 0;
+}
+
+int fs_mkdir(FileSystem *fs, const char *path) {
+    char *normalized = normalize_path(path);
+    char parent_path[MAX_PATH];
+    char dirname[MAX_FILENAME];
+
+    extract_parent_path(normalized, parent_path, MAX_PATH);
+    extract_filename(normalized, dirname, MAX_FILENAME);
+
+    if (path_exists(fs, normalized, NULL) >= 0) {
+        fprintf(stderr, "Erreur : '%s' existe déjà\n", normalized);
+        free(normalized);
+        return -1;
+    }
+
+    int parent = parent_index(fs, parent_path);
+    if (parent == -1) {
+        fprintf(stderr, "Erreur : le répertoire parent '%s' n'existe pas\n", parent_path);
+        free(normalized);
+        return -1;
+    }
+    if (snapshot_refuse(fs, parent, normalized) != 0) {
+        free(normalized);
+        return -1;
+    }
+
+    int idx = find_free_inode(fs);
+    if (idx == -1) {
+        fprintf(stderr, "Erreur : pas d'inode disponible\n");
+        free(normalized);
+        return -1;
+    }
+
+    uint64_t name = name_heap_add(&fs->names, dirname);
+    if (name == 0) {
+        fprintf(stderr, "Erreur : mémoire insuffisante\n");
+        free(normalized);
+        return -1;
+    }
+
+    // La politique de compression se transmet aux sous-repertoires
+    uint16_t flags = get_inode(fs, parent)->flags & INODE_FLAG_COMPRESS;
+
+    Inode *inode = get_inode(fs, idx);
+    memset(inode, 0, sizeof(Inode));
+    inode->type = INODE_DIR;
+    inode->flags = flags;
+    inode->parent = (uint32_t)parent;
+    inode->name_offset = name;
+    inode->size = 0;
+    inode->created = time(NULL);
+    inode->modified = inode->created;
+    inode->accessed = inode->created;
+    inode->uid = getuid();
+    inode->gid = getgid();
+    inode->mode = 0755;
+    inode->link_count = 1;
+    mark_inode_dirty(fs, inode);
+
+    fs->sb.num_files++;
+    inode_mark_used(fs, idx);
+
+    // Ajouter a la hash table pour acces O(1)
+    hash_table_insert(fs, (uint32_t)parent, name, idx);
+    dir_index_add(fs, (uint32_t)parent, (uint32_t)idx);
+    if (dir_index_create(fs, (uint32_t)idx) != 0) {
+        fprintf(stderr, "Avertissement : index du répertoire '%s' non créé\n", normalized);
+    }
+
+    printf("Répertoire créé : %s\n", normalized);
+    free(normalized);
+    journal_op_end(fs);
+    return 0;
+}
+
+// Ecrit le contenu de src (size octets) dans de nouveaux blocs, dont data
+// recoit les extents : compresse si compress et s'il y gagne, deduplique en
+// mode dedup, suivi de la table des sommes. En cas d'echec, rien ne reste
+// alloue.
+static int file_write_data(FileSystem *fs, FILE *src, const char *source_path, uint64_t size,
+                           int compress, ExtentList *data, int *compressed, uint64_t *shared,
+                           uint32_t *checksum_block) {
+    // Les sommes de controle sont calculees au fil de la lecture du fichier
+    ChecksumBuilder sums;
+    checksum_begin(fs, &sums);
+    DataSource source = { src, NULL, &sums };
+
+    // Repertoire compresse : le fichier l'est aussi, s'il y gagne
+    *compressed = 0;
+    if (compress) {
+        int ret = compress_write(fs, &source, size, data);
+        if (ret < 0) {
+            fprintf(stderr, "Erreur : compression de '%s' impossible\n", source_path);
+            checksum_end(&sums);
+            return -1;
+        }
+        *compressed = ret == 0;
+    }
+
+    // Mode deduplique : les blocs deja presents sont partages
+    *shared = 0;
+    int written = *compressed;
+    if (!written && (fs->sb.flags & SB_FLAG_DEDUP)) {
+        if (dedup_write(fs, &source, size, data, shared) != 0) {
+            fprintf(stderr, "Erreur : écriture de '%s' impossible\n", source_path);
+            checksum_end(&sums);
+            return -1;
+        }
+        written = 1;
+    }
+
+    // Les blocs libres sont reutilises meme s'ils ne sont pas contigus :
+    // le fichier est alors decrit par plusieurs extents
+    if (!written && alloc_blocks(fs, blocks_for_size(size), data) != 0) {
+        fprintf(stderr, "Erreur : allocation des blocs impossible\n");
+        free_extent_list(fs, data);
+        extent_list_free(data);
+        checksum_end(&sums);
+        return -1;
+    }
+
+    *checksum_block = 0;
+    if ((!written && source_write_extents(fs, &source, size, data) != 0) ||
+        (size > 0 && checksum_store(fs, &sums, size, data, checksum_block) != 0)) {
+        fprintf(stderr, "Erreur : écriture de '%s' impossible\n", source_path);
+        free_extent_list(fs, data);
+        extent_list_free(data);
+        checksum_end(&sums);
+        return -1;
+    }
+    checksum_end(&sums);
+    return 0;
+}
+
+int fs_add_file(FileSystem *fs, const char *fs_path, const char *source_path) {
+    FILE *src = fopen(source_path, "rb");
+    if (!src) {
+        perror("Impossible d'ouvrir le fichier source");
+        return -1;
+    }
+
+    char *normalized = normalize_path(fs_path);
+    char parent_path[MAX_PATH];
+    char filename[MAX_FILENAME];
+
+    extract_parent_path(normalized, parent_path, MAX_PATH);
+    extract_filename(normalized, filename, MAX_FILENAME);
+
+    if (path_exists(fs, normalized, NULL) >= 0) {
+        fprintf(stderr, "Erreur : '%s' existe déjà\n", normalized);
+        fclose(src);
+        free(normalized);
+        return -1;
+    }
+
+    int parent = parent_index(fs, parent_path);
+    if (parent == -1) {
+        fprintf(stderr, "Erreur : le répertoire parent '%s' n'existe pas\n", parent_path);
+        fclose(src);
+        free(normalized);
+        return -1;
+    }
+    if (snapshot_refuse(fs, parent, normalized) != 0) {
+        fclose(src);
+        free(normalized);
+        return -1;
+    }
+
+    fseeko(src, 0, SEEK_END);
+    uint64_t size = (uint64_t)ftello(src);
+    fseeko(src, 0, SEEK_SET);
+
+    // L'inode est reserve avant les blocs : une extension de la table
+    // d'inodes ne doit pas recouvrir des blocs deja pris pour ce fichier
+    int idx = find_free_inode(fs);
+    if (idx == -1) {
+        fclose(src);
+        fprintf(stderr, "Erreur : pas d'inode disponible\n");
+        free(normalized);
+        return -1;
+    }
+
+    ExtentList data = {0};
+    int compressed = 0;
+    uint64_t shared = 0;
+    uint32_t checksum_block = 0;
+    int compress = (get_inode(fs, parent)->flags & INODE_FLAG_COMPRESS) != 0;
+    if (file_write_data(fs, src, source_path, size, compress, &data, &compressed, &shared,
+                        &checksum_block) != 0) {
+        fclose(src);
+        free(normalized);
+        return -1;
+    }
+    fclose(src);
+
+    uint64_t name = name_heap_add(&fs->names, filename);
+    if (name == 0) {
+        fprintf(stderr, "Erreur : mémoire insuffisante\n");
+        free_extent_list(fs, &data);
+        extent_list_free(&data);
+        free(normalized);
+        return -1;
+    }
+
+    Inode *inode = get_inode(fs, idx);
+    memset(inode, 0, sizeof(Inode));
+    inode->type = INODE_FILE;
+    inode->parent = (uint32_t)parent;
+    inode->name_offset = name;
+    inode->size = size;
+    inode->created = time(NULL);
+    inode->modified = inode->created;
+    inode->accessed = inode->created;
+    inode->uid = getuid();
+    inode->gid = getgid();
+    inode->mode = 0644;
+    inode->link_count = 1;
+    if (compressed) inode->flags |= INODE_FLAG_COMPRESSED;
+    if (size > 0) {
+        inode->flags |= INODE_FLAG_CHECKSUM;
+        inode->checksum_block = checksum_block;
+    }
+
+    if (inode_store_extents(fs, inode, &data) != 0) {
+        fprintf(stderr, "Erreur : écriture des extents impossible\n");
+        free_extent_list(fs, &data);
+        extent_list_free(&data);
+        name_heap_release(&fs->names, name);
+        memset(inode, 0, sizeof(Inode));
+        free(normalized);
+        return -1;
+    }
+    mark_inode_dirty(fs, inode);
+    extent_list_free(&data);
+
+    fs->sb.num_files++;
+    inode_mark_used(fs, idx);
+
+    // Ajouter a la hash table pour acces O(1)
+    hash_table_insert(fs, (uint32_t)parent, name, idx);
+    dir_index_add(fs, (uint32_t)parent, (uint32_t)idx);
+
+    if (shared > 0) {
+        printf("Fichier ajouté : %s (%lu octets, %llu partagés)\n", normalized, (unsigned long)size,
+               (unsigned long long)shared);
+    } else {
+        printf("Fichier ajouté : %s (%lu octets%s)\n", normalized, (unsigned long)size,
+               compressed ? ", compressé" : "");
+    }
+    free(normalized);
+    journal_op_end(fs);
+    return 0;
+}
+
+int fs_write_file(FileSystem *fs, const char *fs_path, const char *source_path) {
+    FILE *src = fopen(source_path, "rb");
+    if (!src) {
+        perror("Impossible d'ouvrir le fichier source");
+        return -1;
+    }
+
+    char *normalized = normalize_path(fs_path);
+    int entry = hash_table_resolve_entry(fs, normalized);
+    int idx = fs_link_target(fs, entry);
+    if (idx == -1) {
+        fprintf(stderr, "Erreur : fichier '%s' introuvable\n", normalized);
+        fclose(src);
+        free(normalized);
+        return -1;
+    }
+    if (get_inode(fs, idx)->type != INODE_FILE) {
+        fprintf(stderr, "Erreur : '%s' est un répertoire, pas un fichier\n", normalized);
+        fclose(src);
+        free(normalized);
+        return -1;
+    }
+    if (snapshot_refuse(fs, entry, normalized) != 0) {
+        fclose(src);
+        free(normalized);
+        return -1;
+    }
+
+    fseeko(src, 0, SEEK_END);
+    uint64_t size = (uint64_t)ftello(src);
+    fseeko(src, 0, SEEK_SET);
+
+    // Un fichier compresse le reste, comme un ajout sous un repertoire compresse
+    int compress = (get_inode(fs, idx)->flags & INODE_FLAG_COMPRESSED) ||
+                   (get_inode(fs, (int)get_inode(fs, entry)->parent)->flags & INODE_FLAG_COMPRESS);
+
+    // Le nouveau contenu est ecrit a part : l'ancien reste valide jusqu'a la
+    // transaction, comme pour compress
+    ExtentList data = {0};
+    int compressed = 0;
+    uint64_t shared = 0;
+    uint32_t checksum_block = 0;
+    if (file_write_data(fs, src, source_path, size, compress, &data, &compressed, &shared,
+                        &checksum_block) != 0) {
+        fclose(src);
+        free(normalized);
+        return -1;
+    }
+    fclose(src);
+
+    // Nouveaux extents ranges sur une copie : en cas d'echec, l'inode garde
+    // son ancien contenu. Celui-ci n'est libere qu'ensuite.
+    Inode old = *get_inode(fs, idx);
+    Inode updated = old;
+    updated.size = size;
+    if (inode_store_extents(fs, &updated, &data) != 0) {
+        fprintf(stderr, "Erreur : écriture des extents impossible\n");
+        free_extent_list(fs, &data);
+        extent_list_free(&data);
+        free(normalized);
+        return -1;
+    }
+    extent_list_free(&data);
+    inode_free_data(fs, &old);
+    updated.flags &= ~(INODE_FLAG_COMPRESSED | INODE_FLAG_CHECKSUM);
+    if (compressed) updated.flags |= INODE_FLAG_COMPRESSED;
+    updated.checksum_block = checksum_block;
+    if (size > 0) updated.flags |= INODE_FLAG_CHECKSUM;
+    updated.modified = time(NULL);
+    Inode *inode = get_inode(fs, idx);
+    *inode = updated;
+    mark_inode_dirty(fs, inode);
+
+    printf("Fichier écrit : %s (%lu octets%s)\n", normalized, (unsigned long)size,
+           compressed ? ", compressé" : "");
+    free(normalized);
+    journal_op_end(fs);
+    return 0;
+}
+
+int fs_extract_file(FileSystem *fs, const char *fs_path, const char *dest_path) {
+    char *normalized = normalize_path(fs_path);
+
+    int idx = path_exists(fs, normalized, NULL);
+    if (idx == -1) {
+        fprintf(stderr, "Erreur : fichier '%s' introuvable\n", normalized);
+        free(normalized);
+        return -1;
+    }
+
+    Inode *inode = get_inode(fs, idx);
+    if (!inode || inode->type != INODE_FILE) {
+        fprintf(stderr, "Erreur : '%s' est un répertoire, pas un fichier\n", normalized);
+        free(normalized);
+        return -1;
+    }
+    
+    inode->accessed = time(NULL);
+    mark_inode_dirty(fs, inode);
+
+    FsReader reader;
+    if (fs_reader_open(fs, inode, &reader) != 0) {
+        free(normalized);
+        return -1;
+    }
+
+    FILE *dest = fopen(dest_path, "wb");
+    if (!dest) {
+        perror("Impossible de créer le fichier de destination");
+        fs_reader_close(&reader);
+        free(normalized);
+        return -1;
+    }
+
+    const void *mapped;
+    size_t mapped_len;
+    while ((mapped = fs_reader_map(&reader, &mapped_len)) != NULL) {
+        fwrite(mapped, 1, mapped_len, dest);
+    }
+
+    char buffer[BLOCK_SIZE];
+    size_t bytes_read;
+    while ((bytes_read = fs_reader_read(&reader, buffer, BLOCK_SIZE)) > 0) {
+        fwrite(buffer, 1, bytes_read, dest);
+    }
+
+    // Lecture interrompue (morceau illisible, ou bloc corrompu en mode
+    // strict) : pas de copie partielle
+    int stopped = reader.remaining > 0;
+    fs_reader_close(&reader);
+    fclose(dest);
+    if (stopped) {
+        unlink(dest_path);
+        fprintf(stderr, "Erreur : '%s' est illisible ou corrompu, extraction annulée\n", normalized);
+        free(normalized);
+        journal_op_end(fs);
+        return -1;
+    }
+    printf("Fichier extrait : %s -> %s\n", normalized, dest_path);
+    free(normalized);
+    journal_op_end(fs);
+    return 0;
+}
+
+// Retire la reference ajoutee aux count premiers extents d'un clone. La
+// source les reference encore : rien n'est libere.
+static void clone_drop(FileSystem *fs, const ExtentList *data, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        refmap_drop(&fs->ref_map, data->items[i].offset, data->items[i].length, NULL, NULL);
+    }
+}
+
+int fs_copy_file(FileSystem *fs, const char *src_path, const char *dest_path) {
+    char *normalized_src = normalize_path(src_path);
+    char *normalized_dest = normalize_path(dest_path);
+
+    // Utiliser hash table pour recherche rapide
+    int src_idx = hash_table_resolve(fs, normalized_src);
+
+    if (src_idx == -1) {
+        fprintf(stderr, "Erreur : fichier source '%s' introuvable\n", normalized_src);
+        free(normalized_src);
+        free(normalized_dest);
+        return -1;
     }
 
     Inode *src_inode_ptr = get_inode(fs, src_idx);
-    if (src_inode_ptr->is_directory) {
+    if (src_inode_ptr->type != INODE_FILE) {
         fprintf(stderr, "Erreur : '%s' est un répertoire, pas un fichier\n", normalized_src);
         free(normalized_src);
         free(normalized_dest);
         return -1;
     }
-    // Copie de l'inode car src_inode_ptr peut être invalidé par get_inode(fs, dest_idx)
-    Inode src_inode_val = *src_inode_ptr;
-
-    if (path_exists(fs, normalized_dest, NULL) >= 0) {
-        fprintf(stderr, "Erreur : '%s' existe déjà\n", normalized_dest);
-        free(normalized_src);
-        free(normalized_dest);
+    // Copie de l'inode car src_inode_ptr peut être invalidé par get_inode(fs, dest_idx)
+    Inode src_inode_val = *src_inode_ptr;
+
+    if (path_exists(fs, normalized_dest, NULL) >= 0) {
+        fprintf(stderr, "Erreur : '%s' existe déjà\n", normalized_dest);
+        free(normalized_src);
+        free(normalized_dest);
+        return -1;
+    }
+
+    char parent_path[MAX_PATH];
+    char filename[MAX_FILENAME];
+    extract_parent_path(normalized_dest, parent_path, MAX_PATH);
+    extract_filename(normalized_dest, filename, MAX_FILENAME);
+
+    int parent = parent_index(fs, parent_path);
+    if (parent == -1) {
+        fprintf(stderr, "Erreur : le répertoire parent '%s' n'existe pas\n", parent_path);
+        free(normalized_src);
+        free(normalized_dest);
+        return -1;
+    }
+    if (snapshot_refuse(fs, parent, normalized_dest) != 0) {
+        free(normalized_src);
+        free(normalized_dest);
+        return -1;
+    }
+
+    int dest_idx = find_free_inode(fs);
+    if (dest_idx == -1) {
+        fprintf(stderr, "Erreur : pas d'inode disponible\n");
+        free(normalized_src);
+        free(normalized_dest);
+        return -1;
+    }
+
+    // Clone : la copie designe les extents de la source, table des sommes
+    // comprise, et chacun recoit une reference de plus. Aucune donnee n'est
+    // lue ni ecrite ; une ecriture ulterieure dans l'un ou l'autre fichier
+    // se fait toujours dans des blocs neufs, et la zone partagee n'est
+    // liberee qu'avec sa derniere reference.
+    ExtentList data;
+    if (inode_load_extents(fs, &src_inode_val, &data) != 0) {
+        fprintf(stderr, "Erreur : lecture des extents de '%s' impossible\n", normalized_src);
+        free(normalized_src);
+        free(normalized_dest);
+        return -1;
+    }
+    for (uint32_t i = 0; i < data.count; i++) {
+        if (refmap_add(&fs->ref_map, data.items[i].offset, data.items[i].length) != 0) {
+            clone_drop(fs, &data, i);
+            fprintf(stderr, "Erreur : mémoire insuffisante\n");
+            extent_list_free(&data);
+            free(normalized_src);
+            free(normalized_dest);
+            return -1;
+        }
+    }
+    if (data.count > 0) fs->ref_map_changed = 1;
+
+    uint64_t name = name_heap_add(&fs->names, filename);
+    if (name == 0) {
+        fprintf(stderr, "Erreur : mémoire insuffisante\n");
+        clone_drop(fs, &data, data.count);
+        extent_list_free(&data);
+        free(normalized_src);
+        free(normalized_dest);
+        return -1;
+    }
+
+    Inode *dest_inode = get_inode(fs, dest_idx);
+    memset(dest_inode, 0, sizeof(Inode));
+    dest_inode->type = INODE_FILE;
+    dest_inode->parent = (uint32_t)parent;
+    dest_inode->name_offset = name;
+    dest_inode->size = src_inode_val.size;
+    dest_inode->created = time(NULL);
+    dest_inode->modified = dest_inode->created;
+    dest_inode->accessed = dest_inode->created;
+    dest_inode->uid = getuid();
+    dest_inode->gid = getgid();
+    dest_inode->mode = src_inode_val.mode;
+    dest_inode->link_count = 1;
+    dest_inode->flags = src_inode_val.flags & (INODE_FLAG_COMPRESSED | INODE_FLAG_CHECKSUM);
+    dest_inode->checksum_block = src_inode_val.checksum_block;
+
+    if (inode_store_extents(fs, dest_inode, &data) != 0) {
+        fprintf(stderr, "Erreur : écriture des extents impossible\n");
+        clone_drop(fs, &data, data.count);
+        extent_list_free(&data);
+        name_heap_release(&fs->names, name);
+        memset(dest_inode, 0, sizeof(Inode));
+        free(normalized_src);
+        free(normalized_dest);
+        return -1;
+    }
+    extent_list_free(&data);
+    mark_inode_dirty(fs, dest_inode);
+
+    fs->sb.num_files++;
+    inode_mark_used(fs, dest_idx);
+
+    if (src_inode_val.extent_count > 0) {
+        printf("Fichier copié : %s -> %s (%lu octets, partagés avec la source)\n", normalized_src,
+               normalized_dest, (unsigned long)src_inode_val.size);
+    } else {
+        printf("Fichier copié : %s -> %s (%lu octets)\n", normalized_src, normalized_dest,
+               (unsigned long)src_inode_val.size);
+    }
+    
+    // Ajouter a la hash table pour acces O(1)
+    hash_table_insert(fs, (uint32_t)parent, name, dest_idx);
+    dir_index_add(fs, (uint32_t)parent, (uint32_t)dest_idx);
+    
+    free(normalized_src);
+    free(normalized_dest);
+    journal_op_end(fs);
+    return 0;
+}
+
+int fs_move_file(FileSystem *fs, const char *src_path, const char *dest_path) {
+    char *normalized_src = normalize_path(src_path);
+    char *normalized_dest = normalize_path(dest_path);
+
+    // Le nom deplace, lien compris
+    int src_idx = hash_table_resolve_entry(fs, normalized_src);
+
+    if (src_idx == -1) {
+        fprintf(stderr, "Erreur : '%s' introuvable\n", normalized_src);
+        free(normalized_src);
+        free(normalized_dest);
+        return -1;
+    }
+
+    if (src_idx == ROOT_INODE) {
+        fprintf(stderr, "Erreur : impossible de déplacer la racine\n");
+        free(normalized_src);
+        free(normalized_dest);
+        return -1;
+    }
+    if (snapshot_refuse(fs, src_idx, normalized_src) != 0) {
+        free(normalized_src);
+        free(normalized_dest);
+        return -1;
+    }
+
+    if (path_exists(fs, normalized_dest, NULL) >= 0) {
+        fprintf(stderr, "Erreur : '%s' existe déjà\n", normalized_dest);
+        free(normalized_src);
+        free(normalized_dest);
+        return -1;
+    }
+
+    char parent_path[MAX_PATH];
+    char filename[MAX_FILENAME];
+    extract_parent_path(normalized_dest, parent_path, MAX_PATH);
+    extract_filename(normalized_dest, filename, MAX_FILENAME);
+
+    int parent = parent_index(fs, parent_path);
+    if (parent == -1) {
+        fprintf(stderr, "Erreur : le répertoire parent '%s' n'existe pas\n", parent_path);
+        free(normalized_src);
+        free(normalized_dest);
+        return -1;
+    }
+    if (snapshot_refuse(fs, parent, normalized_dest) != 0) {
+        free(normalized_src);
+        free(normalized_dest);
+        return -1;
+    }
+
+    // Un répertoire ne peut pas être déplacé sous lui-même
+    for (uint32_t p = (uint32_t)parent, depth = 0; depth < MAX_DEPTH; depth++) {
+        if (p == (uint32_t)src_idx) {
+            fprintf(stderr, "Erreur : impossible de déplacer '%s' dans lui-même\n", normalized_src);
+            free(normalized_src);
+            free(normalized_dest);
+            return -1;
+        }
+        if (p == ROOT_INODE) break;
+        Inode ancestor;
+        read_inode_current(fs, (int)p, &ancestor);
+        p = ancestor.parent;
+    }
+
+    uint64_t name = name_heap_add(&fs->names, filename);
+    if (name == 0) {
+        fprintf(stderr, "Erreur : mémoire insuffisante\n");
+        free(normalized_src);
+        free(normalized_dest);
+        return -1;
+    }
+
+    // Seul l'inode déplacé change : les enfants d'un répertoire désignent
+    // leur parent par son numéro
+    Inode *src_inode = get_inode(fs, src_idx);
+    int is_dir = src_inode->type == INODE_DIR;
+    uint32_t old_parent = src_inode->parent;
+    hash_table_delete(fs, old_parent, fs_inode_name(fs, src_inode));
+    name_heap_release(&fs->names, src_inode->name_offset);
+    src_inode->name_offset = name;
+    src_inode->parent = (uint32_t)parent;
+    src_inode->modified = time(NULL);
+    mark_inode_dirty(fs, src_inode);
+    hash_table_insert(fs, (uint32_t)parent, name, src_idx);
+    if (old_parent != (uint32_t)parent) {
+        dir_index_remove(fs, old_parent, (uint32_t)src_idx);
+        dir_index_add(fs, (uint32_t)parent, (uint32_t)src_idx);
+    }
+
+    if (!is_dir) {
+        printf("Déplacé : %s -> %s\n", normalized_src, normalized_dest);
+    } else {
+        // Les chemins en cache du sous-arbre ne sont plus valables
+        dentry_cache_invalidate(fs);
+        printf("Répertoire déplacé : %s -> %s\n", normalized_src, normalized_dest);
+    }
+
+    free(normalized_src);
+    free(normalized_dest);
+    journal_op_end(fs);
+    return 0;
+}
+
+// Premier lien du fichier entry : son contenu (donnees, taille, sommes,
+// dates) passe dans un inode sans nom et l'entree devient un lien vers lui.
+// Le numero de l'entree ne change pas : l'index des entrees, la liste de son
+// repertoire et un parcours en cours restent valables. Retourne l'inode du
+// contenu, -1 si aucun n'est libre.
+static int link_share(FileSystem *fs, int entry) {
+    int data = find_free_inode(fs);
+    if (data == -1) return -1;
+
+    Inode file = *get_inode(fs, entry);
+    Inode *shared = get_inode(fs, data);
+    *shared = file;
+    shared->flags |= INODE_FLAG_SHARED;
+    shared->parent = ROOT_INODE;
+    shared->name_offset = 0;
+    shared->link_count = 1;
+    mark_inode_dirty(fs, shared);
+    fs->sb.num_files++;
+    inode_mark_used(fs, data);
+
+    Inode *link = get_inode(fs, entry);
+    link->type = INODE_LINK;
+    link->flags = 0;
+    link->link_count = 0;
+    link->target = (uint32_t)data;
+    link->size = 0;
+    link->extent_count = 0;
+    link->extent_block = 0;
+    memset(link->extents, 0, sizeof(link->extents));
+    mark_inode_dirty(fs, link);
+    return data;
+}
+
+// Libere un fichier lie qui n'a plus de nom, donnees comprises
+static void shared_free(FileSystem *fs, int idx) {
+    Inode *inode = get_inode(fs, idx);
+    inode_free_data(fs, inode);
+    inode = get_inode(fs, idx);
+    memset(inode, 0, sizeof(Inode));
+    mark_inode_dirty(fs, inode);
+    fs->sb.num_files--;
+    inode_mark_free(fs, idx);
+}
+
+// Un nom de moins pour le fichier lie target
+static void link_release(FileSystem *fs, uint32_t target) {
+    if (target >= fs->sb.max_files) return;
+    Inode *file = get_inode(fs, (int)target);
+    if (!inode_is_shared(file)) return;
+    if (file->link_count > 1) {
+        file->link_count--;
+        mark_inode_dirty(fs, file);
+        return;
+    }
+    shared_free(fs, (int)target);
+}
+
+int fs_link(FileSystem *fs, const char *target_path, const char *link_path) {
+    char *normalized_target = normalize_path(target_path);
+    char *normalized_link = normalize_path(link_path);
+
+    // Un lien vers un lien designe le meme fichier
+    int target = hash_table_resolve(fs, normalized_target);
+    if (target == -1) {
+        fprintf(stderr, "Erreur : '%s' introuvable\n", normalized_target);
+        free(normalized_target);
+        free(normalized_link);
+        return -1;
+    }
+    if (get_inode(fs, target)->type != INODE_FILE) {
+        fprintf(stderr, "Erreur : '%s' est un répertoire, pas un fichier\n", normalized_target);
+        free(normalized_target);
+        free(normalized_link);
+        return -1;
+    }
+    // Le compteur de noms du fichier changerait
+    if (snapshot_refuse(fs, target, normalized_target) != 0) {
+        free(normalized_target);
+        free(normalized_link);
+        return -1;
+    }
+
+    if (path_exists(fs, normalized_link, NULL) >= 0) {
+        fprintf(stderr, "Erreur : '%s' existe déjà\n", normalized_link);
+        free(normalized_target);
+        free(normalized_link);
+        return -1;
+    }
+
+    char parent_path[MAX_PATH];
+    char filename[MAX_FILENAME];
+    extract_parent_path(normalized_link, parent_path, MAX_PATH);
+    extract_filename(normalized_link, filename, MAX_FILENAME);
+
+    int parent = parent_index(fs, parent_path);
+    if (parent == -1) {
+        fprintf(stderr, "Erreur : le répertoire parent '%s' n'existe pas\n", parent_path);
+        free(normalized_target);
+        free(normalized_link);
+        return -1;
+    }
+    if (snapshot_refuse(fs, parent, normalized_link) != 0) {
+        free(normalized_target);
+        free(normalized_link);
+        return -1;
+    }
+
+    // Premier lien : le nom d'origine devient un lien comme les autres
+    if (!inode_is_shared(get_inode(fs, target))) target = link_share(fs, target);
+    int idx = target == -1 ? -1 : find_free_inode(fs);
+    if (idx == -1) {
+        fprintf(stderr, "Erreur : pas d'inode disponible\n");
+        free(normalized_target);
+        free(normalized_link);
+        return -1;
+    }
+
+    uint64_t name = name_heap_add(&fs->names, filename);
+    if (name == 0) {
+        fprintf(stderr, "Erreur : mémoire insuffisante\n");
+        free(normalized_target);
+        free(normalized_link);
+        return -1;
+    }
+
+    Inode file = *get_inode(fs, target);
+    Inode *link = get_inode(fs, idx);
+    memset(link, 0, sizeof(Inode));
+    link->type = INODE_LINK;
+    link->parent = (uint32_t)parent;
+    link->name_offset = name;
+    link->target = (uint32_t)target;
+    link->created = time(NULL);
+    link->modified = link->created;
+    link->accessed = link->created;
+    link->uid = file.uid;
+    link->gid = file.gid;
+    link->mode = file.mode;
+    mark_inode_dirty(fs, link);
+
+    Inode *target_inode = get_inode(fs, target);
+    target_inode->link_count++;
+    uint32_t names = target_inode->link_count;
+    mark_inode_dirty(fs, target_inode);
+
+    fs->sb.num_files++;
+    inode_mark_used(fs, idx);
+    hash_table_insert(fs, (uint32_t)parent, name, idx);
+    dir_index_add(fs, (uint32_t)parent, (uint32_t)idx);
+
+    printf("Lien créé : %s -> %s (%u noms)\n", normalized_link, normalized_target, names);
+
+    free(normalized_target);
+    free(normalized_link);
+    journal_op_end(fs);
+    return 0;
+}
+
+// Supprime l'entree idx (path ne sert qu'aux messages). Un repertoire doit
+// etre vide.
+static int entry_remove(FileSystem *fs, int idx, const char *path) {
+    Inode *inode = get_inode(fs, idx);
+    int is_dir = inode->type == INODE_DIR;
+    if (inode->type == INODE_LINK) {
+        // Les donnees partent avec le dernier nom
+        link_release(fs, inode->target);
+        inode = get_inode(fs, idx);
+    } else if (is_dir) {
+        DirIndex *di = dir_index_get(fs, (uint32_t)idx);
+        if (!di || di->count > 0) {
+            fprintf(stderr, "Erreur : le répertoire '%s' n'est pas vide\n", path);
+            return -1;
+        }
+        dir_index_free(di);
+        fs->dirs[idx] = NULL;
+        inode = get_inode(fs, idx);
+        inode_free_data(fs, inode);
+    } else {
+        inode_free_data(fs, inode);
+    }
+
+    dir_index_remove(fs, inode->parent, (uint32_t)idx);
+    inode = get_inode(fs, idx);
+    hash_table_delete(fs, inode->parent, fs_inode_name(fs, inode));
+    name_heap_release(&fs->names, inode->name_offset);
+    memset(inode, 0, sizeof(Inode));
+    mark_inode_dirty(fs, inode);
+    fs->sb.num_files--;
+    inode_mark_free(fs, idx);
+    if (is_dir) dentry_cache_invalidate(fs);
+    return 0;
+}
+
+int fs_remove(FileSystem *fs, const char *path) {
+    char *normalized = normalize_path(path);
+
+    if (strcmp(normalized, "/") == 0) {
+        fprintf(stderr, "Erreur : impossible de supprimer la racine\n");
+        free(normalized);
+        return -1;
+    }
+
+    int idx = hash_table_resolve_entry(fs, normalized);
+    if (idx == -1) {
+        fprintf(stderr, "Erreur : '%s' introuvable\n", normalized);
+        free(normalized);
+        return -1;
+    }
+    if (snapshot_refuse(fs, idx, normalized) != 0 || entry_remove(fs, idx, normalized) != 0) {
+        free(normalized);
+        return -1;
+    }
+
+    free(normalized);
+    journal_op_end(fs);
+    return 0;
+}
+
+int fs_set_compression(FileSystem *fs, const char *path, int enable) {
+    char *normalized = normalize_path(path);
+    int idx = hash_table_resolve(fs, normalized);
+    if (idx == -1) {
+        fprintf(stderr, "Erreur : '%s' introuvable\n", normalized);
+        free(normalized);
+        return -1;
+    }
+    if (snapshot_refuse(fs, idx, normalized) != 0) {
+        free(normalized);
         return -1;
     }
 
-    char parent_path[MAX_PATH];
-    char filename[MAX_FILENAME];
-    extract_parent_path(normalized_dest, parent_path, MAX_PATH);
-    extract_filename(normalized_dest, filename, MAX_FILENAME);
+    Inode *inode = get_inode(fs, idx);
+    if (inode->type == INODE_DIR) {
+        if (enable) {
+            inode->flags |= INODE_FLAG_COMPRESS;
+        } else {
+            inode->flags &= ~INODE_FLAG_COMPRESS;
+        }
+        mark_inode_dirty(fs, inode);
+        printf("Compression %s sous %s\n", enable ? "activée" : "désactivée", normalized);
+        free(normalized);
+        journal_op_end(fs);
+        return 0;
+    }
 
-    if (!parent_exists(fs, parent_path)) {
-        fprintf(stderr, "Erreur : le répertoire parent '%s' n'existe pas\n", parent_path);
-        free(normalized_src);
-        free(normalized_dest);
+    if (!(inode->flags & INODE_FLAG_COMPRESSED) == !enable) {
+        printf("%s est déjà %s\n", normalized, enable ? "compressé" : "en clair");
+        free(normalized);
+        return 0;
+    }
+
+    // Le nouveau contenu est ecrit a part : l'ancien reste valide jusqu'a la
+    // transaction, comme pour une copie
+    Inode src = *inode;
+    FsReader reader;
+    if (fs_reader_open(fs, &src, &reader) != 0) {
+        free(normalized);
+        return -1;
+    }
+    ChecksumBuilder sums;
+    checksum_begin(fs, &sums);
+    DataSource source = { NULL, &reader, &sums };
+    ExtentList data = {0};
+    int ret = 1;
+    if (enable) ret = compress_write(fs, &source, src.size, &data);
+    if (ret == 1 && (alloc_blocks(fs, blocks_for_size(src.size), &data) != 0 ||
+                     source_write_extents(fs, &source, src.size, &data) != 0)) {
+        ret = -1;
+    }
+    uint32_t checksum_block = 0;
+    if (ret >= 0 && !(enable && ret == 1) && src.size > 0 &&
+        checksum_store(fs, &sums, src.size, &data, &checksum_block) != 0) {
+        ret = -1;
+    }
+    checksum_end(&sums);
+    fs_reader_close(&reader);
+    if (ret < 0) {
+        fprintf(stderr, "Erreur : réécriture de '%s' impossible\n", normalized);
+        free_extent_list(fs, &data);
+        extent_list_free(&data);
+        free(normalized);
         return -1;
     }
+    if (enable && ret == 1) {
+        printf("%s ne gagne rien à être compressé : il reste en clair\n", normalized);
+        free_extent_list(fs, &data);
+        extent_list_free(&data);
+        free(normalized);
+        return 0;
+    }
 
-    int dest_idx = find_free_inode(fs);
-    if (dest_idx == -1) {
-        fprintf(stderr, "Erreur : pas d'inode disponible\n");
-        free(normalized_src);
-        free(normalized_dest);
+    // Nouveaux extents ranges sur une copie : en cas d'echec, l'inode garde
+    // son ancien contenu. Celui-ci n'est libere qu'ensuite.
+    Inode old = *get_inode(fs, idx);
+    Inode updated = old;
+    updated.size = src.size;
+    if (inode_store_extents(fs, &updated, &data) != 0) {
+        fprintf(stderr, "Erreur : écriture des extents impossible\n");
+        free_extent_list(fs, &data);
+        extent_list_free(&data);
+        free(normalized);
         return -1;
     }
+    inode_free_data(fs, &old);
+    if (enable) {
+        updated.flags |= INODE_FLAG_COMPRESSED;
+    } else {
+        updated.flags &= ~INODE_FLAG_COMPRESSED;
+    }
+    updated.flags &= ~INODE_FLAG_CHECKSUM;
+    updated.checksum_block = checksum_block;
+    if (src.size > 0) updated.flags |= INODE_FLAG_CHECKSUM;
+    inode = get_inode(fs, idx);
+    *inode = updated;
+    mark_inode_dirty(fs, inode);
 
-    uint64_t offset = find_data_end(fs);
+    uint64_t stored = 0;
+    for (uint32_t e = 0; e < data.count; e++) stored += data.items[e].length;
+    extent_list_free(&data);
+    printf("%s %s : %llu octets stockés pour %llu\n", normalized, enable ? "compressé" : "décompressé",
+           (unsigned long long)stored, (unsigned long long)src.size);
+    free(normalized);
+    journal_op_end(fs);
+    return 0;
+}
 
-    char buffer[BLOCK_SIZE];
-    uint64_t remaining = src_inode_val.size;
+// --- Instantanes ---
 
-    while (remaining > 0) {
-        size_t to_read = (remaining < BLOCK_SIZE) ? (size_t)remaining : BLOCK_SIZE;
-        fseek(fs->container, (long)src_inode_val.offset + (src_inode_val.size - remaining), SEEK_SET);
-        size_t bytes_read = fread(buffer, 1, to_read, fs->container);
-        fseek(fs->container, (long)offset + (src_inode_val.size - remaining), SEEK_SET);
-        fwrite(buffer, 1, bytes_read, fs->container);
-        remaining -= bytes_read;
+// Inode d'une copie : celui de la source sans ses donnees. Un repertoire
+// recoit son propre index d'enfants, un fichier ses extents ensuite.
+static Inode copy_model(const Inode *src) {
+    Inode model = *src;
+    model.extent_count = 0;
+    model.extent_block = 0;
+    memset(model.extents, 0, sizeof(model.extents));
+    if (model.type == INODE_DIR) {
+        model.size = 0;
+        model.flags &= ~INODE_FLAG_DIR_INDEX;
     }
+    return model;
+}
 
-    Inode *dest_inode = get_inode(fs, dest_idx);
-    strncpy(dest_inode->filename, filename, MAX_FILENAME - 1);
-    dest_inode->filename[MAX_FILENAME - 1] = '\0';
-    strncpy(dest_inode->parent_path, parent_path, MAX_PATH - 1);
-    dest_inode->parent_path[MAX_PATH - 1] = '\0';
-    dest_inode->is_directory = 0;
-    dest_inode->size = src_inode_val.size;
-    dest_inode->offset = offset;
-    dest_inode->created = time(NULL);
-    dest_inode->modified = dest_inode->created;
-    mark_inode_dirty(fs, dest_idx);
+// Nouvelle entree name sous parent, a l'image de model (une copie hors du
+// cache). listed a 0, elle n'apparait pas dans l'index de parent.
+static int entry_create(FileSystem *fs, uint32_t parent, const char *name, const Inode *model,
+                        int listed) {
+    int idx = find_free_inode(fs);
+    if (idx == -1) return -1;
+    uint64_t offset = name_heap_add(&fs->names, name);
+    if (offset == 0) return -1;
 
+    Inode *inode = get_inode(fs, idx);
+    *inode = *model;
+    inode->parent = parent;
+    inode->name_offset = offset;
+    mark_inode_dirty(fs, inode);
     fs->sb.num_files++;
+    inode_mark_used(fs, idx);
 
-    printf("Fichier copié : %s -> %s (%lu octets)\n", normalized_src, normalized_dest,
-           (unsigned long)src_inode_val.size);
-    
-    // Ajouter a la hash table pour acces O(1)
-    hash_table_insert(fs, normalized_dest, dest_idx);
-    
-    free(normalized_src);
-    free(normalized_dest);
+    hash_table_insert(fs, parent, offset, idx);
+    if (listed) dir_index_add(fs, parent, (uint32_t)idx);
+    if (model->type == INODE_DIR && dir_index_create(fs, (uint32_t)idx) != 0) {
+        fprintf(stderr, "Avertissement : index du répertoire %d non créé\n", idx);
+    }
+    return idx;
+}
+
+// Renomme une entree sans la deplacer
+static int entry_rename(FileSystem *fs, int idx, const char *name) {
+    uint64_t offset = name_heap_add(&fs->names, name);
+    if (offset == 0) return -1;
+    Inode *inode = get_inode(fs, idx);
+    hash_table_delete(fs, inode->parent, fs_inode_name(fs, inode));
+    name_heap_release(&fs->names, inode->name_offset);
+    inode->name_offset = offset;
+    mark_inode_dirty(fs, inode);
+    hash_table_insert(fs, inode->parent, offset, idx);
+    dentry_cache_invalidate(fs);
     return 0;
 }
 
-int fs_move_file(FileSystem *fs, const char *src_path, const char *dest_path) {
-    if (fs->sb.num_files >= fs->sb.max_files) {
-        fprintf(stderr, "Erreur : système de fichiers plein\n");
-        return -1;
+// Extents d'un fichier pour un clone, chacun avec une reference de plus
+static int clone_data(FileSystem *fs, const Inode *src, ExtentList *data) {
+    if (inode_load_extents(fs, src, data) != 0) return -1;
+    for (uint32_t i = 0; i < data->count; i++) {
+        if (refmap_add(&fs->ref_map, data->items[i].offset, data->items[i].length) != 0) {
+            clone_drop(fs, data, i);
+            extent_list_free(data);
+            return -1;
+        }
     }
+    if (data->count > 0) fs->ref_map_changed = 1;
+    return 0;
+}
 
-    char *normalized_src = normalize_path(src_path);
-    char *normalized_dest = normalize_path(dest_path);
+// Copie d'une arborescence. Un fichier lie n'est recopie qu'une fois, avec
+// son premier lien et dans la meme operation : sa copie compte exactement
+// les liens deja recrees, et les liens copies ne designent jamais le fichier
+// de la source.
+typedef struct {
+    uint32_t *map;          // Fichier lie source -> copie (0 : pas copie)
+    uint32_t map_size;
+    uint32_t root;          // Repertoire de destination, parent des copies liees
+    uint32_t entries;
+} TreeCopy;
 
-    // Utiliser hash table pour recherche rapide
-    int src_idx = hash_table_lookup(fs, normalized_src);
+// Copie (sans lien) du fichier lie target, creee au premier de ses liens
+static int tree_copy_shared(FileSystem *fs, uint32_t target, TreeCopy *tc) {
+    if (target >= tc->map_size) return -1;
+    if (tc->map[target] != 0) return (int)tc->map[target];
 
-    if (src_idx == -1) {
-        fprintf(stderr, "Erreur : '%s' introuvable\n", normalized_src);
-        free(normalized_src);
-        free(normalized_dest);
+    Inode src = *get_inode(fs, (int)target);
+    if (!inode_is_shared(&src)) return -1;
+    ExtentList data = {0};
+    if (clone_data(fs, &src, &data) != 0) return -1;
+    int idx = find_free_inode(fs);
+    if (idx == -1) {
+        clone_drop(fs, &data, data.count);
+        extent_list_free(&data);
         return -1;
     }
 
-    if (path_exists(fs, normalized_dest, NULL) >= 0) {
-        fprintf(stderr, "Erreur : '%s' existe déjà\n", normalized_dest);
-        free(normalized_src);
-        free(normalized_dest);
+    Inode *inode = get_inode(fs, idx);
+    *inode = copy_model(&src);
+    inode->parent = tc->root;
+    inode->link_count = 0;
+    if (data.count > 0 && inode_store_extents(fs, inode, &data) != 0) {
+        clone_drop(fs, &data, data.count);
+        extent_list_free(&data);
+        memset(inode, 0, sizeof(Inode));
         return -1;
     }
+    extent_list_free(&data);
+    mark_inode_dirty(fs, inode);
+    fs->sb.num_files++;
+    inode_mark_used(fs, idx);
+    tc->map[target] = (uint32_t)idx;
+    return idx;
+}
 
-    char parent_path[MAX_PATH];
-    char filename[MAX_FILENAME];
-    extract_parent_path(normalized_dest, parent_path, MAX_PATH);
-    extract_filename(normalized_dest, filename, MAX_FILENAME);
+static int tree_copy_dir(FileSystem *fs, uint32_t src_dir, uint32_t dest_dir, TreeCopy *tc,
+                         int depth) {
+    if (depth >= MAX_DEPTH) return -1;
+    FsDirIter iter;
+    if (fs_dir_open(fs, (int)src_dir, &iter) != 0) return -1;
 
-    if (!parent_exists(fs, parent_path)) {
-        fprintf(stderr, "Erreur : le répertoire parent '%s' n'existe pas\n", parent_path);
-        free(normalized_src);
-        free(normalized_dest);
+    int ret = 0;
+    int child;
+    while (ret == 0 && (child = fs_dir_next(&iter)) != -1) {
+        if ((uint32_t)child == fs->sb.snapshot_dir) continue;
+        Inode src = *get_inode(fs, child);
+        char name[MAX_FILENAME];
+        snprintf(name, sizeof(name), "%s", fs_inode_name(fs, &src));
+
+        if (src.type == INODE_LINK) {
+            int data = tree_copy_shared(fs, src.target, tc);
+            if (data == -1) {
+                fprintf(stderr, "Avertissement : lien %d sans fichier, non recopié\n", child);
+                continue;
+            }
+            Inode model = src;
+            model.target = (uint32_t)data;
+            if (entry_create(fs, dest_dir, name, &model, 1) == -1) {
+                // Une copie sans lien ne survivrait pas a l'operation
+                if (get_inode(fs, data)->link_count == 0) {
+                    tc->map[src.target] = 0;
+                    shared_free(fs, data);
+                }
+                ret = -1;
+                break;
+            }
+            Inode *file = get_inode(fs, data);
+            file->link_count++;
+            mark_inode_dirty(fs, file);
+            tc->entries++;
+            journal_op_end(fs);
+            continue;
+        }
+
+        ExtentList data = {0};
+        if (src.type == INODE_FILE && clone_data(fs, &src, &data) != 0) {
+            ret = -1;
+            break;
+        }
+        Inode model = copy_model(&src);
+        int copy = entry_create(fs, dest_dir, name, &model, 1);
+        if (copy == -1) {
+            clone_drop(fs, &data, data.count);
+            extent_list_free(&data);
+            ret = -1;
+            break;
+        }
+        if (data.count > 0) {
+            Inode *inode = get_inode(fs, copy);
+            if (inode_store_extents(fs, inode, &data) != 0) {
+                // Copie vide, supprimee avec le reste
+                clone_drop(fs, &data, data.count);
+                inode->extent_count = 0;
+                inode->extent_block = 0;
+                inode->size = 0;
+                ret = -1;
+            }
+            mark_inode_dirty(fs, inode);
+        }
+        extent_list_free(&data);
+        tc->entries++;
+        journal_op_end(fs);
+
+        if (ret == 0 && src.type == INODE_DIR) {
+            ret = tree_copy_dir(fs, (uint32_t)child, (uint32_t)copy, tc, depth + 1);
+        }
+    }
+    fs_dir_close(&iter);
+    return ret;
+}
+
+// Recopie les enfants de src_dir sous dest_dir ; les fichiers sont des
+// clones. entries recoit le nombre d'entrees creees.
+static int tree_copy(FileSystem *fs, uint32_t src_dir, uint32_t dest_dir, uint32_t *entries) {
+    TreeCopy tc = {0};
+    tc.map_size = fs->sb.max_files;
+    tc.map = calloc(tc.map_size, sizeof(uint32_t));
+    if (!tc.map) return -1;
+    tc.root = dest_dir;
+
+    int ret = tree_copy_dir(fs, src_dir, dest_dir, &tc, 0);
+    *entries = tc.entries;
+    free(tc.map);
+    return ret;
+}
+
+// Vide le repertoire dir, sous-repertoires compris
+static int tree_remove(FileSystem *fs, uint32_t dir, int depth) {
+    if (depth >= MAX_DEPTH) return -1;
+    FsDirIter iter;
+    if (fs_dir_open(fs, (int)dir, &iter) != 0) return -1;
+
+    int ret = 0;
+    int child;
+    while (ret == 0 && (child = fs_dir_next(&iter)) != -1) {
+        if ((uint32_t)child == fs->sb.snapshot_dir) continue;
+        if (get_inode(fs, child)->type == INODE_DIR) {
+            ret = tree_remove(fs, (uint32_t)child, depth + 1);
+            if (ret != 0) continue;
+        }
+        ret = entry_remove(fs, child, fs_inode_name(fs, get_inode(fs, child)));
+        journal_op_end(fs);
+    }
+    fs_dir_close(&iter);
+    return ret;
+}
+
+// Taille apparente : un fichier lie compte pour chacun de ses noms
+static void tree_count(FileSystem *fs, uint32_t dir, uint32_t *entries, uint64_t *bytes, int depth) {
+    FsDirIter iter;
+    if (depth >= MAX_DEPTH || fs_dir_open(fs, (int)dir, &iter) != 0) return;
+    int child;
+    while ((child = fs_dir_next(&iter)) != -1) {
+        int data = fs_link_target(fs, child);
+        const Inode *inode = get_inode(fs, data >= 0 ? data : child);
+        (*entries)++;
+        if (inode->type == INODE_FILE) {
+            *bytes += inode->size;
+        } else if (inode->type == INODE_DIR) {
+            tree_count(fs, (uint32_t)child, entries, bytes, depth + 1);
+        }
+    }
+    fs_dir_close(&iter);
+}
+
+// Un seul composant, sans point initial : le point marque les instantanes
+// en cours de creation ou de suppression
+static int snapshot_name_valid(const char *name) {
+    size_t len = strlen(name);
+    if (len == 0 || len + 1 >= MAX_FILENAME || name[0] == '.' || strchr(name, '/')) {
+        fprintf(stderr, "Erreur : nom d'instantané invalide : '%s'\n", name);
+        return 0;
+    }
+    return 1;
+}
+
+static int snapshot_find(FileSystem *fs, const char *name) {
+    if (!snapshot_name_valid(name)) return -1;
+    int idx = fs->sb.snapshot_dir ? hash_table_lookup(fs, fs->sb.snapshot_dir, name) : -1;
+    if (idx == -1) fprintf(stderr, "Erreur : instantané '%s' introuvable\n", name);
+    return idx;
+}
+
+// Repertoire des instantanes, cree au premier : sous la racine, sans
+// figurer dans son index
+static int snapshot_dir_get(FileSystem *fs) {
+    if (fs->sb.snapshot_dir != 0) return (int)fs->sb.snapshot_dir;
+    if (hash_table_lookup(fs, ROOT_INODE, SNAPSHOT_DIR) != -1) {
+        fprintf(stderr, "Erreur : '/%s' existe déjà, les instantanés ne peuvent pas y être rangés\n",
+                SNAPSHOT_DIR);
         return -1;
     }
+    Inode model = copy_model(get_inode(fs, ROOT_INODE));
+    model.flags = 0;
+    model.mode = 0555;
+    model.created = time(NULL);
+    model.modified = model.created;
+    model.accessed = model.created;
+    int idx = entry_create(fs, ROOT_INODE, SNAPSHOT_DIR, &model, 0);
+    if (idx != -1) fs->sb.snapshot_dir = (uint32_t)idx;
+    return idx;
+}
 
-    Inode *src_inode = get_inode(fs, src_idx);
-    if (!src_inode->is_directory) {
-        // Supprimer l'ancienne entree de la hash table
-        hash_table_delete(fs, normalized_src);
-        
-        strncpy(src_inode->filename, filename, MAX_FILENAME - 1);
-        src_inode->filename[MAX_FILENAME - 1] = '\0';
-        strncpy(src_inode->parent_path, parent_path, MAX_PATH - 1);
-        src_inode->parent_path[MAX_PATH - 1] = '\0';
-        src_inode->modified = time(NULL);
-        mark_inode_dirty(fs, src_idx);
-
-        // Ajouter la nouvelle entree a la hash table
-        hash_table_insert(fs, normalized_dest, src_idx);
+// Supprime un instantane, son repertoire compris
+static int snapshot_drop(FileSystem *fs, int snap) {
+    if (tree_remove(fs, (uint32_t)snap, 0) != 0) return -1;
+    return entry_remove(fs, snap, fs_inode_name(fs, get_inode(fs, snap)));
+}
 
-        printf("Déplacé : %s -> %s\n", normalized_src, normalized_dest);
+// Instantanes interrompus (nom en point) : supprimes
+static void snapshot_cleanup(FileSystem *fs) {
+    FsDirIter iter;
+    if (fs->sb.snapshot_dir == 0 || fs_dir_open(fs, (int)fs->sb.snapshot_dir, &iter) != 0) return;
+    int child;
+    while ((child = fs_dir_next(&iter)) != -1) {
+        if (fs_inode_name(fs, get_inode(fs, child))[0] != '.') continue;
+        if (snapshot_drop(fs, child) == 0) {
+            printf("Instantané interrompu supprimé\n");
+        }
+    }
+    fs_dir_close(&iter);
+}
+
+int fs_snapshot_create(FileSystem *fs, const char *name) {
+    if (!snapshot_name_valid(name)) return -1;
+    if (fs->sb.snapshot_dir != 0 && hash_table_lookup(fs, fs->sb.snapshot_dir, name) != -1) {
+        fprintf(stderr, "Erreur : l'instantané '%s' existe déjà\n", name);
+        return -1;
+    }
+
+    fs_txn_begin(fs);
+    int dir = snapshot_dir_get(fs);
+    if (dir == -1) {
+        fs_txn_commit(fs);
+        return -1;
+    }
+    snapshot_cleanup(fs);
+
+    // Construit sous un nom en point puis renomme : une creation
+    // interrompue (transaction validee en plusieurs fois) ne laisse pas un
+    // instantane incomplet sous son nom
+    char partial[MAX_FILENAME];
+    snprintf(partial, sizeof(partial), ".%s", name);
+    Inode model = copy_model(get_inode(fs, ROOT_INODE));
+    model.created = time(NULL);
+    model.modified = model.created;
+    model.accessed = model.created;
+    int snap = entry_create(fs, (uint32_t)dir, partial, &model, 1);
+    uint32_t entries = 0;
+    int ret = snap == -1 ? -1 : tree_copy(fs, ROOT_INODE, (uint32_t)snap, &entries);
+    if (ret == 0) ret = entry_rename(fs, snap, name);
+
+    if (ret != 0) {
+        fprintf(stderr, "Erreur : création de l'instantané '%s' impossible\n", name);
+        if (snap != -1) snapshot_drop(fs, snap);
+    } else {
+        printf("Instantané créé : %s (%u entrées)\n", name, entries);
+    }
+    fs_txn_commit(fs);
+    return ret;
+}
+
+int fs_snapshot_restore(FileSystem *fs, const char *name) {
+    int snap = snapshot_find(fs, name);
+    if (snap == -1) return -1;
+
+    // L'arborescence vivante est videe puis recopiee depuis l'instantane :
+    // les donnees qu'ils partagent ne font que perdre puis regagner une
+    // reference
+    fs_txn_begin(fs);
+    uint32_t entries = 0;
+    int ret = tree_remove(fs, ROOT_INODE, 0);
+    if (ret == 0) {
+        uint16_t flags = get_inode(fs, snap)->flags & INODE_FLAG_COMPRESS;
+        Inode *root = get_inode(fs, ROOT_INODE);
+        root->flags = (uint16_t)((root->flags & ~INODE_FLAG_COMPRESS) | flags);
+        root->modified = time(NULL);
+        mark_inode_dirty(fs, root);
+        ret = tree_copy(fs, (uint32_t)snap, ROOT_INODE, &entries);
+    }
+
+    if (ret != 0) {
+        fprintf(stderr, "Erreur : restauration de '%s' interrompue, à relancer\n", name);
+    } else {
+        printf("Instantané restauré : %s (%u entrées)\n", name, entries);
+    }
+    fs_txn_commit(fs);
+    return ret;
+}
+
+int fs_snapshot_delete(FileSystem *fs, const char *name) {
+    int snap = snapshot_find(fs, name);
+    if (snap == -1) return -1;
+
+    fs_txn_begin(fs);
+    snapshot_cleanup(fs);
+    // Renomme d'abord, comme a la creation
+    char partial[MAX_FILENAME];
+    snprintf(partial, sizeof(partial), ".%s", name);
+    int ret = entry_rename(fs, snap, partial);
+    if (ret == 0) ret = snapshot_drop(fs, snap);
+
+    if (ret != 0) {
+        fprintf(stderr, "Erreur : suppression de l'instantané '%s' interrompue\n", name);
+    } else {
+        printf("Instantané supprimé : %s\n", name);
+        // Plus d'instantane : le repertoire disparait aussi
+        DirIndex *di = dir_index_get(fs, fs->sb.snapshot_dir);
+        if (di && di->count == 0 && entry_remove(fs, (int)fs->sb.snapshot_dir, "/" SNAPSHOT_DIR) == 0) {
+            fs->sb.snapshot_dir = 0;
+        }
+    }
+    fs_txn_commit(fs);
+    return ret;
+}
+
+void fs_snapshot_list(FileSystem *fs) {
+    int shown = 0;
+    FsDirIter iter;
+    if (fs->sb.snapshot_dir != 0 && fs_dir_open(fs, (int)fs->sb.snapshot_dir, &iter) == 0) {
+        int child;
+        while ((child = fs_dir_next(&iter)) != -1) {
+            Inode snap = *get_inode(fs, child);
+            char name[MAX_FILENAME];
+            snprintf(name, sizeof(name), "%s", fs_inode_name(fs, &snap));
+            if (name[0] == '.') continue;
+
+            uint32_t entries = 0;
+            uint64_t bytes = 0;
+            tree_count(fs, (uint32_t)child, &entries, &bytes, 0);
+            char time_str[20];
+            strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M", localtime(&snap.created));
+            if (shown++ == 0) {
+                printf("%-30s %20s %10s %14s\n", "Nom", "Date", "Entrées", "Octets");
+                printf("-----------------------------------------------------------------------------\n");
+            }
+            printf("%-30s %20s %10u %14llu\n", name, time_str, entries, (unsigned long long)bytes);
+        }
+        fs_dir_close(&iter);
+    }
+    if (shown == 0) printf("Aucun instantané\n");
+}
+
+// --- Sommes de controle : reglages ---
+
+int fs_set_sha256(FileSystem *fs, int enable) {
+    if (enable) {
+        fs->sb.flags |= SB_FLAG_SHA256;
+    } else {
+        fs->sb.flags &= ~SB_FLAG_SHA256;
+    }
+    journal_op_end(fs);
+    return 0;
+}
+
+void fs_set_verify(FileSystem *fs, int policy) {
+    fs->verify = policy;
+}
+
+int fs_verify_from_name(const char *name) {
+    if (!name) return 0;
+    if (strcmp(name, "off") == 0) return FS_VERIFY_OFF;
+    if (strcmp(name, "warn") == 0) return FS_VERIFY_WARN;
+    if (strcmp(name, "strict") == 0) return FS_VERIFY_STRICT;
+    return 0;
+}
+
+int fs_checksum_info(FileSystem *fs, const Inode *inode, FsChecksumInfo *info) {
+    memset(info, 0, sizeof(*info));
+    if (!(inode->flags & INODE_FLAG_CHECKSUM)) return 1;
+
+    ExtentList list;
+    if (inode_load_extents(fs, inode, &list) != 0) return -1;
+    ChecksumHeader header;
+    uint32_t *sums;
+    int ret = checksum_table_read(fs, inode, list.items, list.count, &header, &sums);
+    extent_list_free(&list);
+    if (ret != 0) return -1;
+    free(sums);
+
+    info->blocks = header.block_count;
+    info->has_sha256 = (header.flags & CHECKSUM_SHA256) != 0;
+    memcpy(info->sha256, header.sha256, SHA256_SIZE);
+    return 0;
+}
+
+// --- Deduplication : reglage et bilan ---
+
+int fs_set_dedup(FileSystem *fs, int enable) {
+    if (enable) {
+        fs->sb.flags |= SB_FLAG_DEDUP;
     } else {
-        // Supprimer l'ancienne entree de la hash table
-        hash_table_delete(fs, normalized_src);
-        
-        strncpy(src_inode->filename, filename, MAX_FILENAME - 1);
-        src_inode->filename[MAX_FILENAME - 1] = '\0';
-        strncpy(src_inode->parent_path, parent_path, MAX_PATH - 1);
-        src_inode->parent_path[MAX_PATH - 1] = '\0';
-        src_inode->modified = time(NULL);
-        mark_inode_dirty(fs, src_idx);
-
-        // Ajouter la nouvelle entree a la hash table
-        hash_table_insert(fs, normalized_dest, src_idx);
-
-        // Mettre a jour les entrees enfants dans la hash table
-        for (int i = 0; i < MAX_FILES; i++) {
-            Inode *inode = get_inode(fs, i);
-            if (inode->filename[0] != '\0' && i != src_idx) {
-                if (strncmp(inode->parent_path, normalized_src,
-                           strlen(normalized_src)) == 0) {
-                    char old_full_path[MAX_PATH];
-                    snprintf(old_full_path, MAX_PATH, "%s/%s", inode->parent_path,
-                            inode->filename);
-                    
-                    hash_table_delete(fs, old_full_path);
-                    
-                    char old_parent[MAX_PATH];
-                    strncpy(old_parent, inode->parent_path, MAX_PATH - 1);
-
-                    char new_parent[MAX_PATH];
-                    size_t offset = strlen(normalized_src);
-                    snprintf(new_parent, MAX_PATH, "%s%s", normalized_dest,
-                            old_parent + offset);
-
-                    strncpy(inode->parent_path, new_parent, MAX_PATH - 1);
-                    inode->parent_path[MAX_PATH - 1] = '\0';
-                    mark_inode_dirty(fs, i);
-                    
-                    // Ajouter la nouvelle entree a la hash table
-                    char new_full_path[MAX_PATH];
-                    snprintf(new_full_path, MAX_PATH, "%s/%s", new_parent,
-                            inode->filename);
-                    hash_table_insert(fs, new_full_path, i);
+        fs->sb.flags &= ~SB_FLAG_DEDUP;
+    }
+    journal_op_end(fs);
+    return 0;
+}
+
+int fs_dedup_stats(FileSystem *fs, FsDedupStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->enabled = (fs->sb.flags & SB_FLAG_DEDUP) != 0;
+    stats->indexed_blocks = fs->dedup.count;
+
+    InodeScan scan;
+    uint32_t index;
+    const Inode *inode;
+    inode_scan_open(fs, &scan);
+    while ((inode = inode_scan_next(&scan, &index)) != NULL) {
+        if (inode->type == INODE_FILE) stats->file_bytes += inode->size;
+    }
+    inode_scan_close(&scan);
+    if (scan.failed) return -1;
+
+    for (uint32_t i = 0; i < fs->ref_map.count; i++) stats->shared_bytes += fs->ref_map.runs[i].length;
+    stats->saved_bytes = refmap_saved(&fs->ref_map);
+    return 0;
+}
+
+// --- Defragmentation ---
+
+int fs_frag_stats(FileSystem *fs, FsFragStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+
+    InodeScan scan;
+    uint32_t index;
+    const Inode *inode;
+    inode_scan_open(fs, &scan);
+    while ((inode = inode_scan_next(&scan, &index)) != NULL) {
+        if (inode->type == INODE_FREE || inode->extent_count == 0) continue;
+        stats->files++;
+        stats->extents += inode->extent_count;
+        stats->data_bytes += inode->size;
+        if (inode->extent_count > 1) stats->fragmented++;
+    }
+    inode_scan_close(&scan);
+    if (scan.failed) return -1;
+
+    stats->free_bytes = fs->free_map.total;
+    stats->free_runs = fs->free_map.count;
+    const FreeRun *largest = freemap_largest(&fs->free_map);
+    stats->largest_free = largest ? largest->length : 0;
+    stats->data_end = fs->sb.data_end;
+    return 0;
+}
+
+typedef struct {
+    uint32_t index;
+    uint64_t end;
+    uint64_t length;      // Octets occupes par les extents, compresses le cas echeant
+} DefragItem;
+
+// Les contenus qui finissent le plus loin d'abord : ce sont eux qui
+// retiennent la fin des donnees
+static int defrag_item_compare(const void *a, const void *b) {
+    const DefragItem *x = a;
+    const DefragItem *y = b;
+    if (x->end != y->end) return x->end < y->end ? 1 : -1;
+    return x->index < y->index ? -1 : x->index > y->index;
+}
+
+static uint64_t monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+// Recopie le contenu d'un inode d'un seul tenant, dans la plage libre la
+// plus basse qui le rapproche du debut : plus bas que son premier extent
+// s'il est deja contigu. Un contenu fragmente va n'importe ou, en fin de
+// donnees a defaut de plage assez grande. Les anciennes zones ne sont
+// reutilisables qu'apres la transaction, comme pour une suppression.
+// Retourne les octets deplaces, 0 si rien ne convient.
+static uint64_t defrag_move(FileSystem *fs, uint32_t index, char *buffer, size_t buffer_size) {
+    Inode src = *get_inode(fs, (int)index);
+    if (src.type == INODE_FREE || src.extent_count == 0 || src.size == 0) return 0;
+
+    // Un fichier compresse se deplace tel quel, sans le decoder
+    FsReader reader;
+    if (stored_reader_open(fs, &src, &reader) != 0) return 0;
+    // Des blocs partages resteraient en place pour les autres contenus : le
+    // deplacement ne ferait que les dupliquer
+    for (uint32_t e = 0; e < reader.count; e++) {
+        if (refmap_shared(&fs->ref_map, reader.extents[e].offset, reader.extents[e].length) > 0) {
+            fs_reader_close(&reader);
+            return 0;
+        }
+    }
+    uint64_t stored = reader.remaining;
+    uint64_t length = blocks_for_size(stored) * BLOCK_SIZE;
+    int fragmented = src.extent_count > 1;
+    uint64_t limit = fragmented ? fs->sb.data_end : src.extents[0].offset;
+    uint64_t offset;
+    if (freemap_alloc_first_fit(&fs->free_map, length, limit, &offset) != 0) {
+        if (!fragmented) {
+            fs_reader_close(&reader);
+            return 0;
+        }
+        offset = alloc_at_end(fs, length);
+    }
+
+    io_advise(fs->container, offset, length, IO_ADVISE_SEQUENTIAL);
+    uint64_t done = 0;
+    while (reader.remaining > 0) {
+        size_t n = fs_reader_read(&reader, buffer, buffer_size);
+        if (n == 0 || io_write(fs->container, offset + done, buffer, n) != n) break;
+        done += n;
+    }
+    fs_reader_close(&reader);
+    if (done != stored) {
+        fprintf(stderr, "Erreur : déplacement des données de l'inode %u impossible\n", index);
+        freemap_insert(&fs->free_map, offset, length);
+        release_data_tail(fs);
+        return 0;
+    }
+
+    Inode *inode = get_inode(fs, (int)index);
+    uint64_t size = inode->size;
+    inode_free_data(fs, inode);
+    inode->size = size;
+    inode->extents[0].offset = offset;
+    inode->extents[0].length = length;
+    inode->extent_count = 1;
+    mark_inode_dirty(fs, inode);
+    return length;
+}
+
+// Deplace une zone de metadonnees reecrite en entier a chaque sauvegarde :
+// il suffit de la designer ailleurs, la prochaine sauvegarde la remplit
+static uint64_t defrag_move_region(FileSystem *fs, uint64_t *offset, uint64_t capacity) {
+    uint64_t target;
+    if (*offset == 0 || freemap_alloc_first_fit(&fs->free_map, capacity, *offset, &target) != 0) {
+        return 0;
+    }
+    space_release(fs, *offset, capacity);
+    *offset = target;
+    return capacity;
+}
+
+// Le tas de noms, la carte d'espace libre, les compteurs de references et
+// les index sont places en fin de donnees quand ils grandissent : ils
+// retiendraient a eux seuls la fin des donnees. Le tas et les compteurs sont
+// reecrits a la prochaine transaction, les index a la fermeture (d'ici la,
+// l'ouverture reconstruirait celui des entrees et viderait celui des
+// empreintes).
+static uint64_t defrag_move_metadata(FileSystem *fs) {
+    SuperBlock *sb = &fs->sb;
+    uint64_t moved = 0;
+    uint64_t n;
+
+    if ((n = defrag_move_region(fs, &sb->name_heap_offset, sb->name_heap_capacity)) > 0) {
+        fs->names.flushed = 0;
+        moved += n;
+    }
+    moved += defrag_move_region(fs, &sb->free_map_offset, sb->free_map_capacity);
+    if ((n = defrag_move_region(fs, &sb->path_index_offset, sb->path_index_capacity)) > 0) {
+        fs->path_index_current = 0;
+        moved += n;
+    }
+    if ((n = defrag_move_region(fs, &sb->ref_map_offset, sb->ref_map_capacity)) > 0) {
+        fs->ref_map_changed = 1;
+        moved += n;
+    }
+    if ((n = defrag_move_region(fs, &sb->dedup_index_offset, sb->dedup_index_capacity)) > 0) {
+        fs->dedup_current = 0;
+        moved += n;
+    }
+    return moved;
+}
+
+// Inodes ayant des donnees, dans l'ordre ou les deplacer
+static uint32_t defrag_collect(FileSystem *fs, DefragItem *items, uint32_t capacity) {
+    uint32_t count = 0;
+    InodeScan scan;
+    uint32_t index;
+    const Inode *inode;
+    inode_scan_open(fs, &scan);
+    while (count < capacity && (inode = inode_scan_next(&scan, &index)) != NULL) {
+        if (inode->type == INODE_FREE || inode->extent_count == 0 || inode->size == 0) continue;
+        ExtentList list;
+        if (inode_load_extents(fs, inode, &list) != 0) continue;
+        items[count].index = index;
+        items[count].end = inode_data_end(fs, inode);
+        items[count].length = 0;
+        for (uint32_t e = 0; e < list.count; e++) items[count].length += list.items[e].length;
+        extent_list_free(&list);
+        count++;
+    }
+    inode_scan_close(&scan);
+    qsort(items, count, sizeof(DefragItem), defrag_item_compare);
+    return count;
+}
+
+int fs_defrag(FileSystem *fs, const FsDefragOptions *options, FsDefragResult *result) {
+    memset(result, 0, sizeof(*result));
+    if (journal_commit(fs, 0) != 0 || fs_frag_stats(fs, &result->before) != 0) return -1;
+
+    uint32_t capacity = result->before.files;
+    DefragItem *items = malloc(((size_t)capacity + 1) * sizeof(DefragItem));
+    char *buffer = malloc(INODE_SCAN_CHUNK);
+    if (!items || !buffer) {
+        fprintf(stderr, "Erreur : mémoire insuffisante\n");
+        free(items);
+        free(buffer);
+        return -1;
+    }
+
+    // Une zone liberee ne sert qu'apres la transaction : chaque tour reprend
+    // les contenus restes en place, jusqu'a ce qu'aucun ne bouge plus. Le
+    // budget de temps ne compte que les deplacements, et le premier est
+    // toujours tente : un budget court fait quand meme avancer la passe.
+    uint64_t start = monotonic_ms();
+    int ret = 0;
+    int stopped = 0;
+    int skipped = 0;
+    uint32_t moved_in_pass = 1;
+    while (moved_in_pass > 0 && !stopped && ret == 0) {
+        moved_in_pass = 0;
+        uint32_t count = defrag_collect(fs, items, capacity);
+        uint64_t slice = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            if (options->time_ms > 0 && result->files_moved > 0 &&
+                monotonic_ms() - start >= options->time_ms) {
+                stopped = 1;
+                break;
+            }
+            // Un contenu qui depasse le reste du budget est laisse pour une
+            // prochaine passe, les suivants peuvent encore y tenir
+            if (options->bytes > 0 && result->bytes_moved + items[i].length > options->bytes) {
+                skipped = 1;
+                continue;
+            }
+
+            uint64_t moved = defrag_move(fs, items[i].index, buffer, INODE_SCAN_CHUNK);
+            if (moved == 0) continue;
+            moved_in_pass++;
+            result->files_moved++;
+            result->bytes_moved += moved;
+            slice += moved;
+            if (slice >= DEFRAG_SLICE) {
+                if (journal_commit(fs, 0) != 0) {
+                    ret = -1;
+                    break;
                 }
+                slice = 0;
             }
         }
+        if (!stopped && ret == 0) {
+            uint64_t moved = defrag_move_metadata(fs);
+            if (moved > 0) moved_in_pass++;
+            result->bytes_moved += moved;
+        }
+        if (journal_commit(fs, 0) != 0) ret = -1;
+    }
+    free(items);
+    free(buffer);
 
-        printf("Répertoire déplacé : %s -> %s\n", normalized_src, normalized_dest);
+    result->complete = !stopped && !skipped && ret == 0;
+    if (fs_frag_stats(fs, &result->after) != 0) ret = -1;
+    return ret;
+}
+
+int fs_trim(FileSystem *fs, FsTrimResult *result) {
+    memset(result, 0, sizeof(*result));
+    if (journal_commit(fs, 0) != 0) return -1;
+
+    // Apres la transaction, tout l'espace libre l'est aussi dans l'etat
+    // valide : la fin des donnees est la fin du dernier octet designe
+    result->size_before = io_size(fs->container);
+    if (result->size_before > fs->sb.data_end && io_truncate(fs->container, fs->sb.data_end) != 0) {
+        fprintf(stderr, "Erreur : troncature du conteneur impossible\n");
+        return -1;
     }
+    result->size_after = io_size(fs->container);
 
-    free(normalized_src);
-    free(normalized_dest);
+    for (uint32_t i = 0; i < fs->free_map.count; i++) {
+        const FreeRun *run = &fs->free_map.by_offset[i];
+        if (io_punch(fs->container, run->offset, run->length) != 0) break;
+        result->punched += run->length;
+    }
     return 0;
 }
 
@@ -921,14 +5773,12 @@ void fs_list(FileSystem *fs, const char *path) {
 void fs_list_recursive(FileSystem *fs, const char *path, int depth) {
     char *normalized = normalize_path(path);
 
-    int idx = path_exists(fs, normalized, NULL);
-    if (idx != -1) {
-        Inode *inode = get_inode(fs, idx);
-        if (inode && !inode->is_directory) {
-            fprintf(stderr, "Erreur : '%s' n'est pas un répertoire\n", normalized);
-            free(normalized);
-            return;
-        }
+    int is_dir = 0;
+    int idx = path_exists(fs, normalized, &is_dir);
+    if (idx != -1 && !is_dir) {
+        fprintf(stderr, "Erreur : '%s' n'est pas un répertoire\n", normalized);
+        free(normalized);
+        return;
     }
 
     if (depth == 0) {
@@ -938,10 +5788,15 @@ void fs_list_recursive(FileSystem *fs, const char *path, int depth) {
         printf("---------------------------------------------------------------------\n");
     }
 
-    for (int i = 0; i < MAX_FILES; i++) {
-        Inode *inode = get_inode(fs, i);
-        if (inode->filename[0] != '\0' &&
-            strcmp(inode->parent_path, normalized) == 0) {
+    FsDirIter iter;
+    if (idx != -1 && fs_dir_open(fs, idx, &iter) == 0) {
+        int i;
+        while ((i = fs_dir_next(&iter)) != -1) {
+            // Nom de l'entree, taille et date du fichier pour un lien
+            char name[MAX_FILENAME];
+            snprintf(name, sizeof(name), "%s", fs_inode_name(fs, get_inode(fs, i)));
+            int data = fs_link_target(fs, i);
+            Inode *inode = get_inode(fs, data >= 0 ? data : i);
 
             char time_str[20];
             struct tm *tm_info = localtime(&inode->modified);
@@ -950,15 +5805,14 @@ void fs_list_recursive(FileSystem *fs, const char *path, int depth) {
             char indent[64] = "";
             for (int j = 0; j < depth; j++) strcat(indent, "  ");
 
-            if (inode->is_directory) {
-                printf("%s%-38s %12s %20s\n", indent, inode->filename,
-                       "[DIR]", time_str);
+            if (inode->type == INODE_DIR) {
+                printf("%s%-38s %12s %20s\n", indent, name, "[DIR]", time_str);
             } else {
-                printf("%s%-38s %10lu B  %20s\n", indent,
-                       inode->filename,
+                printf("%s%-38s %10lu B  %20s\n", indent, name,
                        (unsigned long)inode->size, time_str);
             }
         }
+        fs_dir_close(&iter);
     }
 
     if (depth == 0) printf("\n");
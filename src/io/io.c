@@ -0,0 +1,254 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // fallocate
+#endif
+
+#include "../../include/io.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#define IO_MAP_MIN (1ULL << 20)
+
+// La projection est reservee par puissances de 2 pour que l'ajout en fin de
+// conteneur ne remappe qu'un nombre logarithmique de fois
+static int io_remap(IoFile *io, uint64_t needed) {
+    uint64_t reserve = IO_MAP_MIN;
+    while (reserve < needed) reserve *= 2;
+
+    void *map = mmap(NULL, (size_t)reserve, PROT_READ | PROT_WRITE, MAP_SHARED, io->fd, 0);
+    if (map == MAP_FAILED) return -1;
+    if (io->map) munmap(io->map, (size_t)io->map_size);
+    io->map = map;
+    io->map_size = reserve;
+    return 0;
+}
+
+// Le fichier doit couvrir end octets : il est agrandi, et la projection avec
+static int io_mmap_grow(IoFile *io, uint64_t end) {
+    if (end <= io->size) return 0;
+    if (ftruncate(io->fd, (off_t)end) != 0) return -1;
+    io->size = end;
+    if (end > io->map_size) return io_remap(io, end);
+    return 0;
+}
+
+static IoFile *io_wrap(int fd, int backend) {
+    IoFile *io = calloc(1, sizeof(IoFile));
+    if (!io) {
+        close(fd);
+        return NULL;
+    }
+    io->backend = backend;
+    io->fd = fd;
+
+    if (backend == IO_BACKEND_MMAP) {
+        struct stat st;
+        if (fstat(fd, &st) != 0 || io_remap(io, (uint64_t)st.st_size) != 0) {
+            close(fd);
+            free(io);
+            return NULL;
+        }
+        io->size = (uint64_t)st.st_size;
+    } else {
+        io->backend = IO_BACKEND_PREAD;
+    }
+    return io;
+}
+
+IoFile *io_open(const char *path, int backend) {
+    int fd = open(path, O_RDWR);
+    if (fd < 0) return NULL;
+    return io_wrap(fd, backend);
+}
+
+IoFile *io_create(const char *path) {
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return NULL;
+    return io_wrap(fd, IO_BACKEND_PREAD);
+}
+
+void io_close(IoFile *io) {
+    if (!io) return;
+    if (io->map) munmap(io->map, (size_t)io->map_size);
+    close(io->fd);
+    free(io);
+}
+
+size_t io_read(IoFile *io, uint64_t offset, void *buf, size_t len) {
+    if (io->backend == IO_BACKEND_MMAP) {
+        if (offset >= io->size) return 0;
+        if (len > io->size - offset) len = (size_t)(io->size - offset);
+        memcpy(buf, io->map + offset, len);
+        return len;
+    }
+
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = pread(io->fd, (char *)buf + done, len - done, (off_t)(offset + done));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += (size_t)n;
+    }
+    return done;
+}
+
+size_t io_write(IoFile *io, uint64_t offset, const void *buf, size_t len) {
+    io->writes++;
+    if (io->backend == IO_BACKEND_MMAP) {
+        if (io_mmap_grow(io, offset + len) != 0) return 0;
+        memcpy(io->map + offset, buf, len);
+        return len;
+    }
+
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = pwrite(io->fd, (const char *)buf + done, len - done, (off_t)(offset + done));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += (size_t)n;
+    }
+    return done;
+}
+
+// Termine segment par segment un transfert vectorise dont seuls done octets
+// ont ete faits (transfert partiel, ou backend sans preadv/pwritev)
+static size_t io_finish_vec(IoFile *io, uint64_t offset, const struct iovec *iov, int count,
+                            size_t done, int write) {
+    size_t pos = 0;
+    for (int i = 0; i < count; i++) {
+        size_t len = iov[i].iov_len;
+        if (done < pos + len) {
+            size_t skip = done - pos;
+            char *base = (char *)iov[i].iov_base + skip;
+            size_t n = write ? io_write(io, offset + done, base, len - skip)
+                             : io_read(io, offset + done, base, len - skip);
+            done += n;
+            if (n < len - skip) return done;
+        }
+        pos += len;
+    }
+    return done;
+}
+
+size_t io_readv(IoFile *io, uint64_t offset, const struct iovec *iov, int count) {
+    if (io->backend == IO_BACKEND_MMAP) return io_finish_vec(io, offset, iov, count, 0, 0);
+
+    ssize_t n;
+    do {
+        n = preadv(io->fd, iov, count, (off_t)offset);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) return 0;
+    return io_finish_vec(io, offset, iov, count, (size_t)n, 0);
+}
+
+size_t io_writev(IoFile *io, uint64_t offset, const struct iovec *iov, int count) {
+    io->writes++;
+    if (io->backend == IO_BACKEND_MMAP) return io_finish_vec(io, offset, iov, count, 0, 1);
+
+    ssize_t n;
+    do {
+        n = pwritev(io->fd, iov, count, (off_t)offset);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) return 0;
+    return io_finish_vec(io, offset, iov, count, (size_t)n, 1);
+}
+
+const void *io_map(IoFile *io, uint64_t offset, size_t len) {
+    if (io->backend != IO_BACKEND_MMAP || offset + len > io->size) return NULL;
+    return io->map + offset;
+}
+
+uint64_t io_size(IoFile *io) {
+    if (io->backend == IO_BACKEND_MMAP) return io->size;
+
+    struct stat st;
+    if (fstat(io->fd, &st) != 0) return 0;
+    return (uint64_t)st.st_size;
+}
+
+void io_advise(IoFile *io, uint64_t offset, uint64_t len, int advice) {
+    if (io->backend == IO_BACKEND_MMAP) {
+        if (offset >= io->size) return;
+        if (len > io->size - offset) len = io->size - offset;
+        // madvise attend une adresse alignee sur une page
+        uint64_t start = offset & ~((uint64_t)sysconf(_SC_PAGESIZE) - 1);
+        madvise(io->map + start, (size_t)(offset + len - start),
+                advice == IO_ADVISE_SEQUENTIAL ? MADV_SEQUENTIAL : MADV_WILLNEED);
+        return;
+    }
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(io->fd, (off_t)offset, (off_t)len,
+                  advice == IO_ADVISE_SEQUENTIAL ? POSIX_FADV_SEQUENTIAL : POSIX_FADV_WILLNEED);
+#else
+    (void)offset;
+    (void)len;
+    (void)advice;
+#endif
+}
+
+int io_extend(IoFile *io, uint64_t size) {
+    if (io_size(io) >= size) return 0;
+    if (io->backend == IO_BACKEND_MMAP) return io_mmap_grow(io, size);
+    return ftruncate(io->fd, (off_t)size);
+}
+
+int io_punch(IoFile *io, uint64_t offset, uint64_t len) {
+    if (offset >= io_size(io)) return 0;
+#ifdef FALLOC_FL_PUNCH_HOLE
+    // KEEP_SIZE : un trou en fin de fichier ne le raccourcit pas. Avec mmap,
+    // la projection partagee voit aussitot des zeros.
+    return fallocate(io->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, (off_t)offset, (off_t)len);
+#else
+    (void)len;
+    errno = EOPNOTSUPP;
+    return -1;
+#endif
+}
+
+int io_truncate(IoFile *io, uint64_t size) {
+    if (size >= io_size(io)) return io_extend(io, size);
+    if (ftruncate(io->fd, (off_t)size) != 0) return -1;
+    // La projection garde sa reservation : seule la taille visible diminue
+    if (io->backend == IO_BACKEND_MMAP) io->size = size;
+    return 0;
+}
+
+int io_sync(IoFile *io) {
+    uint64_t writes = io->writes;
+    if (io->backend == IO_BACKEND_MMAP && io->size > 0 &&
+        msync(io->map, (size_t)io->size, MS_SYNC) != 0) {
+        return -1;
+    }
+#ifdef __APPLE__
+    if (fsync(io->fd) != 0) return -1;
+#else
+    if (fdatasync(io->fd) != 0) return -1;
+#endif
+    io->synced = writes;
+    return 0;
+}
+
+uint64_t io_write_count(IoFile *io) {
+    return io->writes;
+}
+
+int io_unsynced(IoFile *io) {
+    return io->writes != io->synced;
+}
+
+int io_backend_from_name(const char *name) {
+    if (!name) return 0;
+    if (strcmp(name, "pread") == 0) return IO_BACKEND_PREAD;
+    if (strcmp(name, "mmap") == 0) return IO_BACKEND_MMAP;
+    return 0;
+}
+
+const char *io_backend_name(int backend) {
+    return backend == IO_BACKEND_MMAP ? "mmap" : "pread";
+}
@@ -0,0 +1,147 @@
+#include "../../include/lz.h"
+
+#include <string.h>
+
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 65535
+#define LZ_LAST_LITERALS 5   // Le bloc finit toujours par des littéraux
+#define LZ_MATCH_LIMIT 12    // Pas de copie commençant aussi près de la fin
+#define LZ_HASH_BITS 12
+
+static uint32_t read32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint32_t lz_hash(uint32_t v) {
+    return (v * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+
+// Longueur au-delà de 15 : suite d'octets 255 terminée par le reste
+static uint8_t *put_length(uint8_t *op, size_t length) {
+    while (length >= 255) {
+        *op++ = 255;
+        length -= 255;
+    }
+    *op++ = (uint8_t)length;
+    return op;
+}
+
+// Ecrit une séquence : littéraux [lit, lit + lit_len), puis une copie de
+// match_len octets à offset en arrière (aucune si match_len vaut 0)
+static uint8_t *put_sequence(uint8_t *op, uint8_t *end, const uint8_t *lit, size_t lit_len,
+                             size_t offset, size_t match_len) {
+    // Pire cas : jeton, longueurs étendues, littéraux, offset
+    size_t worst = 1 + lit_len / 255 + 1 + lit_len + 2 + match_len / 255 + 1;
+    if ((size_t)(end - op) < worst) return NULL;
+
+    uint8_t *token = op++;
+    *token = (uint8_t)((lit_len >= 15 ? 15 : lit_len) << 4);
+    if (lit_len >= 15) op = put_length(op, lit_len - 15);
+    memcpy(op, lit, lit_len);
+    op += lit_len;
+
+    if (match_len == 0) return op;
+
+    *op++ = (uint8_t)(offset & 0xff);
+    *op++ = (uint8_t)(offset >> 8);
+    size_t ml = match_len - LZ_MIN_MATCH;
+    *token |= (uint8_t)(ml >= 15 ? 15 : ml);
+    if (ml >= 15) op = put_length(op, ml - 15);
+    return op;
+}
+
+size_t lz_compress(const uint8_t *src, size_t len, uint8_t *dst, size_t cap) {
+    uint32_t table[1 << LZ_HASH_BITS];
+    uint8_t *op = dst;
+    uint8_t *end = dst + cap;
+    size_t anchor = 0;
+
+    if (len > LZ_MATCH_LIMIT) {
+        memset(table, 0, sizeof(table));
+        size_t limit = len - LZ_MATCH_LIMIT;
+        size_t match_end = len - LZ_LAST_LITERALS;
+        size_t ip = 0;
+
+        while (ip < limit) {
+            uint32_t seq = read32(src + ip);
+            uint32_t h = lz_hash(seq);
+            size_t ref = table[h];
+            table[h] = (uint32_t)ip;
+
+            if (ref >= ip || ip - ref > LZ_MAX_OFFSET || read32(src + ref) != seq) {
+                // Plus les littéraux s'accumulent, plus on avance vite : une
+                // zone incompressible est traversée sans tout essayer
+                ip += 1 + ((ip - anchor) >> 6);
+                continue;
+            }
+
+            size_t m = ip + LZ_MIN_MATCH;
+            size_t r = ref + LZ_MIN_MATCH;
+            while (m < match_end && src[m] == src[r]) {
+                m++;
+                r++;
+            }
+
+            op = put_sequence(op, end, src + anchor, ip - anchor, ip - ref, m - ip);
+            if (!op) return 0;
+            ip = m;
+            anchor = ip;
+            if (ip >= 2 && ip < limit) table[lz_hash(read32(src + ip - 2))] = (uint32_t)(ip - 2);
+        }
+    }
+
+    op = put_sequence(op, end, src + anchor, len - anchor, 0, 0);
+    if (!op) return 0;
+    return (size_t)(op - dst);
+}
+
+// Lit une longueur étendue. -1 si le bloc s'arrête au milieu.
+static int get_length(const uint8_t *src, size_t len, size_t *ip, size_t *length) {
+    uint8_t b;
+    do {
+        if (*ip >= len) return -1;
+        b = src[(*ip)++];
+        *length += b;
+    } while (b == 255);
+    return 0;
+}
+
+int lz_decompress(const uint8_t *src, size_t len, uint8_t *dst, size_t out_len) {
+    size_t ip = 0;
+    size_t op = 0;
+
+    while (ip < len) {
+        uint8_t token = src[ip++];
+
+        size_t lit_len = token >> 4;
+        if (lit_len == 15 && get_length(src, len, &ip, &lit_len) != 0) return -1;
+        if (lit_len > len - ip || lit_len > out_len - op) return -1;
+        memcpy(dst + op, src + ip, lit_len);
+        ip += lit_len;
+        op += lit_len;
+
+        if (ip == len) break; // Dernière séquence : littéraux seuls
+
+        if (len - ip < 2) return -1;
+        size_t offset = (size_t)src[ip] | ((size_t)src[ip + 1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > op) return -1;
+
+        size_t match_len = token & 15;
+        if (match_len == 15 && get_length(src, len, &ip, &match_len) != 0) return -1;
+        match_len += LZ_MIN_MATCH;
+        if (match_len > out_len - op) return -1;
+
+        // Copie qui peut recouvrir sa source (motif répété)
+        const uint8_t *from = dst + op - offset;
+        if (offset >= match_len) {
+            memcpy(dst + op, from, match_len);
+        } else {
+            for (size_t i = 0; i < match_len; i++) dst[op + i] = from[i];
+        }
+        op += match_len;
+    }
+    return op == out_len ? 0 : -1;
+}
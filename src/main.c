@@ -9,6 +9,7 @@ static void print_usage(const char *prog) {
     printf("Usage:\n");
     printf("  %s <container> [shell]                        - Ouvrir en mode shell (défaut)\n", prog);
     printf("  %s <container> create                         - Créer un nouveau FS\n", prog);
+    printf("  %s <container> upgrade                        - Convertir une image v2 au format actuel\n", prog);
     printf("  %s <container> mkdir <chemin>                 - Créer un répertoire\n", prog);
     printf("  %s <container> add <fichier> [chemin_fs]      - Ajouter un fichier (chemin par défaut: /<basename>)\n", prog);
     printf("  %s <container> extract <chemin_fs> <dest>     - Extraire un fichier\n", prog);
@@ -82,6 +83,10 @@ int main(int argc, char *argv[]) {
         return fs_create(container);
     }
 
+    if (strcmp(cmd, "upgrade") == 0) {
+        return fs_upgrade(container);
+    }
+
     if (strcmp(cmd, "mkdir") == 0 && argc == 4) {
         FileSystem *fs = fs_open(container);
         if (!fs) return EXIT_FAILURE;
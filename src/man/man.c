@@ -203,17 +203,21 @@ static const ManPage man_pages[] = {
     },
     {
         .name = "cat",
-        .synopsis = "cat <chemin>",
+        .synopsis = "cat [-o début] [-n octets] <chemin>",
         .description =
             "Affiche le contenu d'un fichier sur la sortie standard.\n"
             "\n"
-            "Lit et affiche l'intégralité du contenu du fichier spécifié.\n"
-            "Utile pour visualiser des fichiers texte. Supporte les wildcards\n"
+            "Lit et affiche l'intégralité du contenu du fichier spécifié, ou une\n"
+            "plage seulement avec -o et -n. Sur un fichier compressé, seuls les\n"
+            "morceaux de la plage sont décodés. Supporte les wildcards\n"
             "'*' et '?' sur le chemin (ex: cat /docs/*.txt).",
-        .options = NULL,
+        .options =
+            "-o <début>   Commencer à cet octet\n"
+            "-n <octets>  Afficher au plus ce nombre d'octets",
         .examples =
             "cat README.md            Affiche le contenu de README.md\n"
-            "cat /docs/notes.txt      Affiche /docs/notes.txt",
+            "cat /docs/notes.txt      Affiche /docs/notes.txt\n"
+            "cat -o 1048576 -n 200 app.log  200 octets à partir de 1 Mio",
         .see_also = "add, extract, ls"
     },
     {
@@ -259,13 +263,38 @@ static const ManPage man_pages[] = {
             "Crée une copie du fichier source avec le chemin destination spécifié.\n"
             "La destination ne doit pas exister. Le répertoire parent de la destination\n"
             "doit exister. La taille et le contenu du fichier original sont préservés.\n"
-            "Supporte les wildcards '*' et '?' sur la source (ex: cp /src/*.txt /bak/).",
+            "Supporte les wildcards '*' et '?' sur la source (ex: cp /src/*.txt /bak/).\n"
+            "\n"
+            "La copie est un clone : elle partage les blocs de la source (compression\n"
+            "et sommes de contrôle comprises) au lieu de les recopier, quelle que soit\n"
+            "leur taille, et n'occupe pas de place en plus. Une modification de l'un\n"
+            "des deux fichiers s'écrit dans des blocs neufs ; les blocs partagés ne\n"
+            "sont libérés qu'avec leur dernier fichier.",
         .options = NULL,
         .examples =
             "cp notes.txt notes_backup.txt    Copie notes.txt en notes_backup.txt\n"
             "cp file.txt /docs/file.txt       Copie file.txt dans /docs/\n"
             "cp /src/data.csv /backup/data.csv    Copie entre répertoires",
-        .see_also = "extract, add, rm"
+        .see_also = "extract, add, rm, ln"
+    },
+    {
+        .name = "ln",
+        .synopsis = "ln <cible> <lien>",
+        .description =
+            "Crée un lien physique : un nom de plus pour un fichier existant.\n"
+            "\n"
+            "Le lien et la cible désignent le même contenu, sans copie : compress,\n"
+            "par exemple, vaut pour tous les noms. stat affiche le nombre de noms\n"
+            "du fichier. rm retire un nom ; les données ne sont libérées qu'avec le\n"
+            "dernier, et mv déplace un nom sans toucher aux autres. Les répertoires\n"
+            "ne peuvent pas être liés. Comme pour cp, la source accepte les\n"
+            "wildcards et la destination peut être un répertoire. L'éditeur\n"
+            "réécrit le contenu partagé : tous les noms voient la modification.",
+        .options = NULL,
+        .examples =
+            "ln /data/big.bin /projets/a/big.bin   Expose le fichier sous un autre répertoire\n"
+            "ln /logs/*.log /archive/              Un nom de plus par journal dans /archive",
+        .see_also = "cp, rm, mv, stat"
     },
     {
         .name = "rm",
@@ -286,6 +315,151 @@ static const ManPage man_pages[] = {
             "rm -rf /temp/logs        Force la suppression même si des entrées manquent",
         .see_also = "mkdir, add, cp"
     },
+    {
+        .name = "compress",
+        .synopsis = "compress [-d] <chemin>",
+        .description =
+            "Compresse un fichier, ou active la compression d'un répertoire.\n"
+            "\n"
+            "Un fichier compressé est découpé en morceaux de 64 Kio compressés\n"
+            "séparément (codec LZ rapide), précédés de la table de leurs positions :\n"
+            "une lecture ne décode que les morceaux qu'elle touche. Un morceau qui ne\n"
+            "raccourcit pas est gardé tel quel, et un fichier qui ne gagne pas au moins\n"
+            "un bloc reste en clair. Sur un répertoire, les fichiers ajoutés dessous\n"
+            "ensuite sont compressés (une copie garde le stockage de sa source), et les sous-répertoires créés héritent\n"
+            "du réglage. La lecture (cat, extract, cp) est transparente.",
+        .options =
+            "-d           Décompresser le fichier, ou désactiver la compression du répertoire",
+        .examples =
+            "compress /logs           Compresse les fichiers ajoutés sous /logs\n"
+            "compress /logs/app.log   Réécrit app.log compressé\n"
+            "compress -d /logs/*.log  Repasse les journaux en clair",
+        .see_also = "add, cp, cat, stat"
+    },
+    {
+        .name = "defrag",
+        .synopsis = "defrag [-s] [-t ms] [-b octets]",
+        .description =
+            "Défragmente les données du conteneur.\n"
+            "\n"
+            "Les contenus qui finissent le plus loin sont recopiés d'un seul tenant dans\n"
+            "la plage libre la plus basse, puis la fin des données est ramenée sur le\n"
+            "dernier octet occupé. Un fichier fragmenté sans plage assez grande est\n"
+            "recopié en fin de données. Le travail est validé par tranches : une passe\n"
+            "interrompue laisse une image cohérente, et la suivante reprend où elle\n"
+            "s'était arrêtée. La fragmentation est affichée avant et après.",
+        .options =
+            "-s           Afficher la fragmentation sans rien déplacer\n"
+            "-t <ms>      S'arrêter après ms millisecondes\n"
+            "-b <octets>  Déplacer au plus ce nombre d'octets",
+        .examples =
+            "defrag                   Défragmente tout le conteneur\n"
+            "defrag -t 200            Passe d'au plus 200 ms\n"
+            "defrag -s                État de la fragmentation",
+        .see_also = "rm, trim, fetch"
+    },
+    {
+        .name = "trim",
+        .synopsis = "trim",
+        .description =
+            "Rend l'espace libre du conteneur au système hôte.\n"
+            "\n"
+            "Le fichier image est tronqué à la fin des données, et les plages libres\n"
+            "qui restent avant sont percées (FALLOC_FL_PUNCH_HOLE) : elles se lisent\n"
+            "comme des zéros et n'occupent plus de place sur le disque hôte. Les\n"
+            "plages libérées d'au moins 64 Kio le sont déjà au fil des suppressions.\n"
+            "Lancer defrag d'abord rapproche les données du début et libère davantage.",
+        .options = NULL,
+        .examples =
+            "trim                     Rend l'espace libre et raccourcit l'image",
+        .see_also = "defrag, rm"
+    },
+    {
+        .name = "dedup",
+        .synopsis = "dedup [on|off]",
+        .description =
+            "Active ou désactive la déduplication des blocs, ou affiche son état.\n"
+            "\n"
+            "En mode dédupliqué, chaque bloc de 4 Kio des fichiers ajoutés ou\n"
+            "enregistrés par l'éditeur reçoit une empreinte. Un bloc dont l'empreinte\n"
+            "est connue est comparé octet par octet au bloc déjà écrit, puis partagé\n"
+            "au lieu d'être recopié. Chaque zone partagée porte un compteur de\n"
+            "références : elle n'est libérée qu'avec son dernier fichier. Le réglage\n"
+            "est gardé dans l'image ; les fichiers compressés ne sont pas dédupliqués.",
+        .options = NULL,
+        .examples =
+            "dedup on                 Partage les blocs des prochains ajouts\n"
+            "dedup                    Affiche l'état",
+        .see_also = "dedup-stats, add, cp"
+    },
+    {
+        .name = "dedup-stats",
+        .synopsis = "dedup-stats",
+        .description =
+            "Affiche le bilan de la déduplication.\n"
+            "\n"
+            "Blocs dont l'empreinte est indexée, taille cumulée des fichiers, données\n"
+            "référencées plusieurs fois, et octets économisés : ceux qu'occuperaient\n"
+            "les copies si chaque fichier avait ses propres blocs.",
+        .options = NULL,
+        .examples =
+            "dedup-stats              Octets économisés par le partage",
+        .see_also = "dedup, defrag"
+    },
+    {
+        .name = "checksum",
+        .synopsis = "checksum [sha256 on|off | verify off|warn|strict]",
+        .description =
+            "Affiche ou change les réglages des sommes de contrôle.\n"
+            "\n"
+            "Chaque fichier écrit (add, compress, éditeur) reçoit un CRC32C par\n"
+            "bloc de 4 Kio de son contenu, calculé pendant l'écriture et rangé après\n"
+            "ses données ; une copie (cp) partage la table de sa source. Avec\n"
+            "sha256 on, le SHA-256 du fichier entier est ajouté ; ce réglage est\n"
+            "gardé dans l'image.\n"
+            "\n"
+            "cat, extract et l'éditeur vérifient chaque bloc lu. En mode strict (par\n"
+            "défaut), la lecture s'arrête au premier bloc corrompu et extract ne\n"
+            "laisse pas de copie partielle ; warn signale sans interrompre ; off ne\n"
+            "vérifie rien. Le mode vaut pour la session et se règle aussi au\n"
+            "lancement avec la variable CSFS_VERIFY.",
+        .options =
+            "sha256 on|off    SHA-256 du contenu entier pour les prochains fichiers\n"
+            "verify MODE      Vérification des lectures : off, warn ou strict",
+        .examples =
+            "checksum                 Affiche l'implémentation CRC32C et les réglages\n"
+            "checksum verify warn     Signale les blocs corrompus sans s'arrêter",
+        .see_also = "stat, cat, extract"
+    },
+    {
+        .name = "snapshot",
+        .synopsis = "snapshot [list | create <nom> | restore <nom> | delete <nom>]",
+        .description =
+            "Gère les instantanés de l'arborescence.\n"
+            "\n"
+            "create fige toute l'arborescence sous /@snap/<nom> : chaque entrée\n"
+            "est recopiée et chaque fichier devient un clone qui partage ses blocs\n"
+            "avec l'original (comme cp), sans lire ni écrire de données. /@snap\n"
+            "n'apparaît pas dans ls / mais se parcourt par son chemin (cd, ls, cat,\n"
+            "stat, extract) ; son contenu est en lecture seule et cp en ressort un\n"
+            "fichier sans recopie.\n"
+            "\n"
+            "restore remplace l'arborescence vivante par l'instantané, qui est\n"
+            "gardé. delete rend les blocs que seul l'instantané référençait. Sans\n"
+            "argument, ou avec list, affiche la date, le nombre d'entrées et la\n"
+            "taille de chaque instantané.",
+        .options =
+            "list             Liste les instantanés (par défaut)\n"
+            "create NOM       Crée un instantané\n"
+            "restore NOM      Remet l'arborescence dans l'état de l'instantané\n"
+            "delete NOM       Supprime un instantané",
+        .examples =
+            "snapshot create avant-maj    Fige l'état actuel\n"
+            "cd @snap/avant-maj           Parcourt l'instantané\n"
+            "cp /@snap/avant-maj/a.txt /a.txt   Récupère un seul fichier\n"
+            "snapshot restore avant-maj   Revient à l'état figé",
+        .see_also = "cp, ls, cd"
+    },
     {
         .name = "help",
         .synopsis = "help",
@@ -322,9 +496,10 @@ static const ManPage man_pages[] = {
         .name = "mv",
         .synopsis = "mv <source> <destination>",
         .description =
-            "Déplace ou renomme un fichier à l'intérieur du système de fichiers.\n"
+            "Déplace ou renomme un fichier ou un répertoire à l'intérieur du système de fichiers.\n"
             "\n"
-            "Déplace le fichier source vers la destination spécifiée.\n"
+            "Déplace la source vers la destination spécifiée. Un répertoire est déplacé avec\n"
+            "tout son contenu ; il ne peut pas être déplacé dans l'un de ses sous-répertoires.\n"
             "La destination ne doit pas exister. Le répertoire parent de la destination\n"
             "doit exister. Le contenu et la taille du fichier sont préservés.\n"
             "Peut être utilisé pour renommer un fichier ou le déplacer vers un autre répertoire.\n"
@@ -333,6 +508,7 @@ static const ManPage man_pages[] = {
         .examples =
             "mv old.txt new.txt       Renomme old.txt en new.txt\n"
             "mv file.txt /docs/       Déplace file.txt vers /docs/\n"
+            "mv /projets /archives/   Déplace le répertoire /projets et son contenu\n"
             "mv /src/data.csv /backup/data.csv    Déplace vers un nouveau répertoire",
         .see_also = "cp, rm, cd"
     },
@@ -0,0 +1,153 @@
+#include "../../include/refmap.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+void refmap_init(RefMap *rm) {
+    rm->runs = NULL;
+    rm->count = 0;
+    rm->capacity = 0;
+}
+
+void refmap_destroy(RefMap *rm) {
+    free(rm->runs);
+    refmap_init(rm);
+}
+
+static int refmap_reserve(RefMap *rm, uint32_t needed) {
+    if (needed <= rm->capacity) return 0;
+
+    uint32_t capacity = rm->capacity ? rm->capacity * 2 : 64;
+    while (capacity < needed) capacity *= 2;
+
+    RefRun *runs = realloc(rm->runs, capacity * sizeof(RefRun));
+    if (!runs) return -1;
+    rm->runs = runs;
+    rm->capacity = capacity;
+    return 0;
+}
+
+// Première plage qui se termine après offset
+static uint32_t first_ending_after(const RefMap *rm, uint64_t offset) {
+    uint32_t lo = 0, hi = rm->count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (rm->runs[mid].offset + rm->runs[mid].length <= offset) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static void piece_push(RefRun *pieces, uint32_t *n, uint64_t offset, uint64_t length, uint64_t refs) {
+    if (length == 0 || refs == 0) return;
+    RefRun *last = *n > 0 ? &pieces[*n - 1] : NULL;
+    if (last && last->refs == refs && last->offset + last->length == offset) {
+        last->length += length;
+        return;
+    }
+    pieces[(*n)++] = (RefRun){ offset, length, refs };
+}
+
+// Ajoute delta (+1 ou -1) aux références de [offset, offset + length). Les
+// plages touchées sont recalculées à part puis remises à leur place ; les
+// parties qui perdent leur seule référence vont ensuite à release.
+static int refmap_apply(RefMap *rm, uint64_t offset, uint64_t length, int delta, RefRelease release,
+                        void *ctx) {
+    if (length == 0) return 0;
+    uint64_t end = offset + length;
+
+    // Fenêtre [first, last) des plages qui chevauchent, élargie aux voisines
+    // contiguës pour les fusionner
+    uint32_t first = first_ending_after(rm, offset);
+    if (first > 0 && rm->runs[first - 1].offset + rm->runs[first - 1].length == offset) first--;
+    uint32_t last = first;
+    while (last < rm->count && rm->runs[last].offset <= end) last++;
+
+    uint32_t window = last - first;
+    RefRun *pieces = malloc((2 * (size_t)window + 3) * sizeof(RefRun));
+    RefRun *gaps = malloc(((size_t)window + 1) * sizeof(RefRun));
+    if (!pieces || !gaps) {
+        free(pieces);
+        free(gaps);
+        return -1;
+    }
+
+    uint32_t n = 0;
+    uint32_t gap_count = 0;
+    uint64_t cursor = offset;
+    for (uint32_t i = first; i <= last; i++) {
+        // Après la dernière plage : le trou qui reste jusqu'à end
+        const RefRun *r = i < last ? &rm->runs[i] : NULL;
+        uint64_t r_end = r ? r->offset + r->length : end;
+        if (r && r->offset < offset) {
+            uint64_t stop = r_end < offset ? r_end : offset;
+            piece_push(pieces, &n, r->offset, stop - r->offset, r->refs);
+        }
+        uint64_t from = r ? (r->offset > offset ? r->offset : offset) : end;
+        if (from > cursor) {
+            // Trou : une seule référence jusque-là
+            if (delta > 0) piece_push(pieces, &n, cursor, from - cursor, 1);
+            else gaps[gap_count++] = (RefRun){ cursor, from - cursor, 0 };
+            cursor = from;
+        }
+        if (!r) break;
+        uint64_t to = r_end < end ? r_end : end;
+        if (to > from) {
+            piece_push(pieces, &n, from, to - from, r->refs + (uint64_t)(int64_t)delta);
+            cursor = to;
+        }
+        if (r_end > end) {
+            uint64_t start = r->offset > end ? r->offset : end;
+            piece_push(pieces, &n, start, r_end - start, r->refs);
+        }
+    }
+
+    if (refmap_reserve(rm, rm->count - window + n) != 0) {
+        free(pieces);
+        free(gaps);
+        return -1;
+    }
+    memmove(&rm->runs[first + n], &rm->runs[last], (rm->count - last) * sizeof(RefRun));
+    memcpy(&rm->runs[first], pieces, n * sizeof(RefRun));
+    rm->count = rm->count - window + n;
+    for (uint32_t g = 0; g < gap_count && release; g++) release(ctx, gaps[g].offset, gaps[g].length);
+    free(pieces);
+    free(gaps);
+    return 0;
+}
+
+int refmap_add(RefMap *rm, uint64_t offset, uint64_t length) {
+    return refmap_apply(rm, offset, length, 1, NULL, NULL);
+}
+
+int refmap_drop(RefMap *rm, uint64_t offset, uint64_t length, RefRelease release, void *ctx) {
+    return refmap_apply(rm, offset, length, -1, release, ctx);
+}
+
+uint64_t refmap_shared(const RefMap *rm, uint64_t offset, uint64_t length) {
+    uint64_t end = offset + length;
+    uint64_t shared = 0;
+    for (uint32_t i = first_ending_after(rm, offset); i < rm->count && rm->runs[i].offset < end; i++) {
+        uint64_t from = rm->runs[i].offset > offset ? rm->runs[i].offset : offset;
+        uint64_t r_end = rm->runs[i].offset + rm->runs[i].length;
+        shared += (r_end < end ? r_end : end) - from;
+    }
+    return shared;
+}
+
+uint64_t refmap_saved(const RefMap *rm) {
+    uint64_t saved = 0;
+    for (uint32_t i = 0; i < rm->count; i++) saved += rm->runs[i].length * rm->runs[i].refs;
+    return saved;
+}
+
+int refmap_append(RefMap *rm, uint64_t offset, uint64_t length, uint64_t refs) {
+    if (refs == 0 || length == 0) return -1;
+    if (rm->count > 0) {
+        const RefRun *last = &rm->runs[rm->count - 1];
+        if (offset < last->offset + last->length) return -1;
+    }
+    if (refmap_reserve(rm, rm->count + 1) != 0) return -1;
+    rm->runs[rm->count++] = (RefRun){ offset, length, refs };
+    return 0;
+}
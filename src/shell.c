@@ -1,3 +1,7 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // FTW_PHYS
+#endif
+
 #include "../include/fs.h"
 #include "../include/man.h"
 #include "../include/shell.h"
@@ -199,13 +203,10 @@ static char *resolve_path(const Shell *shell, const char *arg_path) {
     return result;
 }
 
-static void build_full_path_from_inode(const Inode *inode, char *out, size_t size) {
-    if (strcmp(inode->parent_path, "/") == 0) {
-        snprintf(out, size, "/%s", inode->filename);
-    } else {
-        snprintf(out, size, "%s/%s", inode->parent_path, inode->filename);
+static void build_full_path_from_inode(Shell *shell, int inode_index, char *out, size_t size) {
+    if (fs_inode_path(shell->fs, inode_index, out, size) != 0) {
+        out[0] = '\0';
     }
-    out[size - 1] = '\0';
 }
 
 static int inode_index_for_path(Shell *shell, const char *path, int *is_dir_out) {
@@ -214,19 +215,11 @@ static int inode_index_for_path(Shell *shell, const char *path, int *is_dir_out)
         return -1;
     }
 
-    for (int i = 0; i < shell->fs->sb.max_files; i++) {
-        Inode *inode = get_inode(shell->fs, i);
-        if (inode->filename[0] != '\0') {
-            char full_path[MAX_PATH];
-            build_full_path_from_inode(inode, full_path, sizeof(full_path));
-            if (strcmp(full_path, path) == 0) {
-                if (is_dir_out) *is_dir_out = inode->is_directory;
-                return i;
-            }
-        }
+    int idx = fs_lookup(shell->fs, path);
+    if (idx != -1 && is_dir_out) {
+        *is_dir_out = get_inode(shell->fs, idx)->type == INODE_DIR;
     }
-
-    return -1;
+    return idx;
 }
 
 static int wildcard_match(const char *pattern, const char *str) {
@@ -263,6 +256,53 @@ static int has_glob(const char *s) {
     return strpbrk(s, "*?") != NULL;
 }
 
+// Vrai si une chaîne commençant par str peut correspondre au motif : permet
+// d'écarter un sous-arbre entier sans le parcourir
+static int wildcard_prefix_match(const char *pattern, const char *str) {
+    if (*str == '\0') return 1;
+    if (*pattern == '\0') return 0;
+
+    if (*pattern == '*') {
+        return wildcard_prefix_match(pattern + 1, str) || wildcard_prefix_match(pattern, str + 1);
+    }
+
+    if (*pattern == '?' || *pattern == *str) {
+        return wildcard_prefix_match(pattern + 1, str + 1);
+    }
+
+    return 0;
+}
+
+static void glob_subtree(Shell *shell, int dir_idx, const char *pattern,
+                         char results[][MAX_PATH], int max_results, int *count) {
+    FsDirIter iter;
+    if (fs_dir_open(shell->fs, dir_idx, &iter) != 0) return;
+
+    int i;
+    while (*count < max_results && (i = fs_dir_next(&iter)) != -1) {
+        char full_path[MAX_PATH];
+        build_full_path_from_inode(shell, i, full_path, sizeof(full_path));
+
+        if (wildcard_match(pattern, full_path)) {
+            strncpy(results[*count], full_path, MAX_PATH - 1);
+            results[*count][MAX_PATH - 1] = '\0';
+            (*count)++;
+        }
+
+        if (get_inode(shell->fs, i)->type == INODE_DIR) {
+            size_t len = strlen(full_path);
+            if (len + 1 < sizeof(full_path)) {
+                full_path[len] = '/';
+                full_path[len + 1] = '\0';
+                if (wildcard_prefix_match(pattern, full_path)) {
+                    glob_subtree(shell, i, pattern, results, max_results, count);
+                }
+            }
+        }
+    }
+    fs_dir_close(&iter);
+}
+
 static int delete_path(Shell *sh, const char *abs_path, int recursive, int force) {
     if (strcmp(abs_path, "/") == 0) {
         fprintf(stderr, "rm: refus de supprimer la racine\n");
@@ -277,56 +317,31 @@ static int delete_path(Shell *sh, const char *abs_path, int recursive, int force
     }
 
     if (is_dir) {
-        int has_child = 0;
-        for (int i = 0; i < sh->fs->sb.max_files; i++) {
-            Inode *inode = get_inode(sh->fs, i);
-            if (inode->filename[0] != '\0' &&
-                strcmp(inode->parent_path, abs_path) == 0) {
-                has_child = 1;
-                if (!recursive) {
-                    fprintf(stderr, "rm: '%s' n'est pas vide (utiliser -r)\n", abs_path);
-                    return -1;
-                }
-            }
+        FsDirIter iter;
+        if (fs_dir_open(sh->fs, idx, &iter) != 0) return -1;
+        if (iter.count > 0 && !recursive) {
+            fprintf(stderr, "rm: '%s' n'est pas vide (utiliser -r)\n", abs_path);
+            fs_dir_close(&iter);
+            return -1;
         }
 
-        if (has_child && recursive) {
-            for (int i = 0; i < sh->fs->sb.max_files; i++) {
-                Inode *inode = get_inode(sh->fs, i);
-                if (inode->filename[0] != '\0' &&
-                    strcmp(inode->parent_path, abs_path) == 0) {
-                    char child_path[MAX_PATH];
-                    build_full_path_from_inode(inode, child_path, sizeof(child_path));
-                    if (delete_path(sh, child_path, recursive, force) != 0 && !force) {
-                        return -1;
-                    }
-                }
+        int child;
+        while ((child = fs_dir_next(&iter)) != -1) {
+            char child_path[MAX_PATH];
+            build_full_path_from_inode(sh, child, child_path, sizeof(child_path));
+            if (delete_path(sh, child_path, recursive, force) != 0 && !force) {
+                fs_dir_close(&iter);
+                return -1;
             }
         }
+        fs_dir_close(&iter);
+    }
+
+    // Libère les extents du fichier et retire l'entrée de l'index
+    if (fs_remove(sh->fs, abs_path) != 0) {
+        return -1;
     }
 
-    Inode *inode = get_inode(sh->fs, idx);
-    
-    // Si c'est un fichier, libérer ses blocs
-    if (!inode->is_directory && inode->size > 0) {
-        uint64_t offset = inode->offset;
-        uint64_t num_blocks = (inode->size + BLOCK_SIZE - 1) / BLOCK_SIZE;
-        
-        for (uint64_t i = 0; i < num_blocks; i++) {
-            uint64_t block_offset = offset + (i * BLOCK_SIZE);
-            FreeBlock fb;
-            fb.next_free_block = sh->fs->sb.first_free_block;
-            
-            fseek(sh->fs->container, (long)block_offset, SEEK_SET);
-            fwrite(&fb, sizeof(FreeBlock), 1, sh->fs->container);
-            
-            sh->fs->sb.first_free_block = block_offset;
-        }
-    }
-
-    inode->filename[0] = '\0';
-    mark_inode_dirty(sh->fs, idx);
-    sh->fs->sb.num_files--;
     if (!force) printf("Supprimé: %s\n", abs_path);
     return 0;
 }
@@ -348,18 +363,15 @@ static int expand_fs_glob(Shell *shell, const char *input, char results[][MAX_PA
     strip_trailing_slash(pattern);
 
     int count = 0;
-    for (int i = 0; i < MAX_FILES && count < max_results; i++) {
-        Inode *inode = get_inode(shell->fs, i);
-        if (inode->filename[0] != '\0') {
-            char full_path[MAX_PATH];
-            build_full_path_from_inode(inode, full_path, sizeof(full_path));
-
-            if (wildcard_match(pattern, full_path)) {
-                strncpy(results[count], full_path, MAX_PATH - 1);
-                results[count][MAX_PATH - 1] = '\0';
-                count++;
-            }
+    if (!has_glob(pattern)) {
+        int idx = fs_lookup(shell->fs, pattern);
+        if (idx != -1 && idx != ROOT_INODE && max_results > 0) {
+            strncpy(results[0], pattern, MAX_PATH - 1);
+            results[0][MAX_PATH - 1] = '\0';
+            count = 1;
         }
+    } else {
+        glob_subtree(shell, ROOT_INODE, pattern, results, max_results, &count);
     }
 
     if ((strcmp(pattern, "/") == 0 || strcmp(pattern, "/*") == 0) && count < max_results) {
@@ -385,13 +397,21 @@ static int cmd_help(Shell *shell, Command *cmd) {
     printf("  cd <chemin>       - Changer de répertoire\n");
     printf("  mkdir <chemin>    - Créer un répertoire\n");
     printf("  add <fichier>     - Ajouter un fichier\n");
-    printf("  cat <chemin>      - Afficher le contenu d'un fichier\n");
+    printf("  cat [-o n] [-n n] <chemin> - Afficher (une plage d')un fichier\n");
     printf("  stat <chemin>     - Métadonnées détaillées\n");
     printf("  cp <src> <dest>   - Copier un fichier\n");
+    printf("  ln <cible> <lien> - Donner un nom de plus à un fichier\n");
     printf("  mv <src> <dest>   - Déplacer/renommer un fichier ou répertoire\n");
     printf("  extract <src> [dest] - Extraire un fichier\n");
     printf("  rm <chemin>       - Supprimer un fichier/répertoire\n");
     printf("  edit <fichier>    - Éditer un fichier (type nano)\n");
+    printf("  compress [-d] <chemin> - Compresser un fichier ou un répertoire\n");
+    printf("  defrag [options]  - Défragmenter les données\n");
+    printf("  trim              - Rendre l'espace libre à l'hôte\n");
+    printf("  dedup [on|off]    - Partager les blocs identiques\n");
+    printf("  dedup-stats       - Octets économisés par le partage\n");
+    printf("  checksum [opts]   - Sommes de contrôle et vérification\n");
+    printf("  snapshot [action] - Instantanés (list, create, restore, delete)\n");
     printf("  fetch [opts]      - Afficher infos type neofetch\n");
     printf("  clear             - Effacer l'écran\n");
     printf("  exit              - Quitter le shell\n");
@@ -471,23 +491,7 @@ static int cmd_cd(Shell *shell, Command *cmd) {
     if (strcmp(resolved, "/") == 0) {
         is_dir = 1;
     } else {
-        for (int i = 0; i < MAX_FILES; i++) {
-            Inode *inode = get_inode(shell->fs, i);
-            if (inode->filename[0] != '\0') {
-                char full_path[MAX_PATH];
-                if (strcmp(inode->parent_path, "/") == 0) {
-                    snprintf(full_path, MAX_PATH, "/%s", inode->filename);
-                } else {
-                    snprintf(full_path, MAX_PATH, "%s/%s", inode->parent_path,
-                             inode->filename);
-                }
-                if (strcmp(full_path, resolved) == 0) {
-                    idx = i;
-                    is_dir = inode->is_directory;
-                    break;
-                }
-            }
-        }
+        idx = inode_index_for_path(shell, resolved, &is_dir);
     }
 
     if (idx == -1 && strcmp(resolved, "/") != 0) {
@@ -647,6 +651,8 @@ static int cmd_add(Shell *shell, Command *cmd) {
 
     int ret = 0;
 
+    // Tous les ajouts sont validés ensemble
+    fs_txn_begin(shell->fs);
     for (int i = 0; i < src_count; i++) {
         const char *src_path = g.gl_pathv[i];
         struct stat st;
@@ -703,6 +709,7 @@ static int cmd_add(Shell *shell, Command *cmd) {
             if (r != 0) ret = r;
         }
     }
+    fs_txn_commit(shell->fs);
 
     if (resolved_dest) free(resolved_dest);
     globfree(&g);
@@ -710,15 +717,35 @@ static int cmd_add(Shell *shell, Command *cmd) {
 }
 
 static int cmd_cat(Shell *shell, Command *cmd) {
-    if (cmd->argc < 2) {
+    // Plage : -o début, -n nombre d'octets (seuls les morceaux compressés
+    // touchés sont décodés)
+    uint64_t start = 0;
+    uint64_t count = UINT64_MAX;
+    int first_arg = 1;
+    while (first_arg < cmd->argc &&
+           (strcmp(cmd->args[first_arg], "-o") == 0 || strcmp(cmd->args[first_arg], "-n") == 0)) {
+        if (first_arg + 1 >= cmd->argc) {
+            fprintf(stderr, "cat: %s requiert un argument numérique\n", cmd->args[first_arg]);
+            return -1;
+        }
+        uint64_t value = strtoull(cmd->args[first_arg + 1], NULL, 10);
+        if (cmd->args[first_arg][1] == 'o') {
+            start = value;
+        } else {
+            count = value;
+        }
+        first_arg += 2;
+    }
+
+    if (first_arg >= cmd->argc) {
         fprintf(stderr, "cat: argument requis\n");
         return -1;
     }
 
     char matches[MAX_FILES][MAX_PATH];
-    int mcount = expand_fs_glob(shell, cmd->args[1], matches, MAX_FILES);
+    int mcount = expand_fs_glob(shell, cmd->args[first_arg], matches, MAX_FILES);
     if (mcount == 0) {
-        fprintf(stderr, "cat: aucune correspondance pour '%s'\n", cmd->args[1]);
+        fprintf(stderr, "cat: aucune correspondance pour '%s'\n", cmd->args[first_arg]);
         return -1;
     }
 
@@ -737,20 +764,44 @@ static int cmd_cat(Shell *shell, Command *cmd) {
             continue;
         }
 
-        Inode *inode = get_inode(shell->fs, idx);
-        fseek(shell->fs->container, (long)inode->offset, SEEK_SET);
+        // Copie : la lecture peut évincer l'inode du cache
+        Inode inode = *get_inode(shell->fs, idx);
+        FsReader reader;
+        if (fs_reader_open(shell->fs, &inode, &reader) != 0) {
+            ret = -1;
+            continue;
+        }
+        if (fs_reader_seek(&reader, start < inode.size ? start : inode.size) != 0) {
+            fs_reader_close(&reader);
+            ret = -1;
+            continue;
+        }
 
         char buffer[BLOCK_SIZE];
-        uint64_t remaining = inode->size;
-
-        while (remaining > 0) {
-            size_t to_read = (remaining < BLOCK_SIZE) ? (size_t)remaining : BLOCK_SIZE;
-            size_t bytes_read = fread(buffer, 1, to_read, shell->fs->container);
+        char last = '\n';
+        size_t bytes_read;
+        const void *mapped;
+        uint64_t left = count;
+
+        // Conteneur projeté : écriture directe depuis la projection
+        while (left > 0 && (mapped = fs_reader_map(&reader, &bytes_read)) != NULL) {
+            if (bytes_read > left) bytes_read = (size_t)left;
+            fwrite(mapped, 1, bytes_read, stdout);
+            last = ((const char *)mapped)[bytes_read - 1];
+            left -= bytes_read;
+        }
+        size_t want = left < BLOCK_SIZE ? (size_t)left : BLOCK_SIZE;
+        while (left > 0 && (bytes_read = fs_reader_read(&reader, buffer, want)) > 0) {
             fwrite(buffer, 1, bytes_read, stdout);
-            remaining -= bytes_read;
+            last = buffer[bytes_read - 1];
+            left -= bytes_read;
+            if (left < want) want = (size_t)left;
         }
+        // Lecture interrompue : contenu illisible ou corrompu
+        if (left > 0 && reader.remaining > 0) ret = -1;
+        fs_reader_close(&reader);
 
-        if (inode->size > 0 && buffer[(inode->size - 1) % BLOCK_SIZE] != '\n') {
+        if (last != '\n') {
             printf("\n");
         }
     }
@@ -763,25 +814,38 @@ static void extract_recursive_dir(Shell *shell, const char *fs_path, const char
     snprintf(mkdir_cmd, sizeof(mkdir_cmd), "mkdir -p %s", host_base);
     system(mkdir_cmd);
 
-    for (int i = 0; i < MAX_FILES; i++) {
-        Inode *inode = get_inode(shell->fs, i);
-        if (inode->filename[0] != '\0' &&
-            strcmp(inode->parent_path, fs_path) == 0) {
-            char child_fs[MAX_PATH];
-            build_full_path_from_inode(inode, child_fs, sizeof(child_fs));
+    int dir_idx = strcmp(fs_path, "/") == 0 ? ROOT_INODE : fs_lookup(shell->fs, fs_path);
+    if (dir_idx == -1) {
+        *error = -1;
+        return;
+    }
+
+    FsDirIter iter;
+    if (fs_dir_open(shell->fs, dir_idx, &iter) != 0) {
+        *error = -1;
+        return;
+    }
 
-            char child_host[MAX_PATH];
-            snprintf(child_host, sizeof(child_host), "%s/%s", host_base, inode->filename);
+    int i;
+    while ((i = fs_dir_next(&iter)) != -1) {
+        // Copie : les appels récursifs peuvent évincer l'entrée du cache
+        Inode inode = *get_inode(shell->fs, i);
+        char child_fs[MAX_PATH];
+        build_full_path_from_inode(shell, i, child_fs, sizeof(child_fs));
 
-            if (inode->is_directory) {
-                extract_recursive_dir(shell, child_fs, child_host, error);
-            } else {
-                if (fs_extract_file(shell->fs, child_fs, child_host) != 0) {
-                    *error = -1;
-                }
+        char child_host[MAX_PATH];
+        snprintf(child_host, sizeof(child_host), "%s/%s", host_base,
+                 fs_inode_name(shell->fs, &inode));
+
+        if (inode.type == INODE_DIR) {
+            extract_recursive_dir(shell, child_fs, child_host, error);
+        } else {
+            if (fs_extract_file(shell->fs, child_fs, child_host) != 0) {
+                *error = -1;
             }
         }
     }
+    fs_dir_close(&iter);
 }
 
 static int cmd_extract(Shell *shell, Command *cmd) {
@@ -829,6 +893,8 @@ static int cmd_extract(Shell *shell, Command *cmd) {
 
     int ret = 0;
 
+    // Les dates d'accès mises à jour sont validées ensemble
+    fs_txn_begin(shell->fs);
     for (int i = 0; i < mcount; i++) {
         int is_dir = 0;
         int idx = inode_index_for_path(shell, matches[i], &is_dir);
@@ -869,20 +935,24 @@ static int cmd_extract(Shell *shell, Command *cmd) {
             if (r != 0) ret = r;
         }
     }
+    fs_txn_commit(shell->fs);
 
     return ret;
 }
 
-static int cmd_cp(Shell *shell, Command *cmd) {
+// cp et ln : une ou plusieurs sources (wildcards) vers un nom, ou dans un
+// répertoire sous leur nom de base
+static int copy_entries(Shell *shell, Command *cmd, const char *name,
+                        int (*op)(FileSystem *, const char *, const char *)) {
     if (cmd->argc < 3) {
-        fprintf(stderr, "cp: arguments requis (source et destination)\n");
+        fprintf(stderr, "%s: arguments requis (source et destination)\n", name);
         return -1;
     }
 
     char matches[MAX_FILES][MAX_PATH];
     int mcount = expand_fs_glob(shell, cmd->args[1], matches, MAX_FILES);
     if (mcount == 0) {
-        fprintf(stderr, "cp: aucune correspondance pour '%s'\n", cmd->args[1]);
+        fprintf(stderr, "%s: aucune correspondance pour '%s'\n", name, cmd->args[1]);
         return -1;
     }
 
@@ -893,23 +963,24 @@ static int cmd_cp(Shell *shell, Command *cmd) {
     if (dlen > 0 && cmd->args[2][dlen - 1] == '/') dest_is_dir = 1;
 
     if (!dest_is_dir && mcount > 1) {
-        fprintf(stderr, "cp: la destination doit être un répertoire pour plusieurs sources\n");
+        fprintf(stderr, "%s: la destination doit être un répertoire pour plusieurs sources\n", name);
         free(dest_resolved);
         return -1;
     }
 
     int ret = 0;
 
+    fs_txn_begin(shell->fs);
     for (int mi = 0; mi < mcount; mi++) {
         int is_dir = 0;
         int idx = inode_index_for_path(shell, matches[mi], &is_dir);
         if (idx == -1) {
-            fprintf(stderr, "cp: '%s' introuvable\n", matches[mi]);
+            fprintf(stderr, "%s: '%s' introuvable\n", name, matches[mi]);
             ret = -1;
             continue;
         }
         if (is_dir) {
-            fprintf(stderr, "cp: '%s' est un répertoire (non supporté)\n", matches[mi]);
+            fprintf(stderr, "%s: '%s' est un répertoire (non supporté)\n", name, matches[mi]);
             ret = -1;
             continue;
         }
@@ -928,14 +999,23 @@ static int cmd_cp(Shell *shell, Command *cmd) {
             dest_path[sizeof(dest_path) - 1] = '\0';
         }
 
-        int r = fs_copy_file(shell->fs, matches[mi], dest_path);
+        int r = op(shell->fs, matches[mi], dest_path);
         if (r != 0) ret = r;
     }
+    fs_txn_commit(shell->fs);
 
     free(dest_resolved);
     return ret;
 }
 
+static int cmd_cp(Shell *shell, Command *cmd) {
+    return copy_entries(shell, cmd, "cp", fs_copy_file);
+}
+
+static int cmd_ln(Shell *shell, Command *cmd) {
+    return copy_entries(shell, cmd, "ln", fs_link);
+}
+
 static int cmd_mv(Shell *shell, Command *cmd) {
     if (cmd->argc < 3) {
         fprintf(stderr, "mv: arguments requis (source et destination)\n");
@@ -963,19 +1043,14 @@ static int cmd_mv(Shell *shell, Command *cmd) {
 
     int ret = 0;
 
+    fs_txn_begin(shell->fs);
     for (int mi = 0; mi < mcount; mi++) {
-        int is_dir = 0;
-        int idx = inode_index_for_path(shell, matches[mi], &is_dir);
+        int idx = inode_index_for_path(shell, matches[mi], NULL);
         if (idx == -1) {
             fprintf(stderr, "mv: '%s' introuvable\n", matches[mi]);
             ret = -1;
             continue;
         }
-        if (is_dir) {
-            fprintf(stderr, "mv: '%s' est un répertoire (non supporté)\n", matches[mi]);
-            ret = -1;
-            continue;
-        }
 
         char dest_path[MAX_PATH];
         if (dest_is_dir) {
@@ -994,6 +1069,7 @@ static int cmd_mv(Shell *shell, Command *cmd) {
         int r = fs_move_file(shell->fs, matches[mi], dest_path);
         if (r != 0) ret = r;
     }
+    fs_txn_commit(shell->fs);
 
     free(dest_resolved);
     return ret;
@@ -1027,6 +1103,7 @@ static int cmd_rm(Shell *shell, Command *cmd) {
 
     int ret = 0;
 
+    fs_txn_begin(shell->fs);
     for (int i = first_path; i < cmd->argc; i++) {
         char matches[MAX_FILES][MAX_PATH];
         int mcount = expand_fs_glob(shell, cmd->args[i], matches, MAX_FILES);
@@ -1040,6 +1117,7 @@ static int cmd_rm(Shell *shell, Command *cmd) {
             if (delete_path(shell, matches[mi], recursive, force) != 0 && !force) ret = -1;
         }
     }
+    fs_txn_commit(shell->fs);
 
     return ret;
 }
@@ -1048,6 +1126,8 @@ typedef struct {
     int show_metadata;
     int dirs_only;
     int max_depth;
+    int dir_count;    // Compteurs remplis pendant le parcours
+    int file_count;
 } TreeOptions;
 
 static void tree_recursive(Shell *shell, const char *path, int depth, TreeOptions *opts,
@@ -1055,63 +1135,77 @@ static void tree_recursive(Shell *shell, const char *path, int depth, TreeOption
     (void)parent_depth;
     if (opts->max_depth >= 0 && depth > opts->max_depth) return;
 
-    for (int i = 0; i < MAX_FILES; i++) {
-        Inode *inode = get_inode(shell->fs, i);
-        if (inode->filename[0] != '\0' &&
-            strcmp(inode->parent_path, path) == 0) {
+    int dir_idx = strcmp(path, "/") == 0 ? ROOT_INODE : fs_lookup(shell->fs, path);
+    if (dir_idx == -1) return;
 
-            if (opts->dirs_only && !inode->is_directory) continue;
+    FsDirIter iter;
+    if (fs_dir_open(shell->fs, dir_idx, &iter) != 0) return;
 
-            for (int d = 0; d < depth - 1; d++) {
-                printf("%s   ", is_last[d] ? " " : "│");
-            }
-            if (depth > 0) {
-                int remaining = 0;
-                for (int j = i + 1; j < MAX_FILES; j++) {
-                    Inode *inode_j = get_inode(shell->fs, j);
-                    if (inode_j->filename[0] != '\0' &&
-                        strcmp(inode_j->parent_path, path) == 0) {
-                        if (!opts->dirs_only || inode_j->is_directory) {
-                            remaining++;
-                        }
-                    }
-                }
-                printf("%s── ", remaining == 0 ? "└" : "├");
-                is_last[depth - 1] = (remaining == 0);
-            }
+    // Nombre d'entrées affichées, pour savoir laquelle est la dernière
+    int shown = (int)iter.count;
+    if (opts->dirs_only) {
+        shown = 0;
+        for (uint32_t k = 0; k < iter.count; k++) {
+            if (get_inode(shell->fs, (int)iter.children[k])->type == INODE_DIR) shown++;
+        }
+    }
 
-            if (inode->is_directory) {
-                printf("\033[1;34m%s\033[0m/", inode->filename);
-            } else {
-                printf("%s", inode->filename);
-            }
+    int i;
+    while ((i = fs_dir_next(&iter)) != -1) {
+        // Copie : les appels récursifs peuvent évincer l'entrée du cache
+        Inode inode = *get_inode(shell->fs, i);
+        const char *name = fs_inode_name(shell->fs, &inode);
 
-            if (opts->show_metadata) {
-                if (!inode->is_directory) {
-                    printf(" (%lu B)", (unsigned long)inode->size);
-                }
-                char time_str[20];
-                struct tm *tm_info = localtime(&inode->modified);
-                strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M", tm_info);
-                printf(" [%s]", time_str);
+        if (opts->dirs_only && inode.type != INODE_DIR) continue;
+        shown--;
+
+        if (inode.type == INODE_DIR) opts->dir_count++;
+        else opts->file_count++;
+
+        for (int d = 0; d < depth - 1; d++) {
+            printf("%s   ", is_last[d] ? " " : "│");
+        }
+        if (depth > 0) {
+            printf("%s── ", shown == 0 ? "└" : "├");
+            is_last[depth - 1] = (shown == 0);
+        }
+
+        if (inode.type == INODE_DIR) {
+            printf("\033[1;34m%s\033[0m/", name);
+        } else {
+            printf("%s", name);
+        }
+
+        if (opts->show_metadata) {
+            // Un lien affiche la taille et la date de son fichier
+            Inode meta = inode;
+            int data = fs_link_target(shell->fs, i);
+            if (data >= 0 && data != i) meta = *get_inode(shell->fs, data);
+            if (meta.type != INODE_DIR) {
+                printf(" (%lu B)", (unsigned long)meta.size);
             }
-            printf("\n");
+            char time_str[20];
+            struct tm *tm_info = localtime(&meta.modified);
+            strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M", tm_info);
+            printf(" [%s]", time_str);
+        }
+        printf("\n");
 
-            if (inode->is_directory) {
-                char subdir_path[MAX_PATH];
-                if (strcmp(path, "/") == 0) {
-                    snprintf(subdir_path, MAX_PATH, "/%s", inode->filename);
-                } else {
-                    snprintf(subdir_path, MAX_PATH, "%s/%s", path, inode->filename);
-                }
-                tree_recursive(shell, subdir_path, depth + 1, opts, is_last, depth);
+        if (inode.type == INODE_DIR) {
+            char subdir_path[MAX_PATH];
+            if (strcmp(path, "/") == 0) {
+                snprintf(subdir_path, MAX_PATH, "/%s", name);
+            } else {
+                snprintf(subdir_path, MAX_PATH, "%s/%s", path, name);
             }
+            tree_recursive(shell, subdir_path, depth + 1, opts, is_last, depth);
         }
     }
+    fs_dir_close(&iter);
 }
 
 static int cmd_tree(Shell *shell, Command *cmd) {
-    TreeOptions opts = {0, 0, -1};
+    TreeOptions opts = {0, 0, -1, 0, 0};
     const char *path = NULL;
 
     for (int i = 1; i < cmd->argc; i++) {
@@ -1138,27 +1232,11 @@ static int cmd_tree(Shell *shell, Command *cmd) {
 
     char *resolved = resolve_path(shell, path);
 
-    int idx = -1;
-    for (int i = 0; i < MAX_FILES; i++) {
-        Inode *inode = get_inode(shell->fs, i);
-        if (inode->filename[0] != '\0') {
-            char full_path[MAX_PATH];
-            if (strcmp(inode->parent_path, "/") == 0) {
-                snprintf(full_path, MAX_PATH, "/%s", inode->filename);
-            } else {
-                snprintf(full_path, MAX_PATH, "%s/%s", inode->parent_path,
-                         inode->filename);
-            }
-            if (strcmp(full_path, resolved) == 0) {
-                idx = i;
-                break;
-            }
-        }
-    }
+    int idx = inode_index_for_path(shell, resolved, NULL);
 
     if (idx != -1) {
         Inode *inode = get_inode(shell->fs, idx);
-        if (!inode->is_directory && strcmp(resolved, "/") != 0) {
+        if (inode->type != INODE_DIR && strcmp(resolved, "/") != 0) {
             fprintf(stderr, "tree: '%s' n'est pas un répertoire\n", resolved);
             free(resolved);
             return -1;
@@ -1170,14 +1248,7 @@ static int cmd_tree(Shell *shell, Command *cmd) {
     int is_last[256] = {0};
     tree_recursive(shell, resolved, 1, &opts, is_last, 0);
 
-    int dirs = 0, files = 0;
-    for (int i = 0; i < MAX_FILES; i++) {
-        Inode *inode = get_inode(shell->fs, i);
-        if (inode->filename[0] != '\0') {
-            if (inode->is_directory) dirs++;
-            else files++;
-        }
-    }
+    int dirs = opts.dir_count, files = opts.file_count;
 
     printf("\n");
     if (opts.dirs_only) {
@@ -1195,23 +1266,26 @@ static int name_matches(const char *name, const char *pattern) {
     return strstr(name, pattern) != NULL;
 }
 
-static void find_recursive(Shell *shell, const char *path, const char *pattern) {
-    for (int i = 0; i < MAX_FILES; i++) {
-        Inode *inode = get_inode(shell->fs, i);
-        if (inode->filename[0] != '\0' &&
-            strcmp(inode->parent_path, path) == 0) {
-            char child_path[MAX_PATH];
-            build_full_path_from_inode(inode, child_path, sizeof(child_path));
+static void find_recursive(Shell *shell, int dir_idx, const char *pattern) {
+    FsDirIter iter;
+    if (fs_dir_open(shell->fs, dir_idx, &iter) != 0) return;
 
-            if (name_matches(inode->filename, pattern)) {
-                printf("%s%s\n", child_path, inode->is_directory ? "/" : "");
-            }
+    int i;
+    while ((i = fs_dir_next(&iter)) != -1) {
+        // Copie : les appels récursifs peuvent évincer l'entrée du cache
+        Inode inode = *get_inode(shell->fs, i);
+        char child_path[MAX_PATH];
+        build_full_path_from_inode(shell, i, child_path, sizeof(child_path));
 
-            if (inode->is_directory) {
-                find_recursive(shell, child_path, pattern);
-            }
+        if (name_matches(fs_inode_name(shell->fs, &inode), pattern)) {
+            printf("%s%s\n", child_path, inode.type == INODE_DIR ? "/" : "");
+        }
+
+        if (inode.type == INODE_DIR) {
+            find_recursive(shell, i, pattern);
         }
     }
+    fs_dir_close(&iter);
 }
 
 static int cmd_find(Shell *shell, Command *cmd) {
@@ -1246,7 +1320,7 @@ static int cmd_find(Shell *shell, Command *cmd) {
     // Si le point de départ est un fichier, on évalue uniquement ce fichier
     if (idx >= 0 && !is_dir) {
         Inode *inode = get_inode(shell->fs, idx);
-        if (name_matches(inode->filename, pattern)) {
+        if (name_matches(fs_inode_name(shell->fs, inode), pattern)) {
             printf("%s\n", start_path);
         }
         free(start_path);
@@ -1257,18 +1331,36 @@ static int cmd_find(Shell *shell, Command *cmd) {
         printf("%s/\n", start_path);
     }
 
-    find_recursive(shell, start_path, pattern);
+    find_recursive(shell, idx >= 0 ? idx : ROOT_INODE, pattern);
 
     free(start_path);
     return 0;
 }
 
-static void print_stat_info(const char *path, const Inode *inode, int is_dir) {
+static void print_stat_info(Shell *shell, const char *path, const Inode *inode, int is_dir) {
     printf("Chemin : %s\n", path);
     printf("Type   : %s\n", is_dir ? "Répertoire" : "Fichier");
 
     if (inode) {
         printf("Taille : %lu octets\n", (unsigned long)inode->size);
+        if (!is_dir && inode->link_count > 1) {
+            printf("Liens  : %u noms\n", inode->link_count);
+        }
+        if (inode->flags & (INODE_FLAG_COMPRESSED | INODE_FLAG_COMPRESS)) {
+            printf("Compression : %s\n", is_dir ? "activée pour les ajouts" : "par morceaux");
+        }
+        FsChecksumInfo sums;
+        int has_sums = is_dir ? 1 : fs_checksum_info(shell->fs, inode, &sums);
+        if (has_sums == 0) {
+            printf("Sommes : CRC32C sur %llu blocs", (unsigned long long)sums.blocks);
+            if (sums.has_sha256) {
+                printf(", SHA-256 ");
+                for (int i = 0; i < SHA256_SIZE; i++) printf("%02x", sums.sha256[i]);
+            }
+            printf("\n");
+        } else if (has_sums < 0) {
+            printf("Sommes : table illisible\n");
+        }
 
         char created[32];
         char modified[32];
@@ -1277,7 +1369,14 @@ static void print_stat_info(const char *path, const Inode *inode, int is_dir) {
         strftime(modified, sizeof(modified), "%Y-%m-%d %H:%M", localtime_r(&inode->modified, &tm_m));
         printf("Créé   : %s\n", created);
         printf("Modifié: %s\n", modified);
-        printf("Parent : %s\n", inode->parent_path);
+        // Le parent de l'entrée nommée, lu dans son chemin : un fichier lié
+        // n'a pas de parent propre
+        const char *slash = strrchr(path, '/');
+        if (!slash || slash == path) {
+            printf("Parent : /\n");
+        } else {
+            printf("Parent : %.*s\n", (int)(slash - path), path);
+        }
     } else {
         printf("Taille : 0 octets\n");
         printf("Créé   : N/A\n");
@@ -1316,10 +1415,10 @@ static int cmd_stat(Shell *shell, Command *cmd) {
             }
 
             if (idx == -1) {
-                print_stat_info(matches[mi], NULL, 1);
+                print_stat_info(shell, matches[mi], NULL, 1);
             } else {
                 Inode *inode = get_inode(shell->fs, idx);
-                print_stat_info(matches[mi], inode, is_dir);
+                print_stat_info(shell, matches[mi], inode, is_dir);
             }
         }
 
@@ -1365,6 +1464,172 @@ static int cmd_edit(Shell *shell, Command *cmd) {
     return editor_open(shell, cmd->args[1]);
 }
 
+static void print_frag_stats(const char *label, const FsFragStats *stats) {
+    printf("%s : %u contenus dont %u fragmentés (%llu extents), %llu octets libres en %u plages "
+           "(plus grande : %llu), fin des données à %llu\n",
+           label, stats->files, stats->fragmented, (unsigned long long)stats->extents,
+           (unsigned long long)stats->free_bytes, stats->free_runs,
+           (unsigned long long)stats->largest_free, (unsigned long long)stats->data_end);
+}
+
+static int cmd_defrag(Shell *shell, Command *cmd) {
+    FsDefragOptions opts = {0, 0};
+    int stats_only = 0;
+
+    for (int i = 1; i < cmd->argc; i++) {
+        if (strcmp(cmd->args[i], "-s") == 0) {
+            stats_only = 1;
+        } else if (strcmp(cmd->args[i], "-t") == 0 || strcmp(cmd->args[i], "-b") == 0) {
+            if (i + 1 >= cmd->argc) {
+                fprintf(stderr, "defrag: %s requiert un argument numérique\n", cmd->args[i]);
+                return -1;
+            }
+            if (cmd->args[i][1] == 't') {
+                opts.time_ms = (uint32_t)strtoul(cmd->args[++i], NULL, 10);
+            } else {
+                opts.bytes = strtoull(cmd->args[++i], NULL, 10);
+            }
+        } else {
+            fprintf(stderr, "defrag: option inconnue '%s'\n", cmd->args[i]);
+            return -1;
+        }
+    }
+
+    if (stats_only) {
+        FsFragStats stats;
+        if (fs_frag_stats(shell->fs, &stats) != 0) return -1;
+        print_frag_stats("État", &stats);
+        return 0;
+    }
+
+    FsDefragResult result;
+    int ret = fs_defrag(shell->fs, &opts, &result);
+    print_frag_stats("Avant", &result.before);
+    print_frag_stats("Après", &result.after);
+    printf("%u contenus déplacés (%llu octets)%s\n", result.files_moved,
+           (unsigned long long)result.bytes_moved,
+           result.complete ? "" : ", budget atteint : relancer defrag pour continuer");
+    return ret;
+}
+
+static int cmd_compress(Shell *shell, Command *cmd) {
+    int enable = 1;
+    int first_arg = 1;
+    if (first_arg < cmd->argc && strcmp(cmd->args[first_arg], "-d") == 0) {
+        enable = 0;
+        first_arg++;
+    }
+    if (first_arg >= cmd->argc) {
+        fprintf(stderr, "compress: usage -> compress [-d] <chemin>\n");
+        return -1;
+    }
+
+    char matches[MAX_FILES][MAX_PATH];
+    int mcount = expand_fs_glob(shell, cmd->args[first_arg], matches, MAX_FILES);
+    if (mcount == 0) {
+        fprintf(stderr, "compress: aucune correspondance pour '%s'\n", cmd->args[first_arg]);
+        return -1;
+    }
+
+    int ret = 0;
+    fs_txn_begin(shell->fs);
+    for (int mi = 0; mi < mcount; mi++) {
+        if (fs_set_compression(shell->fs, matches[mi], enable) != 0) ret = -1;
+    }
+    fs_txn_commit(shell->fs);
+    return ret;
+}
+
+static int cmd_dedup(Shell *shell, Command *cmd) {
+    if (cmd->argc > 2 ||
+        (cmd->argc == 2 && strcmp(cmd->args[1], "on") != 0 && strcmp(cmd->args[1], "off") != 0)) {
+        fprintf(stderr, "dedup: usage -> dedup [on|off]\n");
+        return -1;
+    }
+
+    if (cmd->argc == 2 && fs_set_dedup(shell->fs, strcmp(cmd->args[1], "on") == 0) != 0) return -1;
+    printf("Déduplication %s\n", shell->fs->sb.flags & SB_FLAG_DEDUP ? "activée" : "désactivée");
+    return 0;
+}
+
+static int cmd_dedup_stats(Shell *shell, Command *cmd) {
+    if (cmd->argc > 1) {
+        fprintf(stderr, "dedup-stats: option inconnue '%s'\n", cmd->args[1]);
+        return -1;
+    }
+
+    FsDedupStats stats;
+    if (fs_dedup_stats(shell->fs, &stats) != 0) return -1;
+    printf("Déduplication : %s\n", stats.enabled ? "activée" : "désactivée");
+    printf("Blocs indexés : %llu\n", (unsigned long long)stats.indexed_blocks);
+    printf("Fichiers      : %llu octets\n", (unsigned long long)stats.file_bytes);
+    printf("Partagé       : %llu octets\n", (unsigned long long)stats.shared_bytes);
+    printf("Économisé     : %llu octets", (unsigned long long)stats.saved_bytes);
+    if (stats.file_bytes > 0) {
+        printf(" (%.1f %%)", 100.0 * (double)stats.saved_bytes / (double)stats.file_bytes);
+    }
+    printf("\n");
+    return 0;
+}
+
+static int cmd_checksum(Shell *shell, Command *cmd) {
+    if (cmd->argc == 3 && strcmp(cmd->args[1], "sha256") == 0 &&
+        (strcmp(cmd->args[2], "on") == 0 || strcmp(cmd->args[2], "off") == 0)) {
+        if (fs_set_sha256(shell->fs, strcmp(cmd->args[2], "on") == 0) != 0) return -1;
+    } else if (cmd->argc == 3 && strcmp(cmd->args[1], "verify") == 0 && fs_verify_from_name(cmd->args[2]) != 0) {
+        fs_set_verify(shell->fs, fs_verify_from_name(cmd->args[2]));
+    } else if (cmd->argc != 1) {
+        fprintf(stderr, "checksum: usage -> checksum [sha256 on|off | verify off|warn|strict]\n");
+        return -1;
+    }
+
+    static const char *policies[] = { "", "off", "warn", "strict" };
+    printf("CRC32C      : par bloc (%s)\n", crc32c_impl());
+    printf("SHA-256     : %s\n", shell->fs->sb.flags & SB_FLAG_SHA256 ? "activé" : "désactivé");
+    printf("Vérification: %s\n", policies[shell->fs->verify]);
+    return 0;
+}
+
+static int cmd_snapshot(Shell *shell, Command *cmd) {
+    const char *action = cmd->argc > 1 ? cmd->args[1] : "list";
+    int ret;
+    if (cmd->argc <= 2 && strcmp(action, "list") == 0) {
+        fs_snapshot_list(shell->fs);
+        return 0;
+    } else if (cmd->argc == 3 && strcmp(action, "create") == 0) {
+        return fs_snapshot_create(shell->fs, cmd->args[2]);
+    } else if (cmd->argc == 3 && strcmp(action, "restore") == 0) {
+        ret = fs_snapshot_restore(shell->fs, cmd->args[2]);
+    } else if (cmd->argc == 3 && strcmp(action, "delete") == 0) {
+        ret = fs_snapshot_delete(shell->fs, cmd->args[2]);
+    } else {
+        fprintf(stderr, "snapshot: usage -> snapshot [list | create|restore|delete <nom>]\n");
+        return -1;
+    }
+
+    // Le répertoire courant a pu disparaître avec l'arborescence remplacée
+    // ou l'instantané supprimé
+    if (strcmp(shell->current_path, "/") != 0 && fs_lookup(shell->fs, shell->current_path) == -1) {
+        printf("%s n'existe plus, retour à /\n", shell->current_path);
+        strcpy(shell->current_path, "/");
+    }
+    return ret;
+}
+
+static int cmd_trim(Shell *shell, Command *cmd) {
+    if (cmd->argc > 1) {
+        fprintf(stderr, "trim: option inconnue '%s'\n", cmd->args[1]);
+        return -1;
+    }
+
+    FsTrimResult result;
+    if (fs_trim(shell->fs, &result) != 0) return -1;
+    printf("Conteneur : %llu -> %llu octets, %llu octets libres rendus à l'hôte\n",
+           (unsigned long long)result.size_before, (unsigned long long)result.size_after,
+           (unsigned long long)result.punched);
+    return 0;
+}
+
 int shell_execute_command(Shell *shell, const char *cmd_line) {
     if (!cmd_line || cmd_line[0] == '\0') return 0;
 
@@ -1408,10 +1673,26 @@ int shell_execute_command(Shell *shell, const char *cmd_line) {
         ret = cmd_extract(shell, &cmd);
     } else if (strcmp(command, "cp") == 0) {
         ret = cmd_cp(shell, &cmd);
+    } else if (strcmp(command, "ln") == 0) {
+        ret = cmd_ln(shell, &cmd);
     } else if (strcmp(command, "mv") == 0) {
         ret = cmd_mv(shell, &cmd);
     } else if (strcmp(command, "rm") == 0) {
         ret = cmd_rm(shell, &cmd);
+    } else if (strcmp(command, "defrag") == 0) {
+        ret = cmd_defrag(shell, &cmd);
+    } else if (strcmp(command, "compress") == 0) {
+        ret = cmd_compress(shell, &cmd);
+    } else if (strcmp(command, "dedup") == 0) {
+        ret = cmd_dedup(shell, &cmd);
+    } else if (strcmp(command, "dedup-stats") == 0) {
+        ret = cmd_dedup_stats(shell, &cmd);
+    } else if (strcmp(command, "checksum") == 0) {
+        ret = cmd_checksum(shell, &cmd);
+    } else if (strcmp(command, "snapshot") == 0) {
+        ret = cmd_snapshot(shell, &cmd);
+    } else if (strcmp(command, "trim") == 0) {
+        ret = cmd_trim(shell, &cmd);
     } else if (strcmp(command, "clear") == 0) {
         ret = cmd_clear(shell, &cmd);
     } else {
@@ -1467,6 +1748,11 @@ void shell_run(Shell *shell) {
     char buffer[BUFFER_SIZE];
     int pos = 0;
 
+    // Entrée non interactive (script) : toute la session forme une
+    // transaction, validée par morceaux quand le journal se remplit
+    int interactive = isatty(STDIN_FILENO);
+    if (!interactive) fs_txn_begin(shell->fs);
+
     while (shell->running) {
         print_prompt(shell);
         pos = 0;
@@ -1545,9 +1831,12 @@ void shell_run(Shell *shell) {
         if (buffer[0] != '\0') {
             add_to_history(shell, buffer);
             shell_execute_command(shell, buffer);
+            // En interactif, chaque commande est validée aussitôt
+            if (interactive) fs_sync(shell->fs);
         }
     }
 
+    if (!interactive) fs_txn_commit(shell->fs);
     tcsetattr(STDIN_FILENO, TCSAFLUSH, &orig_termios);
     printf("\nAu revoir!\n");
 }
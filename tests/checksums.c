@@ -0,0 +1,134 @@
+// Sommes de controle : un bloc altere passe inapercu en mode off, est signale
+// en mode warn sans arreter la lecture, et fait echouer l'extraction en mode
+// strict sans laisser de copie tronquee.
+#include "fs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define FILE_BLOCKS 8
+#define FILE_SIZE (FILE_BLOCKS * BLOCK_SIZE)
+#define DAMAGED_BLOCK 2
+
+static int failures = 0;
+
+#define CHECK(cond, msg) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "ÉCHEC %s:%d : %s\n", __FILE__, __LINE__, msg); \
+        failures++; \
+    } \
+} while (0)
+
+static int write_host_file(const char *path) {
+    static unsigned char buf[FILE_SIZE];
+    for (size_t k = 0; k < sizeof(buf); k++) buf[k] = (unsigned char)(k * 7 + k / BLOCK_SIZE);
+    FILE *f = fopen(path, "wb");
+    if (!f) return -1;
+    int ret = fwrite(buf, 1, sizeof(buf), f) == sizeof(buf) ? 0 : -1;
+    if (fclose(f) != 0) ret = -1;
+    return ret;
+}
+
+// Inverse un octet du bloc DAMAGED_BLOCK du contenu
+static int damage_block(const char *image, uint64_t data_offset) {
+    FILE *f = fopen(image, "r+b");
+    if (!f) return -1;
+    long at = (long)(data_offset + DAMAGED_BLOCK * BLOCK_SIZE + 100);
+    int c;
+    int ret = -1;
+    if (fseek(f, at, SEEK_SET) == 0 && (c = fgetc(f)) != EOF && fseek(f, at, SEEK_SET) == 0 &&
+        fputc(c ^ 0xFF, f) != EOF) {
+        ret = 0;
+    }
+    if (fclose(f) != 0) ret = -1;
+    return ret;
+}
+
+// Lit path jusqu'au bout et rend les blocs signales corrompus ; -1 si la
+// lecture s'est arretee avant la fin
+static long read_corrupt(FileSystem *fs, const char *path) {
+    Inode inode = *get_inode(fs, fs_lookup(fs, path));
+    FsReader reader;
+    if (fs_reader_open(fs, &inode, &reader) != 0) return -1;
+    char buf[BLOCK_SIZE];
+    while (fs_reader_read(&reader, buf, sizeof(buf)) > 0) {
+    }
+    long corrupt = reader.remaining > 0 ? -1 : (long)reader.corrupt;
+    fs_reader_close(&reader);
+    return corrupt;
+}
+
+static long host_size(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? (long)st.st_size : -1;
+}
+
+int main(void) {
+    char image[64], source[64], extracted[64];
+    snprintf(image, sizeof(image), "/tmp/csfs_sums_%d.img", (int)getpid());
+    snprintf(source, sizeof(source), "/tmp/csfs_sums_%d.src", (int)getpid());
+    snprintf(extracted, sizeof(extracted), "/tmp/csfs_sums_%d.out", (int)getpid());
+
+    if (write_host_file(source) != 0 || fs_create(image) != 0) {
+        fprintf(stderr, "Impossible de préparer les fichiers de test\n");
+        return 1;
+    }
+
+    FileSystem *fs = fs_open(image);
+    CHECK(fs != NULL, "fs_open");
+    if (!fs) return 1;
+    CHECK(fs_add_file(fs, "/f", source) == 0, "add /f");
+    CHECK(fs_add_file(fs, "/g", source) == 0, "add /g");
+
+    int idx = fs_lookup(fs, "/f");
+    CHECK(idx != -1, "lookup /f");
+    if (idx == -1) return 1;
+    Inode inode = *get_inode(fs, idx);
+    CHECK(inode.flags & INODE_FLAG_CHECKSUM, "/f a ses sommes");
+    CHECK(inode.extent_count == 1, "/f d'un seul tenant");
+    fs_close(fs);
+
+    CHECK(damage_block(image, inode.extents[0].offset) == 0, "altération d'un bloc");
+
+    fs = fs_open(image);
+    CHECK(fs != NULL, "réouverture");
+    if (!fs) return 1;
+
+    // off : rien n'est verifie
+    fs_set_verify(fs, FS_VERIFY_OFF);
+    unlink(extracted);
+    CHECK(fs_extract_file(fs, "/f", extracted) == 0, "off : extraction faite");
+    CHECK(host_size(extracted) == FILE_SIZE, "off : copie entière");
+    CHECK(read_corrupt(fs, "/f") == 0, "off : aucun bloc signalé");
+
+    // warn : le bloc est signale, la lecture continue
+    fs_set_verify(fs, FS_VERIFY_WARN);
+    unlink(extracted);
+    CHECK(fs_extract_file(fs, "/f", extracted) == 0, "warn : extraction faite");
+    CHECK(host_size(extracted) == FILE_SIZE, "warn : copie entière");
+    CHECK(read_corrupt(fs, "/f") >= 1, "warn : bloc signalé");
+    CHECK(read_corrupt(fs, "/g") == 0, "warn : /g intact");
+
+    // strict : la lecture s'arrete, aucune copie n'est laissee
+    fs_set_verify(fs, FS_VERIFY_STRICT);
+    unlink(extracted);
+    CHECK(fs_extract_file(fs, "/f", extracted) == -1, "strict : extraction refusée");
+    CHECK(access(extracted, F_OK) != 0, "strict : aucune copie tronquée");
+    CHECK(read_corrupt(fs, "/f") == -1, "strict : lecture arrêtée");
+    CHECK(read_corrupt(fs, "/g") == 0, "strict : /g lisible");
+    CHECK(fs_extract_file(fs, "/g", extracted) == 0, "strict : extraction de /g");
+    fs_close(fs);
+
+    unlink(image);
+    unlink(source);
+    unlink(extracted);
+
+    if (failures) {
+        fprintf(stderr, "%d vérification(s) en échec\n", failures);
+        return 1;
+    }
+    printf("checksums : OK\n");
+    return 0;
+}
@@ -0,0 +1,117 @@
+// Morceau compresse illisible : la lecture s'arrete quel que soit le mode de
+// verification, et l'extraction echoue sans laisser de copie tronquee.
+#include "fs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define CONTENT_SIZE (4 * COMPRESS_CHUNK + 1000)
+
+static int failures = 0;
+
+#define CHECK(cond, msg) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "ÉCHEC %s:%d : %s\n", __FILE__, __LINE__, msg); \
+        failures++; \
+    } \
+} while (0)
+
+// Texte qui se compresse bien
+static int write_host_file(const char *path) {
+    FILE *f = fopen(path, "wb");
+    if (!f) return -1;
+    int ret = 0;
+    for (int i = 0; ret == 0 && i < CONTENT_SIZE / 50; i++) {
+        if (fprintf(f, "ligne %06d : contenu répétitif à compresser\n", i) < 0) ret = -1;
+    }
+    if (fclose(f) != 0) ret = -1;
+    return ret;
+}
+
+// Met a zero les octets stockes du premier morceau : un jeton nul suivi d'une
+// distance nulle ne se decode pas
+static int zero_first_chunk(const char *image, uint64_t data_offset) {
+    FILE *f = fopen(image, "r+b");
+    if (!f) return -1;
+    CompressHeader header;
+    uint64_t chunks[2];
+    int ret = -1;
+    if (fseek(f, (long)data_offset, SEEK_SET) == 0 && fread(&header, sizeof(header), 1, f) == 1 &&
+        header.magic == COMPRESS_MAGIC && fread(chunks, sizeof(uint64_t), 2, f) == 2 &&
+        !(chunks[0] & COMPRESS_RAW)) {
+        uint64_t start = chunks[0];
+        uint64_t end = chunks[1] & ~COMPRESS_RAW;
+        char *zeros = calloc(1, (size_t)(end - start));
+        if (zeros && fseek(f, (long)(data_offset + start), SEEK_SET) == 0 &&
+            fwrite(zeros, 1, (size_t)(end - start), f) == end - start) {
+            ret = 0;
+        }
+        free(zeros);
+    }
+    if (fclose(f) != 0) ret = -1;
+    return ret;
+}
+
+int main(void) {
+    char image[64], source[64], extracted[64];
+    snprintf(image, sizeof(image), "/tmp/csfs_chunk_%d.img", (int)getpid());
+    snprintf(source, sizeof(source), "/tmp/csfs_chunk_%d.src", (int)getpid());
+    snprintf(extracted, sizeof(extracted), "/tmp/csfs_chunk_%d.out", (int)getpid());
+
+    if (write_host_file(source) != 0 || fs_create(image) != 0) {
+        fprintf(stderr, "Impossible de préparer les fichiers de test\n");
+        return 1;
+    }
+
+    FileSystem *fs = fs_open(image);
+    CHECK(fs != NULL, "fs_open");
+    if (!fs) return 1;
+    CHECK(fs_mkdir(fs, "/z") == 0, "mkdir /z");
+    CHECK(fs_set_compression(fs, "/z", 1) == 0, "compress /z");
+    CHECK(fs_add_file(fs, "/z/f", source) == 0, "add /z/f");
+
+    int idx = fs_lookup(fs, "/z/f");
+    CHECK(idx != -1, "lookup /z/f");
+    if (idx == -1) return 1;
+    Inode inode = *get_inode(fs, idx);
+    CHECK(inode.flags & INODE_FLAG_COMPRESSED, "/z/f compressé");
+    CHECK(inode.extent_count == 1, "/z/f d'un seul tenant");
+    fs_close(fs);
+
+    CHECK(zero_first_chunk(image, inode.extents[0].offset) == 0, "altération du premier morceau");
+
+    fs = fs_open(image);
+    CHECK(fs != NULL, "réouverture");
+    if (!fs) return 1;
+
+    const char *policies[] = { "off", "warn", "strict" };
+    for (int p = 0; p < 3; p++) {
+        fs_set_verify(fs, fs_verify_from_name(policies[p]));
+        unlink(extracted);
+        CHECK(fs_extract_file(fs, "/z/f", extracted) == -1, "extraction d'un morceau illisible refusée");
+        CHECK(access(extracted, F_OK) != 0, "aucune copie tronquée laissée");
+
+        inode = *get_inode(fs, fs_lookup(fs, "/z/f"));
+        FsReader reader;
+        CHECK(fs_reader_open(fs, &inode, &reader) == 0, "ouverture du lecteur");
+        char buf[BLOCK_SIZE];
+        while (fs_reader_read(&reader, buf, sizeof(buf)) > 0) {
+        }
+        CHECK(reader.failed && reader.corrupt > 0, "morceau illisible compté");
+        CHECK(reader.remaining > 0, "lecture signalée incomplète");
+        fs_reader_close(&reader);
+    }
+    fs_close(fs);
+
+    unlink(image);
+    unlink(source);
+    unlink(extracted);
+
+    if (failures) {
+        fprintf(stderr, "%d vérification(s) en échec\n", failures);
+        return 1;
+    }
+    printf("corrupt_chunk : OK\n");
+    return 0;
+}
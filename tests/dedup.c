@@ -0,0 +1,121 @@
+// Deduplication : deux fichiers identiques partagent leurs blocs, retirer
+// l'un laisse l'autre lisible, et l'espace ne revient qu'avec le dernier.
+#include "fs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define FILE_SIZE (64 * BLOCK_SIZE)
+// Blocs de metadonnees (index, tas de noms, compteurs) toleres en plus
+#define META_SLACK (16 * BLOCK_SIZE)
+
+static int failures = 0;
+
+#define CHECK(cond, msg) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "ÉCHEC %s:%d : %s\n", __FILE__, __LINE__, msg); \
+        failures++; \
+    } \
+} while (0)
+
+static unsigned char content_byte(uint64_t pos) {
+    return (unsigned char)((pos * 2654435761u) >> 13);
+}
+
+// Contenu peu compressible, different d'un bloc a l'autre
+static int write_host_file(const char *path) {
+    static unsigned char buf[FILE_SIZE];
+    for (uint64_t k = 0; k < FILE_SIZE; k++) buf[k] = content_byte(k);
+    FILE *f = fopen(path, "wb");
+    if (!f) return -1;
+    int ret = fwrite(buf, 1, sizeof(buf), f) == sizeof(buf) ? 0 : -1;
+    if (fclose(f) != 0) ret = -1;
+    return ret;
+}
+
+static int content_intact(FileSystem *fs, const char *path) {
+    int idx = fs_lookup(fs, path);
+    if (idx == -1) return 0;
+    Inode inode = *get_inode(fs, idx);
+    if (inode.size != FILE_SIZE) return 0;
+
+    FsReader reader;
+    if (fs_reader_open(fs, &inode, &reader) != 0) return 0;
+    unsigned char buf[BLOCK_SIZE];
+    uint64_t pos = 0;
+    size_t n;
+    int ok = 1;
+    while ((n = fs_reader_read(&reader, buf, sizeof(buf))) > 0) {
+        for (size_t k = 0; k < n; k++) ok &= buf[k] == content_byte(pos + k);
+        pos += n;
+    }
+    ok &= reader.corrupt == 0;
+    fs_reader_close(&reader);
+    return ok && pos == FILE_SIZE;
+}
+
+// Octets occupes avant la fin des donnees, une fois la transaction validee
+static uint64_t used_bytes(FileSystem *fs) {
+    fs_sync(fs);
+    return fs->sb.data_end - fs->free_map.total;
+}
+
+int main(void) {
+    char image[64], source[64];
+    snprintf(image, sizeof(image), "/tmp/csfs_dedup_%d.img", (int)getpid());
+    snprintf(source, sizeof(source), "/tmp/csfs_dedup_%d.src", (int)getpid());
+
+    if (write_host_file(source) != 0 || fs_create(image) != 0) {
+        fprintf(stderr, "Impossible de préparer les fichiers de test\n");
+        return 1;
+    }
+
+    FileSystem *fs = fs_open(image);
+    CHECK(fs != NULL, "fs_open");
+    if (!fs) return 1;
+    CHECK(fs_set_dedup(fs, 1) == 0, "dedup on");
+    uint64_t base = used_bytes(fs);
+
+    CHECK(fs_add_file(fs, "/a", source) == 0, "add /a");
+    CHECK(fs_add_file(fs, "/b", source) == 0, "add /b");
+    uint64_t both = used_bytes(fs);
+    CHECK(both < base + FILE_SIZE + META_SLACK, "une seule copie des données");
+
+    FsDedupStats stats;
+    CHECK(fs_dedup_stats(fs, &stats) == 0, "dedup stats");
+    CHECK(stats.enabled, "mode dédupliqué signalé");
+    CHECK(stats.file_bytes == 2 * (uint64_t)FILE_SIZE, "taille cumulée des fichiers");
+    CHECK(stats.shared_bytes >= FILE_SIZE, "blocs partagés");
+    CHECK(stats.saved_bytes >= FILE_SIZE, "octets économisés");
+    fs_close(fs);
+
+    // Les compteurs de references survivent a la reouverture
+    fs = fs_open(image);
+    CHECK(fs != NULL, "réouverture");
+    if (!fs) return 1;
+    CHECK(fs_remove(fs, "/a") == 0, "rm /a");
+    CHECK(content_intact(fs, "/b"), "/b lisible après le retrait de /a");
+    uint64_t single = used_bytes(fs);
+    CHECK(single + FILE_SIZE / 2 > both, "données gardées pour /b");
+    CHECK(fs_dedup_stats(fs, &stats) == 0 && stats.shared_bytes == 0, "plus aucun bloc partagé");
+    fs_close(fs);
+
+    fs = fs_open(image);
+    CHECK(fs != NULL, "réouverture");
+    if (!fs) return 1;
+    CHECK(content_intact(fs, "/b"), "/b lisible après réouverture");
+    CHECK(fs_remove(fs, "/b") == 0, "rm /b");
+    CHECK(used_bytes(fs) + FILE_SIZE <= single, "espace rendu avec la dernière référence");
+    fs_close(fs);
+
+    unlink(image);
+    unlink(source);
+
+    if (failures) {
+        fprintf(stderr, "%d vérification(s) en échec\n", failures);
+        return 1;
+    }
+    printf("dedup : OK\n");
+    return 0;
+}
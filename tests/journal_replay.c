@@ -0,0 +1,177 @@
+// Journal : une transaction ecrite mais pas mise en place est rejouee a
+// l'ouverture, et un ecrivain tue au milieu d'un ajout laisse une image
+// coherente ou chaque ajout valide est entier.
+#include "fs.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define FILE_SIZE (48 * BLOCK_SIZE)
+#define KILL_ROUNDS 4
+#define MAX_ADDS 64
+
+static int failures = 0;
+
+#define CHECK(cond, msg) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "ÉCHEC %s:%d : %s\n", __FILE__, __LINE__, msg); \
+        failures++; \
+    } \
+} while (0)
+
+static unsigned char fill_byte(int round, int i) {
+    return (unsigned char)(round * 61 + i * 37 + 1);
+}
+
+static int write_host_file(const char *path, unsigned char value) {
+    static unsigned char buf[FILE_SIZE];
+    memset(buf, value, sizeof(buf));
+    FILE *f = fopen(path, "wb");
+    if (!f) return -1;
+    int ret = fwrite(buf, 1, sizeof(buf), f) == sizeof(buf) ? 0 : -1;
+    if (fclose(f) != 0) ret = -1;
+    return ret;
+}
+
+// 1 si path a exactement FILE_SIZE octets valant value, 0 s'il est absent,
+// -1 s'il est tronque ou altere
+static int file_state(FileSystem *fs, const char *path, unsigned char value) {
+    int idx = fs_lookup(fs, path);
+    if (idx == -1) return 0;
+    Inode inode = *get_inode(fs, idx);
+    if (inode.size != FILE_SIZE) return -1;
+
+    FsReader reader;
+    if (fs_reader_open(fs, &inode, &reader) != 0) return -1;
+    unsigned char buf[BLOCK_SIZE];
+    uint64_t total = 0;
+    size_t n;
+    int ok = 1;
+    while ((n = fs_reader_read(&reader, buf, sizeof(buf))) > 0) {
+        for (size_t k = 0; k < n; k++) ok &= buf[k] == value;
+        total += n;
+    }
+    fs_reader_close(&reader);
+    return ok && total == FILE_SIZE ? 1 : -1;
+}
+
+static int read_superblock(const char *image, SuperBlock *sb) {
+    FILE *f = fopen(image, "rb");
+    if (!f) return -1;
+    int ret = fread(sb, sizeof(*sb), 1, f) == 1 ? 0 : -1;
+    fclose(f);
+    return ret;
+}
+
+static int write_superblock(const char *image, const SuperBlock *sb) {
+    FILE *f = fopen(image, "r+b");
+    if (!f) return -1;
+    int ret = fwrite(sb, sizeof(*sb), 1, f) == 1 ? 0 : -1;
+    if (fclose(f) != 0) ret = -1;
+    return ret;
+}
+
+// Ecrivain : ajoute des fichiers et signale chaque ajout valide (fs_sync)
+static void writer(const char *image, const char *source, int round, int fd) {
+    FileSystem *fs = fs_open(image);
+    if (!fs) _exit(1);
+    for (int i = 0; i < MAX_ADDS; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "/r%d_%d", round, i);
+        if (write_host_file(source, fill_byte(round, i)) != 0 || fs_add_file(fs, name, source) != 0 ||
+            fs_sync(fs) != 0) {
+            _exit(1);
+        }
+        char done = 1;
+        if (write(fd, &done, 1) != 1) _exit(1);
+    }
+    fs_close(fs);
+    _exit(0);
+}
+
+int main(void) {
+    char image[64], source[64], child_source[64];
+    snprintf(image, sizeof(image), "/tmp/csfs_journal_%d.img", (int)getpid());
+    snprintf(source, sizeof(source), "/tmp/csfs_journal_%d.src", (int)getpid());
+    snprintf(child_source, sizeof(child_source), "/tmp/csfs_journal_%d.child", (int)getpid());
+
+    if (write_host_file(source, 0x5A) != 0 || fs_create(image) != 0) {
+        fprintf(stderr, "Impossible de préparer les fichiers de test\n");
+        return 1;
+    }
+
+    // Mise en place perdue : le SuperBlock d'avant la transaction est remis,
+    // comme si la coupure avait suivi l'ecriture du journal. Le rejeu doit
+    // redonner l'etat valide.
+    FileSystem *fs = fs_open(image);
+    CHECK(fs != NULL, "fs_open");
+    if (!fs) return 1;
+    CHECK(fs_add_file(fs, "/avant", source) == 0, "add /avant");
+    fs_close(fs);
+
+    SuperBlock before;
+    CHECK(read_superblock(image, &before) == 0, "lecture du SuperBlock");
+    fs = fs_open(image);
+    CHECK(fs != NULL, "réouverture");
+    if (!fs) return 1;
+    CHECK(fs_add_file(fs, "/apres", source) == 0, "add /apres");
+    fs_close(fs);
+    CHECK(write_superblock(image, &before) == 0, "SuperBlock d'avant remis");
+
+    fs = fs_open(image);
+    CHECK(fs != NULL, "ouverture avec rejeu");
+    if (!fs) return 1;
+    CHECK(file_state(fs, "/avant", 0x5A) == 1, "/avant intact après rejeu");
+    CHECK(file_state(fs, "/apres", 0x5A) == 1, "/apres rétabli par le rejeu");
+    fs_close(fs);
+
+    // Ecrivain tue au milieu d'un ajout, apres un nombre croissant d'ajouts
+    for (int round = 0; round < KILL_ROUNDS; round++) {
+        int fds[2];
+        if (pipe(fds) != 0) return 1;
+        pid_t pid = fork();
+        if (pid < 0) return 1;
+        if (pid == 0) {
+            close(fds[0]);
+            writer(image, child_source, round, fds[1]);
+        }
+        close(fds[1]);
+
+        int wanted = 1 << round;
+        int reported = 0;
+        char done;
+        while (reported < wanted && read(fds[0], &done, 1) == 1) reported++;
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+        close(fds[0]);
+        CHECK(reported == wanted, "ajouts signalés par l'écrivain");
+
+        fs = fs_open(image);
+        CHECK(fs != NULL, "ouverture après l'arrêt de l'écrivain");
+        if (!fs) return 1;
+        for (int i = 0; i < MAX_ADDS; i++) {
+            char name[32];
+            snprintf(name, sizeof(name), "/r%d_%d", round, i);
+            int state = file_state(fs, name, fill_byte(round, i));
+            CHECK(state != -1, "aucun fichier tronqué ou altéré");
+            if (i < reported) CHECK(state == 1, "ajout validé conservé");
+        }
+        CHECK(file_state(fs, "/avant", 0x5A) == 1, "/avant intact");
+        CHECK(file_state(fs, "/apres", 0x5A) == 1, "/apres intact");
+        fs_close(fs);
+    }
+
+    unlink(image);
+    unlink(source);
+    unlink(child_source);
+
+    if (failures) {
+        fprintf(stderr, "%d vérification(s) en échec\n", failures);
+        return 1;
+    }
+    printf("journal_replay : OK\n");
+    return 0;
+}
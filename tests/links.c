@@ -0,0 +1,107 @@
+// Liens physiques : tous les noms designent le meme inode de contenu.
+// Retirer le nom d'origine ne deplace rien, une reecriture par un nom se voit
+// par les autres, et les donnees partent avec le dernier nom.
+#include "fs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static int failures = 0;
+
+#define CHECK(cond, msg) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "ÉCHEC %s:%d : %s\n", __FILE__, __LINE__, msg); \
+        failures++; \
+    } \
+} while (0)
+
+static int write_host_file(const char *path, const char *content) {
+    FILE *f = fopen(path, "wb");
+    if (!f) return -1;
+    size_t len = strlen(content);
+    int ret = fwrite(content, 1, len, f) == len ? 0 : -1;
+    if (fclose(f) != 0) ret = -1;
+    return ret;
+}
+
+// Contenu du fichier designe par path, compare a expected
+static int content_is(FileSystem *fs, const char *path, const char *expected) {
+    int idx = fs_lookup(fs, path);
+    if (idx == -1) return 0;
+    Inode inode = *get_inode(fs, idx);
+    size_t len = strlen(expected);
+    if (inode.size != len) return 0;
+
+    char buf[256];
+    FsReader reader;
+    if (fs_reader_open(fs, &inode, &reader) != 0) return 0;
+    size_t n = fs_reader_read(&reader, buf, sizeof(buf));
+    fs_reader_close(&reader);
+    return n == len && memcmp(buf, expected, len) == 0;
+}
+
+int main(void) {
+    char image[64], first[64], second[64];
+    snprintf(image, sizeof(image), "/tmp/csfs_links_%d.img", (int)getpid());
+    snprintf(first, sizeof(first), "/tmp/csfs_links_%d.a", (int)getpid());
+    snprintf(second, sizeof(second), "/tmp/csfs_links_%d.b", (int)getpid());
+
+    if (write_host_file(first, "premier contenu\n") != 0 ||
+        write_host_file(second, "second contenu, plus long\n") != 0 ||
+        fs_create(image) != 0) {
+        fprintf(stderr, "Impossible de préparer les fichiers de test\n");
+        return 1;
+    }
+
+    FileSystem *fs = fs_open(image);
+    CHECK(fs != NULL, "fs_open");
+    if (!fs) return 1;
+    uint32_t base_files = fs->sb.num_files;
+
+    CHECK(fs_mkdir(fs, "/a") == 0, "mkdir /a");
+    CHECK(fs_add_file(fs, "/a/f", first) == 0, "add /a/f");
+    CHECK(fs_link(fs, "/a/f", "/a/g") == 0, "ln /a/f /a/g");
+    CHECK(fs_link(fs, "/a/g", "/h") == 0, "ln /a/g /h");
+
+    int data = fs_lookup(fs, "/h");
+    CHECK(data != -1 && fs_lookup(fs, "/a/f") == data && fs_lookup(fs, "/a/g") == data,
+          "les trois noms désignent le même inode");
+    CHECK(data != -1 && get_inode(fs, data)->link_count == 3, "trois noms comptés");
+
+    // Le nom d'origine n'est qu'un lien parmi les autres
+    CHECK(fs_remove(fs, "/a/f") == 0, "rm /a/f");
+    CHECK(fs_lookup(fs, "/h") == data, "le contenu reste en place");
+    CHECK(get_inode(fs, data)->link_count == 2, "deux noms restants");
+    CHECK(content_is(fs, "/a/g", "premier contenu\n"), "contenu lu par /a/g");
+
+    // Une reecriture par un nom est vue par l'autre
+    CHECK(fs_write_file(fs, "/a/g", second) == 0, "réécriture de /a/g");
+    CHECK(fs_lookup(fs, "/a/g") == data, "la réécriture garde l'inode");
+    CHECK(content_is(fs, "/h", "second contenu, plus long\n"), "contenu réécrit lu par /h");
+    fs_close(fs);
+
+    fs = fs_open(image);
+    CHECK(fs != NULL, "réouverture");
+    if (!fs) return 1;
+    CHECK(content_is(fs, "/a/g", "second contenu, plus long\n"), "contenu après réouverture");
+    CHECK(fs_lookup(fs, "/h") == fs_lookup(fs, "/a/g"), "noms liés après réouverture");
+
+    // Le dernier nom emporte l'inode de contenu
+    CHECK(fs_remove(fs, "/a/g") == 0, "rm /a/g");
+    CHECK(fs_remove(fs, "/h") == 0, "rm /h");
+    CHECK(fs_remove(fs, "/a") == 0, "rm /a");
+    CHECK(fs->sb.num_files == base_files, "aucun inode orphelin");
+    fs_close(fs);
+
+    unlink(image);
+    unlink(first);
+    unlink(second);
+
+    if (failures) {
+        fprintf(stderr, "%d vérification(s) en échec\n", failures);
+        return 1;
+    }
+    printf("links : OK\n");
+    return 0;
+}
@@ -0,0 +1,133 @@
+// Instantanes : la creation ne recopie pas les donnees, l'instantane garde
+// l'ancien contenu quand l'arborescence vivante change, la restauration le
+// remet en place, et la suppression rend l'espace qu'il etait seul a tenir.
+#include "fs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define FILE_SIZE (32 * BLOCK_SIZE)
+// Blocs de metadonnees (index, tas de noms, compteurs) toleres en plus
+#define META_SLACK (16 * BLOCK_SIZE)
+#define SNAP "/" SNAPSHOT_DIR "/s1"
+
+static int failures = 0;
+
+#define CHECK(cond, msg) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "ÉCHEC %s:%d : %s\n", __FILE__, __LINE__, msg); \
+        failures++; \
+    } \
+} while (0)
+
+static int write_host_file(const char *path, unsigned char value) {
+    static unsigned char buf[FILE_SIZE];
+    memset(buf, value, sizeof(buf));
+    FILE *f = fopen(path, "wb");
+    if (!f) return -1;
+    int ret = fwrite(buf, 1, sizeof(buf), f) == sizeof(buf) ? 0 : -1;
+    if (fclose(f) != 0) ret = -1;
+    return ret;
+}
+
+// 1 si path a FILE_SIZE octets valant tous value
+static int content_is(FileSystem *fs, const char *path, unsigned char value) {
+    int idx = fs_lookup(fs, path);
+    if (idx == -1) return 0;
+    Inode inode = *get_inode(fs, idx);
+    if (inode.size != FILE_SIZE) return 0;
+
+    FsReader reader;
+    if (fs_reader_open(fs, &inode, &reader) != 0) return 0;
+    unsigned char buf[BLOCK_SIZE];
+    uint64_t total = 0;
+    size_t n;
+    int ok = 1;
+    while ((n = fs_reader_read(&reader, buf, sizeof(buf))) > 0) {
+        for (size_t k = 0; k < n; k++) ok &= buf[k] == value;
+        total += n;
+    }
+    fs_reader_close(&reader);
+    return ok && total == FILE_SIZE;
+}
+
+// Octets occupes avant la fin des donnees, une fois la transaction validee
+static uint64_t used_bytes(FileSystem *fs) {
+    fs_sync(fs);
+    return fs->sb.data_end - fs->free_map.total;
+}
+
+int main(void) {
+    char image[64], first[64], second[64], third[64];
+    snprintf(image, sizeof(image), "/tmp/csfs_snap_%d.img", (int)getpid());
+    snprintf(first, sizeof(first), "/tmp/csfs_snap_%d.a", (int)getpid());
+    snprintf(second, sizeof(second), "/tmp/csfs_snap_%d.b", (int)getpid());
+    snprintf(third, sizeof(third), "/tmp/csfs_snap_%d.c", (int)getpid());
+
+    if (write_host_file(first, 0xA1) != 0 || write_host_file(second, 0xB2) != 0 ||
+        write_host_file(third, 0xC3) != 0 || fs_create(image) != 0) {
+        fprintf(stderr, "Impossible de préparer les fichiers de test\n");
+        return 1;
+    }
+
+    FileSystem *fs = fs_open(image);
+    CHECK(fs != NULL, "fs_open");
+    if (!fs) return 1;
+    CHECK(fs_mkdir(fs, "/d") == 0, "mkdir /d");
+    CHECK(fs_add_file(fs, "/d/a", first) == 0, "add /d/a");
+    CHECK(fs_add_file(fs, "/b", second) == 0, "add /b");
+    uint64_t live = used_bytes(fs);
+
+    // Seules les metadonnees sont recopiees
+    CHECK(fs_snapshot_create(fs, "s1") == 0, "snapshot create s1");
+    CHECK(used_bytes(fs) < live + META_SLACK, "instantané sans copie des données");
+    CHECK(content_is(fs, SNAP "/d/a", 0xA1), "/d/a figé dans l'instantané");
+    CHECK(content_is(fs, SNAP "/b", 0xB2), "/b figé dans l'instantané");
+    CHECK(fs_write_file(fs, SNAP "/b", third) != 0, "instantané en lecture seule");
+    fs_close(fs);
+
+    // L'arborescence vivante change, l'instantane non
+    fs = fs_open(image);
+    CHECK(fs != NULL, "réouverture");
+    if (!fs) return 1;
+    CHECK(fs_write_file(fs, "/d/a", third) == 0, "réécriture de /d/a");
+    CHECK(fs_remove(fs, "/b") == 0, "rm /b");
+    CHECK(fs_add_file(fs, "/c", third) == 0, "add /c");
+    CHECK(content_is(fs, "/d/a", 0xC3), "/d/a réécrit");
+    CHECK(content_is(fs, SNAP "/d/a", 0xA1), "ancien /d/a gardé par l'instantané");
+    CHECK(content_is(fs, SNAP "/b", 0xB2), "/b gardé par l'instantané");
+
+    CHECK(fs_snapshot_restore(fs, "s1") == 0, "snapshot restore s1");
+    CHECK(content_is(fs, "/d/a", 0xA1), "/d/a restauré");
+    CHECK(content_is(fs, "/b", 0xB2), "/b restauré");
+    CHECK(fs_lookup(fs, "/c") == -1, "/c absent après restauration");
+    CHECK(fs_lookup(fs, SNAP) != -1, "instantané gardé après restauration");
+    fs_close(fs);
+
+    // Les donnees que seul l'instantane tient partent avec lui
+    fs = fs_open(image);
+    CHECK(fs != NULL, "réouverture");
+    if (!fs) return 1;
+    CHECK(content_is(fs, "/b", 0xB2), "/b restauré après réouverture");
+    CHECK(fs_remove(fs, "/b") == 0, "rm /b restauré");
+    uint64_t held = used_bytes(fs);
+    CHECK(fs_snapshot_delete(fs, "s1") == 0, "snapshot delete s1");
+    CHECK(fs_lookup(fs, SNAP) == -1, "instantané supprimé");
+    CHECK(fs_lookup(fs, "/" SNAPSHOT_DIR) == -1, "répertoire des instantanés supprimé");
+    CHECK(used_bytes(fs) + FILE_SIZE <= held, "espace de /b rendu");
+    CHECK(content_is(fs, "/d/a", 0xA1), "/d/a intact après la suppression");
+    fs_close(fs);
+
+    unlink(image);
+    unlink(first);
+    unlink(second);
+    unlink(third);
+
+    if (failures) {
+        fprintf(stderr, "%d vérification(s) en échec\n", failures);
+        return 1;
+    }
+    printf("snapshots : OK\n");
+    return 0;
+}
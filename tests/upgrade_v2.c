@@ -0,0 +1,156 @@
+// Conversion d'une image v2 dont la liste de blocs libres recouvre un
+// fichier vivant : l'ancien add ecrivait en fin de donnees sans consulter la
+// chaine, un bloc libere pouvait donc etre reutilise tout en y restant.
+// Apres fs_upgrade, les ajouts ne doivent pas ecraser /docs/o1.
+#include "fs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TEST_MAX_FILES 16
+#define O1_BLOCKS 3
+
+static int failures = 0;
+
+#define CHECK(cond, msg) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "ÉCHEC %s:%d : %s\n", __FILE__, __LINE__, msg); \
+        failures++; \
+    } \
+} while (0)
+
+static int write_at(FILE *f, uint64_t offset, const void *data, size_t len) {
+    if (fseek(f, (long)offset, SEEK_SET) != 0) return -1;
+    return fwrite(data, 1, len, f) == len ? 0 : -1;
+}
+
+static void fill_pattern(unsigned char *buf, size_t len, unsigned seed) {
+    for (size_t i = 0; i < len; i++) buf[i] = (unsigned char)(seed + i * 31 + (i >> 12));
+}
+
+// Image v2 : /docs/o1 sur trois blocs depuis data_offset, suivis d'un bloc
+// libre. La chaine part de ce bloc puis designe le deuxieme bloc de o1,
+// dont le pointeur suivant n'est plus qu'un octet de donnees.
+static int build_v2_image(const char *path, unsigned char *o1_data) {
+    FILE *f = fopen(path, "wb");
+    if (!f) return -1;
+
+    uint64_t table_size = (uint64_t)TEST_MAX_FILES * sizeof(InodeV2);
+    uint64_t data_offset = sizeof(SuperBlock) + ((table_size + BLOCK_SIZE - 1) / BLOCK_SIZE) * BLOCK_SIZE;
+    uint64_t free_block = data_offset + O1_BLOCKS * BLOCK_SIZE;
+
+    SuperBlock sb;
+    memset(&sb, 0, sizeof(sb));
+    sb.magic = FS_MAGIC;
+    sb.version = 2;
+    sb.num_files = 2;
+    sb.max_files = TEST_MAX_FILES;
+    sb.inode_table_offset = sizeof(SuperBlock);
+    sb.data_offset = data_offset;
+    sb.first_free_block = free_block;
+
+    InodeV2 *table = calloc(TEST_MAX_FILES, sizeof(InodeV2));
+    if (!table) {
+        fclose(f);
+        return -1;
+    }
+    strcpy(table[0].filename, "docs");
+    strcpy(table[0].parent_path, "/");
+    table[0].is_directory = 1;
+    table[0].mode = 0755;
+    table[0].link_count = 1;
+
+    strcpy(table[1].filename, "o1");
+    strcpy(table[1].parent_path, "/docs");
+    table[1].size = O1_BLOCKS * BLOCK_SIZE;
+    table[1].offset = data_offset;
+    table[1].mode = 0644;
+    table[1].link_count = 1;
+
+    FreeBlock fb = { data_offset + BLOCK_SIZE };
+    unsigned char tail[BLOCK_SIZE];
+    memset(tail, 0, sizeof(tail));
+    memcpy(tail, &fb, sizeof(fb));
+
+    int ret = 0;
+    if (write_at(f, 0, &sb, sizeof(sb)) != 0 ||
+        write_at(f, sb.inode_table_offset, table, (size_t)table_size) != 0 ||
+        write_at(f, data_offset, o1_data, O1_BLOCKS * BLOCK_SIZE) != 0 ||
+        write_at(f, free_block, tail, sizeof(tail)) != 0) {
+        ret = -1;
+    }
+    free(table);
+    if (fclose(f) != 0) ret = -1;
+    return ret;
+}
+
+static int file_equals(const char *path, const unsigned char *data, size_t len) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return 0;
+    unsigned char *buf = malloc(len + 1);
+    size_t got = buf ? fread(buf, 1, len + 1, f) : 0;
+    int same = buf && got == len && memcmp(buf, data, len) == 0;
+    free(buf);
+    fclose(f);
+    return same;
+}
+
+int main(void) {
+    char image[64], source[64], extracted[64];
+    snprintf(image, sizeof(image), "/tmp/csfs_upgrade_%d.img", (int)getpid());
+    snprintf(source, sizeof(source), "/tmp/csfs_upgrade_%d.src", (int)getpid());
+    snprintf(extracted, sizeof(extracted), "/tmp/csfs_upgrade_%d.out", (int)getpid());
+
+    static unsigned char o1_data[O1_BLOCKS * BLOCK_SIZE];
+    fill_pattern(o1_data, sizeof(o1_data), 0x41);
+    if (build_v2_image(image, o1_data) != 0) {
+        fprintf(stderr, "Impossible de construire l'image v2\n");
+        return 1;
+    }
+
+    CHECK(fs_upgrade(image) == 0, "fs_upgrade");
+
+    FileSystem *fs = fs_open(image);
+    CHECK(fs != NULL, "fs_open après conversion");
+    if (!fs) return 1;
+
+    // Des ajouts d'un bloc consomment d'abord l'espace libre repris
+    static unsigned char block[BLOCK_SIZE];
+    fill_pattern(block, sizeof(block), 0x7A);
+    FILE *src = fopen(source, "wb");
+    CHECK(src && fwrite(block, 1, sizeof(block), src) == sizeof(block), "écriture de la source");
+    if (src) fclose(src);
+
+    for (int i = 0; i < 4; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "/docs/n%d", i);
+        CHECK(fs_add_file(fs, name, source) == 0, "ajout après conversion");
+    }
+
+    CHECK(fs_extract_file(fs, "/docs/o1", extracted) == 0, "extraction de /docs/o1");
+    CHECK(file_equals(extracted, o1_data, sizeof(o1_data)), "/docs/o1 écrasé par un ajout");
+    fs_close(fs);
+
+    // Et toujours intact apres reouverture
+    fs = fs_open(image);
+    CHECK(fs != NULL, "réouverture");
+    if (fs) {
+        CHECK(fs_extract_file(fs, "/docs/o1", extracted) == 0, "extraction après réouverture");
+        CHECK(file_equals(extracted, o1_data, sizeof(o1_data)), "/docs/o1 modifié après réouverture");
+        CHECK(fs_extract_file(fs, "/docs/n3", extracted) == 0, "extraction de /docs/n3");
+        CHECK(file_equals(extracted, block, sizeof(block)), "/docs/n3 incorrect");
+        fs_close(fs);
+    }
+
+    unlink(image);
+    unlink(source);
+    unlink(extracted);
+
+    if (failures) {
+        fprintf(stderr, "%d vérification(s) en échec\n", failures);
+        return 1;
+    }
+    printf("upgrade_v2 : OK\n");
+    return 0;
+}